@@ -0,0 +1,83 @@
+// malloc counter for the benchmark's allocation pass. Preloaded into a
+// child process, it forwards to glibc and keeps running totals in a small
+// shared file named by LIORA_BENCH_ALLOCS, which the child reads before and
+// after its measured ops. Counts every allocation in the process (runtime
+// included), so compare builds against each other rather than reading the
+// numbers as the addon's alone. Not usable together with a sanitizer,
+// which intercepts malloc itself.
+//
+//   g++ -O2 -shared -fPIC bench/alloc-count.cpp -o build/alloc-count.so
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void  __libc_free(void*);
+}
+
+namespace {
+
+struct Counters { std::atomic<uint64_t> allocs, frees, bytes; };
+
+Counters g_local;                 // until the shared file is mapped
+Counters* g_counters = &g_local;
+
+__attribute__((constructor)) void MapCounters(){
+  const char* path = getenv("LIORA_BENCH_ALLOCS");
+  if (!path || !*path) return;
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0) return;
+  if (ftruncate(fd, 4096) == 0){
+    void* p = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) g_counters = static_cast<Counters*>(p);
+  }
+  close(fd);
+}
+
+inline void* Counted(void* p, size_t n){
+  if (p){
+    g_counters->allocs.fetch_add(1, std::memory_order_relaxed);
+    g_counters->bytes.fetch_add(n, std::memory_order_relaxed);
+  }
+  return p;
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t n){ return Counted(__libc_malloc(n), n); }
+void* calloc(size_t c, size_t n){ return Counted(__libc_calloc(c, n), c * n); }
+void* memalign(size_t a, size_t n){ return Counted(__libc_memalign(a, n), n); }
+void* aligned_alloc(size_t a, size_t n){ return Counted(__libc_memalign(a, n), n); }
+
+void* realloc(void* p, size_t n){
+  void* q = __libc_realloc(p, n);
+  if (!p) return Counted(q, n);
+  if (q && q != p) Counted(q, n);
+  return q;
+}
+
+int posix_memalign(void** out, size_t a, size_t n){
+  void* p = __libc_memalign(a, n);
+  if (!p) return ENOMEM;
+  *out = Counted(p, n);
+  return 0;
+}
+
+void free(void* p){
+  if (p) g_counters->frees.fetch_add(1, std::memory_order_relaxed);
+  __libc_free(p);
+}
+
+} // extern "C"
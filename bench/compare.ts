@@ -0,0 +1,59 @@
+import fs from "fs";
+
+// Diffs two bench/run.ts reports scenario by scenario and level by level:
+// throughput, p50/p99 latency, peak RSS and allocations per op, with the
+// change from the first report to the second.
+//
+//   bun bench/compare.ts baseline.json candidate.json
+
+const [aPath, bPath] = process.argv.slice(2);
+if (!aPath || !bPath) {
+    console.error("usage: bun bench/compare.ts <baseline.json> <candidate.json>");
+    process.exit(2);
+}
+
+const a = JSON.parse(fs.readFileSync(aPath, "utf8"));
+const b = JSON.parse(fs.readFileSync(bPath, "utf8"));
+
+function change(from: number, to: number): string {
+    if (!from || !to) return "";
+    const pct = ((to - from) / from) * 100;
+    return `${pct >= 0 ? "+" : ""}${pct.toFixed(1)}%`;
+}
+
+const rows: string[][] = [["scenario", "c", "ops/s", "", "p50 ms", "", "p99 ms", ""]];
+const extras: string[][] = [["scenario", "peak RSS MiB", "", "allocs/op", ""]];
+const byName = new Map<string, any>(b.results.map((r: any) => [r.name, r]));
+const mib = (v: number) => (v / (1024 * 1024)).toFixed(1);
+
+for (const ra of a.results) {
+    const rb = byName.get(ra.name);
+    if (!rb || !ra.levels || !rb.levels) continue;
+    for (const la of ra.levels) {
+        const lb = rb.levels.find((l: any) => l.concurrency === la.concurrency);
+        if (!lb) continue;
+        rows.push([
+            ra.name, String(la.concurrency),
+            `${la.opsPerSec} -> ${lb.opsPerSec}`, change(la.opsPerSec, lb.opsPerSec),
+            `${la.latencyMs.p50} -> ${lb.latencyMs.p50}`, change(la.latencyMs.p50, lb.latencyMs.p50),
+            `${la.latencyMs.p99} -> ${lb.latencyMs.p99}`, change(la.latencyMs.p99, lb.latencyMs.p99)
+        ]);
+    }
+    const pa = ra.memory?.peakRss || 0, pb = rb.memory?.peakRss || 0;
+    const aa = ra.allocations?.perOp || 0, ab = rb.allocations?.perOp || 0;
+    extras.push([
+        ra.name,
+        `${mib(pa)} -> ${mib(pb)}`, change(pa, pb),
+        aa && ab ? `${aa} -> ${ab}` : "", change(aa, ab)
+    ]);
+}
+
+function print(table: string[][]) {
+    const widths = table[0].map((_, i) => Math.max(...table.map((r) => r[i].length)));
+    for (const r of table) console.log(r.map((c, i) => c.padEnd(widths[i])).join("  ").trimEnd());
+}
+
+console.log(`${a.label} (${a.runtime}) -> ${b.label} (${b.runtime})\n`);
+print(rows);
+console.log();
+print(extras);
@@ -0,0 +1,103 @@
+import fs from "fs";
+import path from "path";
+import crypto from "crypto";
+import { spawnSync } from "child_process";
+
+// The benchmark inputs. Each one is rendered by the ffmpeg CLI from its
+// synthetic test sources, so every machine benchmarks the same content;
+// a file already present in the corpus directory is used as-is, which is
+// how a corpus of real inputs can be swapped in (BENCH_CORPUS=dir).
+
+interface CorpusFile {
+    name: string;
+    // tried in order; later entries fall back to encoders more builds have
+    args: string[][];
+}
+
+const VIDEO = "testsrc2=size=1280x720:rate=30";
+const TONE = "sine=frequency=440:sample_rate=44100:duration=30,aformat=channel_layouts=stereo";
+
+const FILES: CorpusFile[] = [
+    { name: "sticker.jpg", args: [["-f", "lavfi", "-i", VIDEO, "-frames:v", "1", "-q:v", "3"]] },
+    {
+        name: "sticker.png",
+        args: [["-f", "lavfi", "-i", "testsrc2=size=800x800,format=rgba,colorchannelmixer=aa=0.6", "-frames:v", "1"]]
+    },
+    { name: "sticker.gif", args: [["-f", "lavfi", "-i", "testsrc2=size=480x480:rate=15", "-t", "3"]] },
+    {
+        name: "sticker.mp4",
+        args: [
+            ["-f", "lavfi", "-i", VIDEO, "-f", "lavfi", "-i", TONE, "-t", "8",
+             "-c:v", "libx264", "-preset", "fast", "-pix_fmt", "yuv420p", "-c:a", "aac", "-shortest"],
+            ["-f", "lavfi", "-i", VIDEO, "-f", "lavfi", "-i", TONE, "-t", "8",
+             "-c:v", "mpeg4", "-q:v", "4", "-c:a", "aac", "-shortest"]
+        ]
+    },
+    { name: "convert.wav", args: [["-f", "lavfi", "-i", TONE, "-c:a", "pcm_s16le"]] },
+    { name: "convert.mp3", args: [["-f", "lavfi", "-i", TONE, "-c:a", "libmp3lame", "-b:a", "128k"]] },
+    { name: "convert.m4a", args: [["-f", "lavfi", "-i", TONE, "-c:a", "aac", "-b:a", "128k"]] },
+    {
+        name: "convert.ogg",
+        args: [
+            ["-f", "lavfi", "-i", TONE, "-ar", "48000", "-c:a", "libopus", "-b:a", "64k"],
+            ["-f", "lavfi", "-i", TONE, "-c:a", "libvorbis", "-q:a", "4"]
+        ]
+    }
+];
+
+interface CorpusEntry {
+    path: string;
+    bytes: number;
+    sha1: string;
+}
+
+function render(dir: string, file: CorpusFile): void {
+    const out = path.join(dir, file.name);
+    let lastError = "";
+    for (const args of file.args) {
+        const r = spawnSync("ffmpeg", ["-hide_banner", "-loglevel", "error", "-y", ...args, out], { encoding: "utf8" });
+        if (r.error) throw new Error(`ffmpeg is needed to build the benchmark corpus (${r.error.message})`);
+        if (r.status === 0) return;
+        lastError = r.stderr.trim();
+    }
+    fs.rmSync(out, { force: true });
+    throw new Error(`could not render ${file.name}: ${lastError}`);
+}
+
+// Renders whichever of `names` are missing from `dir`.
+function prepareCorpus(dir: string, names: string[]): Record<string, CorpusEntry> {
+    fs.mkdirSync(dir, { recursive: true });
+    const entries: Record<string, CorpusEntry> = {};
+    for (const file of FILES.filter((f) => names.includes(f.name))) {
+        const p = path.join(dir, file.name);
+        if (!fs.existsSync(p)) {
+            console.error(`   > rendering ${file.name}`);
+            render(dir, file);
+        }
+        const data = fs.readFileSync(p);
+        entries[file.name] = {
+            path: p,
+            bytes: data.length,
+            sha1: crypto.createHash("sha1").update(data).digest("hex").slice(0, 12)
+        };
+    }
+    return entries;
+}
+
+// Self-signed certificate for the local HTTP/2 server (curl only speaks h2
+// over TLS here). null when openssl is not installed.
+function prepareCert(dir: string): { key: string; cert: string } | null {
+    const key = path.join(dir, "localhost.key");
+    const cert = path.join(dir, "localhost.crt");
+    if (!fs.existsSync(key) || !fs.existsSync(cert)) {
+        const r = spawnSync("openssl", [
+            "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "3650",
+            "-subj", "/CN=localhost", "-keyout", key, "-out", cert
+        ], { encoding: "utf8" });
+        if (r.error || r.status !== 0) return null;
+    }
+    return { key: fs.readFileSync(key, "utf8"), cert: fs.readFileSync(cert, "utf8") };
+}
+
+export { prepareCorpus, prepareCert };
+export type { CorpusEntry };
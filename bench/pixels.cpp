@@ -0,0 +1,96 @@
+// Sticker canvas hand-off: the old path (RGBA canvas repacked by
+// WebPPictureImportRGBA) against the current one (ARGB canvas wrapped in
+// place, transparent pixels cleared by the scalar and the dispatched SIMD
+// kernel). Prints one JSON object; exits non-zero if the kernels disagree.
+//
+//   npm run bench:pixels
+#include "../src/pixels.h"
+#include <webp/encode.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr int kSide = 512;
+static constexpr size_t kPixels = (size_t)kSide * kSide;
+
+// A 512x288 letterboxed frame with a soft-edged transparent hole, so every
+// kernel branch is taken: alpha 0 border, opaque video, partial alpha.
+static std::vector<uint32_t> MakeArgbFrame(){
+  std::vector<uint32_t> px(kPixels, 0);
+  std::mt19937 rng(42);
+  const int top = (kSide - 288) / 2;
+  for (int y = top; y < top + 288; ++y){
+    for (int x = 0; x < kSide; ++x){
+      int dx = x - 256, dy = y - 256;
+      int d = dx*dx + dy*dy;
+      uint32_t a = d < 60*60 ? 0 : d < 70*70 ? 128 : 255;
+      px[(size_t)y*kSide + x] = (a << 24) | (rng() & 0xffffffu);
+    }
+  }
+  return px;
+}
+
+static std::vector<uint8_t> ToRgba(const std::vector<uint32_t>& argb){
+  std::vector<uint8_t> out(argb.size() * 4);
+  for (size_t i = 0; i < argb.size(); ++i){
+    uint32_t p = argb[i];
+    out[i*4+0] = (uint8_t)(p >> 16); out[i*4+1] = (uint8_t)(p >> 8);
+    out[i*4+2] = (uint8_t)p;         out[i*4+3] = (uint8_t)(p >> 24);
+  }
+  return out;
+}
+
+template <class F>
+static double MicrosPerFrame(int iters, F&& f){
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) f();
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() / iters;
+}
+
+int main(int argc, char** argv){
+  const int iters = argc > 1 ? std::max(1, std::atoi(argv[1])) : 500;
+  const std::vector<uint32_t> frame = MakeArgbFrame();
+  const std::vector<uint8_t> rgba = ToRgba(frame);
+
+  std::vector<uint32_t> a = frame, b = frame;
+  pixels::ClearTransparentScalar(a.data(), a.size());
+  pixels::ClearTransparent(b.data(), b.size());
+  if (std::memcmp(a.data(), b.data(), a.size() * 4) != 0){
+    std::fprintf(stderr, "%s kernel disagrees with the scalar one\n", pixels::ClearTransparentKernel().isa);
+    return 1;
+  }
+
+  volatile uint32_t sink = 0;
+  double importUs = MicrosPerFrame(iters, [&]{
+    WebPPicture pic; WebPPictureInit(&pic);
+    pic.use_argb = 1; pic.width = kSide; pic.height = kSide;
+    if (!WebPPictureImportRGBA(&pic, rgba.data(), kSide * 4)) std::abort();
+    sink = sink + pic.argb[kPixels / 2];
+    WebPPictureFree(&pic);
+  });
+
+  std::vector<uint32_t> work(kPixels);
+  double copyUs = MicrosPerFrame(iters, [&]{
+    std::memcpy(work.data(), frame.data(), kPixels * 4);
+    sink = sink + work[kPixels / 2];
+  });
+  auto clearRows = [&](pixels::ClearFn fn){
+    return MicrosPerFrame(iters, [&]{
+      std::memcpy(work.data(), frame.data(), kPixels * 4);
+      for (int y = 0; y < kSide; ++y) fn(work.data() + (size_t)y * kSide, kSide);
+      sink = sink + work[kPixels / 2];
+    }) - copyUs;
+  };
+  double scalarUs = clearRows(&pixels::ClearTransparentScalar);
+  double simdUs = clearRows(pixels::ClearTransparentKernel().fn);
+
+  std::printf("{\"bench\":\"pixels\",\"isa\":\"%s\",\"iterations\":%d,"
+              "\"importRgbaUs\":%.2f,\"clearScalarUs\":%.2f,\"clearSimdUs\":%.2f}\n",
+              pixels::ClearTransparentKernel().isa, iters, importUs, scalarUs, simdUs);
+  return sink == 0xdeadbeef ? 2 : 0;
+}
@@ -0,0 +1,336 @@
+import fs from "fs";
+import os from "os";
+import path from "path";
+import { spawn, spawnSync } from "child_process";
+import { fileURLToPath } from "url";
+import { prepareCorpus, prepareCert } from "./corpus.js";
+import type { CorpusEntry } from "./corpus.js";
+import { startOrigins } from "./server.js";
+
+// Throughput and latency benchmark for the three addons. Every scenario
+// runs in a fresh child process, so its peak RSS is its own, at each
+// concurrency level in turn; a second, shorter child counts allocations
+// per op with bench/alloc-count.cpp preloaded. One JSON document goes to
+// stdout (progress to stderr); `bench/compare.ts a.json b.json` diffs two.
+//
+//   bun bench/run.ts [--filter sticker] [--label o3] [--out o3.json]
+//                    [--time 2000] [--min-ops 10] [--max-concurrency 8]
+//                    [--no-allocs]
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+const root = path.join(__dirname, "..");
+
+type Lib = typeof import("../export.js");
+
+interface Scenario {
+    name: string;
+    addon: "sticker" | "converter" | "fetch";
+    input?: string;               // corpus file
+    url?: "http1" | "http2";
+    path?: string;
+    op(lib: Lib, input: Buffer, url: string): Promise<unknown>;
+}
+
+const sticker = (input: string): Scenario => ({
+    name: `sticker:${path.extname(input).slice(1)}`,
+    addon: "sticker",
+    input,
+    op: (lib, buf) => lib.stickerAsync(buf, { packName: "bench", authorName: "liora-lib" })
+});
+
+// remux is off so every format pays for a real decode and encode
+const convert = (input: string): Scenario => ({
+    name: `convert:${path.extname(input).slice(1)}`,
+    addon: "converter",
+    input,
+    op: (lib, buf) => lib.convert(buf, { format: "opus", remux: false })
+});
+
+const fetchOf = (url: "http1" | "http2", route: string): Scenario => ({
+    name: `fetch:${url === "http1" ? "h1" : "h2"}-${route.slice(1)}`,
+    addon: "fetch",
+    url,
+    path: route,
+    op: async (lib, _buf, target) => {
+        const res = await lib.fetch(target, { insecure: true });
+        if (!res.ok) throw new Error(`HTTP ${res.status} from ${target}`);
+        return res.body;
+    }
+});
+
+const SCENARIOS: Scenario[] = [
+    sticker("sticker.jpg"),
+    sticker("sticker.png"),
+    sticker("sticker.gif"),
+    sticker("sticker.mp4"),
+    convert("convert.ogg"),
+    convert("convert.mp3"),
+    convert("convert.m4a"),
+    convert("convert.wav"),
+    fetchOf("http1", "/small"),
+    fetchOf("http1", "/large"),
+    fetchOf("http2", "/small"),
+    fetchOf("http2", "/large")
+];
+
+interface Args {
+    filter: string;
+    label: string;
+    out: string;
+    timeMs: number;
+    minOps: number;
+    maxConcurrency: number;
+    allocs: boolean;
+    child: string;
+}
+
+function parseArgs(argv: string[]): Args {
+    const a: Args = {
+        filter: "",
+        label: process.env.BENCH_LABEL || "default",
+        out: "",
+        timeMs: 2000,
+        minOps: 10,
+        maxConcurrency: os.availableParallelism(),
+        allocs: true,
+        child: ""
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const v = argv[i + 1];
+        switch (argv[i]) {
+            case "--filter": a.filter = v; i++; break;
+            case "--label": a.label = v; i++; break;
+            case "--out": a.out = v; i++; break;
+            case "--time": a.timeMs = Number(v); i++; break;
+            case "--min-ops": a.minOps = Number(v); i++; break;
+            case "--max-concurrency": a.maxConcurrency = Math.max(1, Number(v)); i++; break;
+            case "--no-allocs": a.allocs = false; break;
+            case "--child": a.child = v; i++; break;
+            default: throw new Error(`unknown argument ${argv[i]}`);
+        }
+    }
+    return a;
+}
+
+// CPU-bound addons double up to the core count; fetch is I/O-bound and
+// goes wider.
+function levelsFor(s: Scenario, max: number): number[] {
+    if (s.addon === "fetch") return [1, 4, 16, 64];
+    const levels: number[] = [];
+    for (let c = 1; c < max; c *= 2) levels.push(c);
+    levels.push(max);
+    return levels;
+}
+
+function percentile(sorted: number[], q: number): number {
+    if (sorted.length === 0) return 0;
+    return sorted[Math.min(sorted.length - 1, Math.ceil(q * sorted.length) - 1)];
+}
+
+const round = (v: number) => Math.round(v * 1000) / 1000;
+
+// ---- child: one scenario ------------------------------------------------
+
+interface ChildConfig {
+    scenario: string;
+    input: string;
+    url: string;
+    levels: number[];
+    timeMs: number;
+    minOps: number;
+    allocOps: number;      // > 0: allocation pass instead of timing
+    allocFile: string;
+}
+
+async function runLevel(op: () => Promise<unknown>, concurrency: number, timeMs: number, minOps: number) {
+    for (let i = 0; i < concurrency; i++) await op();   // warm pools, sessions, connections
+
+    const latencies: number[] = [];
+    const t0 = performance.now();
+    const done = () => performance.now() - t0 >= timeMs && latencies.length >= minOps;
+    const worker = async () => {
+        while (!done()) {
+            const t = performance.now();
+            await op();
+            latencies.push(performance.now() - t);
+        }
+    };
+    await Promise.all(Array.from({ length: concurrency }, worker));
+    const seconds = (performance.now() - t0) / 1000;
+
+    latencies.sort((x, y) => x - y);
+    const mean = latencies.reduce((s, v) => s + v, 0) / latencies.length;
+    return {
+        concurrency,
+        ops: latencies.length,
+        seconds: round(seconds),
+        opsPerSec: round(latencies.length / seconds),
+        latencyMs: {
+            mean: round(mean),
+            p50: round(percentile(latencies, 0.5)),
+            p90: round(percentile(latencies, 0.9)),
+            p99: round(percentile(latencies, 0.99)),
+            max: round(latencies[latencies.length - 1])
+        }
+    };
+}
+
+function readAllocs(file: string) {
+    const b = fs.readFileSync(file);
+    return { allocs: Number(b.readBigUInt64LE(0)), frees: Number(b.readBigUInt64LE(8)), bytes: Number(b.readBigUInt64LE(16)) };
+}
+
+function statsOf(lib: Lib, addon: Scenario["addon"]): any {
+    if (addon === "sticker") return lib.stickerStats();
+    if (addon === "converter") return lib.converterStats();
+    return lib.fetchStats();
+}
+
+async function runChild(cfg: ChildConfig): Promise<object> {
+    const lib: Lib = await import("../export.js");
+    const s = SCENARIOS.find((x) => x.name === cfg.scenario)!;
+    const input = cfg.input ? fs.readFileSync(cfg.input) : Buffer.alloc(0);
+    const op = () => s.op(lib, input, cfg.url);
+
+    if (cfg.allocOps > 0) {
+        for (let i = 0; i < 3; i++) await op();
+        const before = readAllocs(cfg.allocFile);
+        for (let i = 0; i < cfg.allocOps; i++) await op();
+        const after = readAllocs(cfg.allocFile);
+        return {
+            ops: cfg.allocOps,
+            perOp: round((after.allocs - before.allocs) / cfg.allocOps),
+            bytesPerOp: Math.round((after.bytes - before.bytes) / cfg.allocOps),
+            freesPerOp: round((after.frees - before.frees) / cfg.allocOps)
+        };
+    }
+
+    const levels = [];
+    for (const c of cfg.levels) levels.push(await runLevel(op, c, cfg.timeMs, cfg.minOps));
+    const stats = statsOf(lib, s.addon);
+    const stages: Record<string, unknown> = {};
+    for (const [k, v] of Object.entries<any>(stats.stages || {})) if (v.count > 0) stages[k] = v;
+    return {
+        levels,
+        memory: {
+            peakRss: stats.memory?.peakRss ?? process.memoryUsage().rss,
+            heapUsed: process.memoryUsage().heapUsed,
+            external: process.memoryUsage().external
+        },
+        stages,
+        counters: stats.counters
+    };
+}
+
+// ---- parent -------------------------------------------------------------
+
+function spawnChild(cfg: ChildConfig, env: NodeJS.ProcessEnv): Promise<any> {
+    return new Promise((resolve, reject) => {
+        const p = spawn(process.execPath, [fileURLToPath(import.meta.url), "--child", JSON.stringify(cfg)], {
+            cwd: root,
+            env,
+            stdio: ["ignore", "pipe", "inherit"]
+        });
+        let out = "";
+        p.stdout.on("data", (d) => { out += d; });
+        p.on("error", reject);
+        p.on("close", (code) => {
+            const line = out.trim().split("\n").pop() || "";
+            try {
+                const r = JSON.parse(line);
+                if (r.error) reject(new Error(r.error));
+                else resolve(r);
+            } catch {
+                reject(new Error(`${cfg.scenario} exited with ${code}`));
+            }
+        });
+    });
+}
+
+// Builds the preloadable malloc counter; null if there is no compiler, or
+// the addons run under a sanitizer that already owns malloc.
+function buildAllocCounter(): string | null {
+    if ((process.env.LD_PRELOAD || "").includes("san")) return null;
+    const src = path.join(__dirname, "alloc-count.cpp");
+    const lib = path.join(root, "build", "bench-alloc-count.so");
+    if (fs.existsSync(lib) && fs.statSync(lib).mtimeMs >= fs.statSync(src).mtimeMs) return lib;
+    fs.mkdirSync(path.dirname(lib), { recursive: true });
+    const r = spawnSync("g++", ["-O2", "-shared", "-fPIC", src, "-o", lib], { stdio: "inherit" });
+    return r.status === 0 ? lib : null;
+}
+
+async function main() {
+    const args = parseArgs(process.argv.slice(2));
+    if (args.child) {
+        try {
+            console.log(JSON.stringify(await runChild(JSON.parse(args.child))));
+        } catch (e: any) {
+            console.log(JSON.stringify({ error: e?.message || String(e) }));
+        }
+        process.exit(0);
+    }
+
+    const corpusDir = process.env.BENCH_CORPUS || path.join(root, "build", "bench-corpus");
+    const scenarios = SCENARIOS.filter((s) => s.name.includes(args.filter));
+    const corpus: Record<string, CorpusEntry> = prepareCorpus(corpusDir, scenarios.map((s) => s.input || ""));
+    const origins = await startOrigins(prepareCert(corpusDir));
+    const allocLib = args.allocs ? buildAllocCounter() : null;
+    const allocFile = path.join(os.tmpdir(), `liora-bench-allocs-${process.pid}`);
+
+    const results = [];
+    for (const s of scenarios) {
+        const base = s.url === "http1" ? origins.http1 : s.url === "http2" ? origins.http2 : "";
+        const entry = s.input ? corpus[s.input] : undefined;
+        const result: Record<string, unknown> = { name: s.name, addon: s.addon };
+        if (entry) result.input = { file: s.input, bytes: entry.bytes, sha1: entry.sha1 };
+        if (s.url && !base) {
+            result.skipped = "no HTTP/2 origin (openssl not found)";
+            results.push(result);
+            continue;
+        }
+        const cfg: ChildConfig = {
+            scenario: s.name,
+            input: entry ? entry.path : "",
+            url: base ? base + s.path : "",
+            levels: levelsFor(s, args.maxConcurrency),
+            timeMs: args.timeMs,
+            minOps: args.minOps,
+            allocOps: 0,
+            allocFile
+        };
+        console.error(`   > ${s.name} at concurrency ${cfg.levels.join(", ")}`);
+        try {
+            Object.assign(result, await spawnChild(cfg, process.env));
+            if (allocLib) {
+                fs.rmSync(allocFile, { force: true });
+                const env = { ...process.env, LD_PRELOAD: allocLib, LIORA_BENCH_ALLOCS: allocFile };
+                result.allocations = await spawnChild({ ...cfg, allocOps: 20 }, env);
+            }
+        } catch (e: any) {
+            result.error = e.message;
+        }
+        results.push(result);
+    }
+    fs.rmSync(allocFile, { force: true });
+    await origins.close();
+
+    const pkg = JSON.parse(fs.readFileSync(path.join(root, "package.json"), "utf8"));
+    const report = {
+        bench: "liora-lib",
+        version: pkg.version,
+        label: args.label,
+        date: new Date().toISOString(),
+        runtime: typeof Bun !== "undefined" ? `bun ${Bun.version}` : `node ${process.version}`,
+        platform: `${process.platform}-${process.arch}`,
+        cpu: os.cpus()[0]?.model || "",
+        cpus: os.availableParallelism(),
+        options: { timeMs: args.timeMs, minOps: args.minOps, maxConcurrency: args.maxConcurrency, allocations: !!allocLib },
+        results
+    };
+    const json = JSON.stringify(report, null, 2);
+    if (args.out) fs.writeFileSync(args.out, json + "\n");
+    console.log(json);
+    process.exit(0);
+}
+
+main();
@@ -0,0 +1,66 @@
+import http from "http";
+import http2 from "http2";
+import type { AddressInfo } from "net";
+
+// Local origins for the fetch scenarios, run by the parent process so
+// their memory does not count against the child being measured. Both serve
+// /small (1 KiB) and /large (1 MiB) from memory.
+
+const BODIES: Record<string, Buffer> = {
+    "/small": Buffer.alloc(1024, "a"),
+    "/large": Buffer.alloc(1024 * 1024, "b")
+};
+
+interface Origins {
+    http1: string;
+    http2: string | null;
+    close(): Promise<void>;
+}
+
+function bodyFor(url: string | undefined): Buffer | undefined {
+    return BODIES[(url || "").split("?")[0]];
+}
+
+function listen(server: http.Server | http2.Http2SecureServer): Promise<number> {
+    return new Promise((resolve, reject) => {
+        server.once("error", reject);
+        server.listen(0, "127.0.0.1", () => resolve((server.address() as AddressInfo).port));
+    });
+}
+
+async function startOrigins(tls: { key: string; cert: string } | null): Promise<Origins> {
+    const h1 = http.createServer((req, res) => {
+        const body = bodyFor(req.url);
+        if (!body) { res.writeHead(404).end(); return; }
+        res.writeHead(200, { "content-type": "application/octet-stream", "content-length": body.length });
+        res.end(body);
+    });
+    h1.keepAliveTimeout = 60000;
+    const h1Port = await listen(h1);
+
+    let h2: http2.Http2SecureServer | null = null;
+    let h2Port = 0;
+    if (tls) {
+        h2 = http2.createSecureServer({ key: tls.key, cert: tls.cert, allowHTTP1: false });
+        h2.on("stream", (stream, headers) => {
+            const body = bodyFor(headers[":path"] as string);
+            if (!body) { stream.respond({ ":status": 404 }); stream.end(); return; }
+            stream.respond({ ":status": 200, "content-type": "application/octet-stream", "content-length": body.length });
+            stream.end(body);
+        });
+        h2Port = await listen(h2);
+    }
+
+    return {
+        http1: `http://127.0.0.1:${h1Port}`,
+        http2: h2 ? `https://127.0.0.1:${h2Port}` : null,
+        async close() {
+            h1.closeAllConnections();
+            await new Promise<void>((resolve) => h1.close(() => resolve()));
+            if (h2) await new Promise<void>((resolve) => h2!.close(() => resolve()));
+        }
+    };
+}
+
+export { startOrigins };
+export type { Origins };
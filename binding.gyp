@@ -1,5 +1,6 @@
 {
   "variables": {
+    "sanitize%": "",
     "common_cflags_cc": [
       "-std=c++20",
       "-O3",
@@ -28,6 +29,16 @@
     ]
   },
 
+  "target_defaults": {
+    "conditions": [
+      ["sanitize!=''", {
+        "cflags_cc!": ["-O3", "-flto=auto", "-fuse-linker-plugin", "-fomit-frame-pointer"],
+        "cflags_cc": ["-O1", "-g", "-fno-omit-frame-pointer", "-fsanitize=<(sanitize)"],
+        "ldflags": ["-fsanitize=<(sanitize)"]
+      }]
+    ]
+  },
+
   "targets": [
     {
       "target_name": "sticker",
@@ -1,5 +1,7 @@
 import path from "path";
+import { promises as fsp } from "fs";
 import { fileURLToPath } from "url";
+import { Duplex } from "stream";
 
 interface AddonOptions {
     packName?: string;
@@ -12,6 +14,14 @@ interface StickerOptions extends AddonOptions {
     quality?: number;
     fps?: number;
     maxDuration?: number;
+    startTime?: number;
+    threads?: number;
+    kmin?: number;
+    kmax?: number;
+    method?: number;
+    maxBytes?: number;
+    hwaccel?: boolean | "auto" | "vaapi" | "cuda" | "nvdec" | "qsv";
+    trace?: boolean;
 }
 
 interface ConvertOptions {
@@ -21,39 +31,267 @@ interface ConvertOptions {
     sampleRate?: number;
     ptt?: boolean;
     vbr?: boolean;
+    remux?: boolean;
+    trace?: boolean;
 }
 
+interface ConvertStreamOptions extends ConvertOptions {
+    highWaterMark?: number;
+}
+
+interface ConvertStreamHandle {
+    write(chunk: Buffer): boolean;
+    end(): void;
+    destroy(): void;
+    promise: Promise<void>;
+}
+
+interface PoolOptions {
+    threads?: number;
+    maxQueue?: number;
+    onFull?: "reject" | "wait";
+    maxWaiting?: number;
+}
+
+interface PoolStats {
+    threads: number;
+    running: number;
+    queued: number;
+    waiting: number;
+    completed: number;
+    rejected: number;
+}
+
+interface CacheOptions {
+    maxBytes?: number;
+    spillDir?: string | null;
+    spillMaxBytes?: number;
+}
+
+interface CacheStats {
+    hits: number;
+    misses: number;
+    evictions: number;
+    spills: number;
+    diskHits: number;
+    entries: number;
+    bytes: number;
+    diskEntries: number;
+    diskBytes: number;
+}
+
+interface EngineOptions extends PoolOptions {
+    cache?: CacheOptions;
+}
+
+type EngineConfig = Required<PoolOptions> & { cache: Required<CacheOptions> };
+
+// Milliseconds per stage; histogram percentiles are bucket upper edges.
+interface StageStats {
+    count: number;
+    totalMs: number;
+    meanMs: number;
+    p50Ms: number;
+    p90Ms: number;
+    p99Ms: number;
+    maxMs: number;
+}
+
+// With `trace: true`: milliseconds spent in each stage the call went through.
+type StageTimings = Record<string, number>;
+
+interface ConverterStats {
+    pool: PoolStats;
+    cache: CacheStats;
+    // hits: jobs that reused an open encoder (only flushable encoders are kept)
+    sessions: { hits: number; misses: number };
+    remuxed: number;
+    memory: { peakRss: number };
+    stages: Record<"decode" | "resample" | "encode" | "remux", StageStats>;
+    counters: { bytesIn: number; bytesOut: number; failed: number };
+}
+
+interface Converter {
+    convert(input: Buffer | { data: Buffer }): Promise<Buffer>;
+    convertSync(input: Buffer | { data: Buffer }): Buffer;
+}
+
+interface ConverterHandle {
+    convert(input: Buffer | NativeSource): Promise<Buffer>;
+    convertSync(input: Buffer): Buffer;
+}
+
+interface StickerStats {
+    pool: PoolStats;
+    cache: CacheStats;
+    memory: {
+        peakWorkingSet: number;
+        lastPeakWorkingSet: number;
+        peakRss: number;
+    };
+    hwaccel: { decodes: number; fallbacks: number };
+    stages: Record<"demux" | "decode" | "scale" | "encode" | "exif", StageStats>;
+    counters: { bytesIn: number; bytesOut: number; frames: number; failed: number };
+}
+
+interface ProbeOptions {
+    fast?: boolean;
+}
+
+interface ProbeResult {
+    format: string;
+    duration: number;
+    bitrate: number;
+    animated: boolean;
+    video: { codec: string; width: number; height: number; fps: number; frames: number } | null;
+    audio: { codec: string; sampleRate: number; channels: number } | null;
+}
+
+interface StickerJob {
+    promise: Promise<Buffer>;
+    abort: () => void;
+}
+
+// Opaque handle to a body still being downloaded by the fetch addon; only
+// the native sticker and converter code can read it.
+declare const nativeSourceBrand: unique symbol;
+type NativeSource = { readonly [nativeSourceBrand]: true };
+
 interface StickerNativeAddon {
     addExif(buffer: Buffer, meta: AddonOptions): Buffer;
+    addExifBatch(buffers: Buffer[], meta: AddonOptions): Buffer[];
     sticker(buffer: Buffer, opts: StickerOptions): Buffer;
+    startSticker(input: Buffer | NativeSource, opts: StickerOptions): StickerJob;
+    probe(buffer: Buffer, opts: ProbeOptions): ProbeResult;
+    configure(opts?: EngineOptions): EngineConfig;
+    stats(): StickerStats;
 }
 
 interface ConverterNativeAddon {
-    convert(buffer: Buffer, opts: ConvertOptions): Buffer | Promise<Buffer>;
+    convert(input: Buffer | NativeSource, opts: ConvertOptions): Promise<Buffer>;
+    convertSync(buffer: Buffer, opts: ConvertOptions): Buffer;
+    createConverter(opts: ConvertOptions): ConverterHandle;
+    createConvertStream(
+        opts: ConvertStreamOptions,
+        onData: (chunk: Buffer) => void | Promise<void>,
+        onDrain: () => void
+    ): ConvertStreamHandle;
+    configure(opts?: EngineOptions): EngineConfig;
+    stats(): ConverterStats;
+}
+
+interface FetchHeaders extends Iterable<[string, string]> {
+    get(name: string): string | null;
+    has(name: string): boolean;
+    forEach(callback: (value: string, name: string, headers: FetchHeaders) => void, thisArg?: any): void;
+    entries(): IterableIterator<[string, string]>;
+    keys(): IterableIterator<string>;
+    values(): IterableIterator<string>;
+    getSetCookie(): string[];
+    toJSON(): Record<string, string>;
 }
 
 interface FetchResponse {
     status: number;
     statusText?: string;
-    headers: Record<string, string>;
+    headers: FetchHeaders;
     url?: string;
     ok?: boolean;
     body: Buffer | ArrayBuffer | ArrayBufferView | number[] | null;
+    saved?: SavedFile;
+    cache?: "hit" | "revalidated" | "miss";
+    timings?: StageTimings;
     abort?: () => void;
 }
 
+interface FetchPoolOptions {
+    maxPerHost?: number;
+    idleTimeout?: number;
+    ioThreads?: number;
+    cache?: CacheOptions;
+}
+
+interface FetchStats {
+    connections: {
+        requests: number;
+        reusedConnections: number;
+        newConnections: number;
+        reuseRate: number;
+        handleReuses: number;
+        idleHandles: number;
+        active: number;
+        hosts: number;
+    };
+    transfers: {
+        running: number;
+        queued: number;
+        submitted: number;
+        completed: number;
+        aborted: number;
+    };
+    share: Record<"dns" | "cookie" | "sslSession" | "share", { locks: number; contended: number }>;
+    cache: {
+        hits: number;
+        revalidated: number;
+        misses: number;
+        stored: number;
+        storage: CacheStats;
+    };
+    memory: { peakRss: number };
+    stages: Record<"dns" | "connect" | "tls" | "ttfb" | "transfer" | "total", StageStats>;
+    counters: { bytesIn: number; bytesOut: number; failed: number };
+}
+
 interface FetchNativeAddon {
     startFetch?: (url: string, options: Record<string, any>) => { promise: Promise<FetchResponse>, abort: () => void };
     fetch?: (url: string, options: Record<string, any>) => Promise<FetchResponse>;
+    fetchMany?: (requests: FetchManyRequest[], options: Record<string, any>) => {
+        promise: Promise<(FetchResponse | Error)[] | number>,
+        abort: () => void
+    };
+    fetchSource?: (url: string, options: Record<string, any>) => {
+        source: NativeSource,
+        promise: Promise<FetchResponse>,
+        abort: () => void
+    };
+    configure(opts?: FetchPoolOptions): Required<FetchPoolOptions>;
+    stats(): FetchStats;
+}
+
+type FetchManyRequest = string | ({ url: string } & Record<string, any>);
+
+interface FetchManyOptions {
+    concurrency?: number;
+    perHostLimit?: number;
+    onResult?: (index: number, result: CustomResponse | Error) => void;
+}
+
+interface FetchStreamOptions extends Record<string, any> {
+    highWaterMark?: number;
+    queueLength?: number;
+}
+
+interface FetchStream extends ReadableStream<Buffer> {
+    response: Promise<CustomResponse>;
+    abort: () => void;
+}
+
+interface SavedFile {
+    path: string;
+    offset: number;
+    bytes: number;
 }
 
 interface CustomResponse {
     status: number;
     statusText: string;
-    headers: Record<string, string>;
+    headers: FetchHeaders;
     url: string;
     ok: boolean;
     body: Buffer;
+    saved?: SavedFile;
+    cache?: "hit" | "revalidated" | "miss";
+    timings?: StageTimings;
     abort: () => void;
     arrayBuffer(): Promise<ArrayBuffer | SharedArrayBuffer>;
     buffer(): Promise<Buffer>;
@@ -124,125 +362,561 @@ function addExif(buffer: Buffer, meta: AddExifOptions = {}): Buffer {
     return stickerLoader.addon.addExif(buffer, meta);
 }
 
-function sticker(buffer: Buffer, options: StickerOptions = {}): Buffer {
-    if (!Buffer.isBuffer(buffer)) throw new Error("sticker() input must be a Buffer");
-    const opts: StickerOptions = {
+function addExifBatch(buffers: Buffer[], meta: AddExifOptions = {}): Buffer[] {
+    if (!Array.isArray(buffers) || !buffers.every((b) => Buffer.isBuffer(b))) {
+        throw new Error("addExifBatch() input must be an array of Buffers");
+    }
+    return stickerLoader.addon.addExifBatch(buffers, meta);
+}
+
+function normalizeStickerOptions(options: StickerOptions): StickerOptions {
+    return {
         crop: options.crop ?? false,
         quality: options.quality ?? 80,
         fps: options.fps ?? 15,
         maxDuration: options.maxDuration ?? 15,
+        startTime: options.startTime ?? 0,
+        threads: options.threads ?? 1,
+        kmin: options.kmin,
+        kmax: options.kmax,
+        method: options.method ?? 4,
+        maxBytes: options.maxBytes ?? 0,
+        hwaccel: options.hwaccel ?? false,
+        trace: !!options.trace,
         packName: options.packName || "",
         authorName: options.authorName || "",
         emojis: options.emojis || [],
     };
+}
+
+function sticker(buffer: Buffer, options: StickerOptions = {}): Buffer {
+    if (!Buffer.isBuffer(buffer)) throw new Error("sticker() input must be a Buffer");
+    const opts = normalizeStickerOptions(options);
     if (isWebP(buffer)) return stickerLoader.addon.addExif(buffer, opts);
     return stickerLoader.addon.sticker(buffer, opts);
 }
 
-function convert(input: Buffer | { data: Buffer }, options: ConvertOptions = {}): Buffer | Promise<Buffer> {
-    const buf: Buffer = Buffer.isBuffer(input) ? input : input?.data;
-    if (!Buffer.isBuffer(buf)) throw new Error("convert() input must be a Buffer");
-    return converterLoader.addon.convert(buf, {
+function startSticker(buffer: Buffer, options: StickerOptions = {}): StickerJob {
+    if (!Buffer.isBuffer(buffer)) throw new Error("startSticker() input must be a Buffer");
+    return stickerLoader.addon.startSticker(buffer, normalizeStickerOptions(options));
+}
+
+function stickerAsync(buffer: Buffer, options: StickerOptions = {}): Promise<Buffer> {
+    if (!Buffer.isBuffer(buffer)) return Promise.reject(new Error("stickerAsync() input must be a Buffer"));
+    return stickerLoader.addon.startSticker(buffer, normalizeStickerOptions(options)).promise;
+}
+
+function probe(buffer: Buffer, options: ProbeOptions = {}): ProbeResult {
+    if (!Buffer.isBuffer(buffer)) throw new Error("probe() input must be a Buffer");
+    return stickerLoader.addon.probe(buffer, { fast: options.fast !== false });
+}
+
+function configureSticker(options: EngineOptions = {}): EngineConfig {
+    return stickerLoader.addon.configure(options);
+}
+
+function stickerStats(): StickerStats {
+    return stickerLoader.addon.stats();
+}
+
+function normalizeConvertOptions(options: ConvertOptions): ConvertOptions {
+    return {
         format: options.format || "opus",
         bitrate: options.bitrate || "64k",
         channels: options.channels ?? 2,
         sampleRate: options.sampleRate || 48000,
         ptt: !!options.ptt,
         vbr: options.vbr !== false,
+        remux: options.remux !== false,
+        trace: !!options.trace,
+    };
+}
+
+function convert(input: Buffer | { data: Buffer }, options: ConvertOptions = {}): Promise<Buffer> {
+    const buf: Buffer = Buffer.isBuffer(input) ? input : input?.data;
+    if (!Buffer.isBuffer(buf)) return Promise.reject(new Error("convert() input must be a Buffer"));
+    return converterLoader.addon.convert(buf, normalizeConvertOptions(options));
+}
+
+function convertSync(input: Buffer | { data: Buffer }, options: ConvertOptions = {}): Buffer {
+    const buf: Buffer = Buffer.isBuffer(input) ? input : input?.data;
+    if (!Buffer.isBuffer(buf)) throw new Error("convertSync() input must be a Buffer");
+    return converterLoader.addon.convertSync(buf, normalizeConvertOptions(options));
+}
+
+/**
+ * Binds one conversion profile. Options are parsed once, and jobs with the
+ * same profile reuse an encoder and resampler kept warm on the worker
+ * threads.
+ */
+function createConverter(options: ConvertOptions = {}): Converter {
+    const handle = converterLoader.addon.createConverter(normalizeConvertOptions(options));
+    return {
+        convert(input) {
+            const buf: Buffer = Buffer.isBuffer(input) ? input : input?.data;
+            if (!Buffer.isBuffer(buf)) return Promise.reject(new Error("convert() input must be a Buffer"));
+            return handle.convert(buf);
+        },
+        convertSync(input) {
+            const buf: Buffer = Buffer.isBuffer(input) ? input : input?.data;
+            if (!Buffer.isBuffer(buf)) throw new Error("convertSync() input must be a Buffer");
+            return handle.convertSync(buf);
+        }
+    };
+}
+
+/**
+ * A Duplex that converts as it goes: write input chunks, read encoded
+ * output (or `for await` it) while the rest is still being encoded. Both
+ * sides are bounded natively, so memory stays flat for any input length
+ * that can be read front to back. MP4 with the index at the end cannot, so
+ * it is held until end() and converted from memory. m4a output is written as
+ * fragmented MP4.
+ */
+function createConvertStream(options: ConvertStreamOptions = {}): Duplex {
+    let writeDone: ((err?: Error | null) => void) | null = null;
+    let readWanted: (() => void) | null = null;
+
+    const duplex: Duplex = new Duplex({
+        write(chunk: Buffer, _enc, callback) {
+            if (native.write(Buffer.isBuffer(chunk) ? chunk : Buffer.from(chunk))) callback();
+            else writeDone = callback;
+        },
+        final(callback) {
+            native.end();
+            native.promise.then(() => {
+                duplex.push(null);
+                callback();
+            }, callback);
+        },
+        read() {
+            const wake = readWanted;
+            readWanted = null;
+            wake?.();
+        },
+        destroy(err, callback) {
+            native.destroy();
+            callback(err);
+        }
     });
+
+    const native = converterLoader.addon.createConvertStream(
+        { ...normalizeConvertOptions(options), highWaterMark: options.highWaterMark },
+        (chunk) => {
+            if (duplex.push(chunk)) return;
+            return new Promise<void>((resolve) => { readWanted = resolve; });
+        },
+        () => {
+            const done = writeDone;
+            writeDone = null;
+            done?.();
+        });
+    // Held weakly: the native promise is rooted until it settles, and a
+    // strong reference here would keep an abandoned stream (and the pool
+    // thread it occupies) alive forever.
+    const ref = new WeakRef(duplex);
+    native.promise.catch((err) => ref.deref()?.destroy(err));
+    return duplex;
+}
+
+function configureConverter(options: EngineOptions = {}): EngineConfig {
+    return converterLoader.addon.configure(options);
+}
+
+function converterStats(): ConverterStats {
+    return converterLoader.addon.stats();
+}
+
+function configureFetch(options: FetchPoolOptions = {}): Required<FetchPoolOptions> {
+    return fetchLoader.addon.configure(options);
+}
+
+function fetchStats(): FetchStats {
+    return fetchLoader.addon.stats();
 }
 
 type NativeFetchResult = { promise: Promise<FetchResponse>, abort?: () => void };
 
-function fetch(url: string, options: Record<string, any> = {}): Promise<CustomResponse> {
-    if (typeof url !== "string") throw new TypeError("fetch() requires a URL string");
-    
+function startNativeFetch(url: string, options: Record<string, any>): NativeFetchResult {
     const fetchNative = fetchLoader.addon;
     if (!fetchNative) throw new Error("Native fetch addon not loaded");
 
     const nativeFunc = fetchNative.startFetch || fetchNative.fetch;
     if (typeof nativeFunc !== "function") throw new Error("No valid native fetch entrypoint");
 
-    const exec: NativeFetchResult =
-        typeof fetchNative.startFetch === "function"
-            ? fetchNative.startFetch(url, options)
-            : {
-                promise: (nativeFunc(url, options) as Promise<FetchResponse>),
-                abort: undefined
-            };
+    return typeof fetchNative.startFetch === "function"
+        ? fetchNative.startFetch(url, options)
+        : {
+            promise: (nativeFunc(url, options) as Promise<FetchResponse>),
+            abort: undefined
+        };
+}
+
+function toCustomResponse(res: FetchResponse, url: string, abort?: () => void): CustomResponse {
+    if (!res || typeof res !== "object") {
+        throw new Error("Invalid response from native fetch");
+    }
 
-    const promise = exec.promise;
+    let body: Buffer;
+
+    if (Buffer.isBuffer(res.body)) {
+        body = res.body;
+    } else if (res.body instanceof ArrayBuffer) {
+        body = Buffer.from(res.body);
+    } else if (ArrayBuffer.isView(res.body)) {
+        body = Buffer.from(res.body.buffer, res.body.byteOffset, res.body.byteLength);
+    } else if (Array.isArray(res.body)) {
+        body = Buffer.from(res.body as number[]);
+    } else {
+        body = Buffer.from([]);
+    }
 
-    return promise
-        .then((res) => {
-            if (!res || typeof res !== "object") {
-                throw new Error("Invalid response from native fetch");
+    const cachedTextRef: { val: string | null } = { val: null };
+
+    return {
+        status: res.status,
+        statusText: res.statusText || "",
+        headers: res.headers,
+        url: res.url || url,
+        ok: res.status >= 200 && res.status < 300,
+        body: body,
+        saved: res.saved,
+        cache: res.cache,
+        timings: res.timings,
+        abort: abort || (() => {}),
+        arrayBuffer() {
+            // native bodies own their whole ArrayBuffer; hand it out as is
+            if (body.byteOffset === 0 && body.byteLength === body.buffer.byteLength) {
+                return Promise.resolve(body.buffer);
             }
-
-            let body: Buffer;
-
-            if (Buffer.isBuffer(res.body)) {
-                body = res.body;
-            } else if (res.body instanceof ArrayBuffer) {
-                body = Buffer.from(res.body);
-            } else if (ArrayBuffer.isView(res.body)) {
-                body = Buffer.from(res.body.buffer, res.body.byteOffset, res.body.byteLength);
-            } else if (Array.isArray(res.body)) {
-                body = Buffer.from(res.body as number[]);
-            } else {
-                body = Buffer.from([]);
+            return Promise.resolve(body.buffer.slice(
+                body.byteOffset,
+                body.byteOffset + body.byteLength
+            ));
+        },
+        buffer() {
+            return Promise.resolve(body);
+        },
+        text() {
+            if (cachedTextRef.val === null) {
+                cachedTextRef.val = textDecoder.decode(body);
             }
-
-            const cachedTextRef: { val: string | null } = { val: null };
-
-            const out: CustomResponse = {
-                status: res.status,
-                statusText: res.statusText || "",
-                headers: res.headers || {},
-                url: res.url || url,
-                ok: res.status >= 200 && res.status < 300,
-                body: body,
-                abort: exec.abort || (() => {}),
-                arrayBuffer() {
-                    return Promise.resolve(body.buffer.slice(
-                        body.byteOffset,
-                        body.byteOffset + body.byteLength
-                    ));
-                },
-                buffer() {
-                    return Promise.resolve(body);
-                },
-                text() {
+            return Promise.resolve(cachedTextRef.val);
+        },
+        json() {
+            return new Promise((resolve, reject) => {
+                try {
                     if (cachedTextRef.val === null) {
                         cachedTextRef.val = textDecoder.decode(body);
                     }
-                    return Promise.resolve(cachedTextRef.val);
-                },
-                json() {
-                    return new Promise((resolve, reject) => {
-                        try {
-                            if (cachedTextRef.val === null) {
-                                cachedTextRef.val = textDecoder.decode(body);
-                            }
-                            resolve(JSON.parse(cachedTextRef.val));
-                        } catch (e) {
-                            reject(new Error(`Invalid JSON: ${e instanceof Error ? e.message : String(e)}`));
-                        }
-                    });
-                },
-            };
-
-            return out;
-        })
-        .catch((err) => {
-            const msg = err instanceof Error ? err.message : String(err);
-            throw new Error(msg);
+                    resolve(JSON.parse(cachedTextRef.val));
+                } catch (e) {
+                    reject(new Error(`Invalid JSON: ${e instanceof Error ? e.message : String(e)}`));
+                }
+            });
+        },
+    };
+}
+
+function rethrow(err: unknown): never {
+    const msg = err instanceof Error ? err.message : String(err);
+    throw new Error(msg);
+}
+
+function fetch(url: string, options: Record<string, any> = {}): Promise<CustomResponse> {
+    if (typeof url !== "string") throw new TypeError("fetch() requires a URL string");
+    if (options.saveTo !== undefined && (options.segments ?? 1) > 1) {
+        return segmentedDownload(url, options);
+    }
+
+    const exec = startNativeFetch(url, options);
+    return exec.promise
+        .then((res) => toCustomResponse(res, url, exec.abort))
+        .catch(rethrow);
+}
+
+/**
+ * Runs a batch of requests natively: at most `concurrency` (default 64,
+ * 0 = all) in flight, `perHostLimit` per host, and finished responses are
+ * handed back to JS in groups. Resolves with one entry per request, in
+ * order, holding the response or the Error it failed with. With `onResult`
+ * each result is passed there as it lands instead and the promise resolves
+ * once all of them have been delivered.
+ */
+function fetchMany(
+    requests: FetchManyRequest[],
+    options: FetchManyOptions = {}
+): Promise<(CustomResponse | Error)[]> & { abort: () => void } {
+    if (!Array.isArray(requests)) throw new TypeError("fetchMany() requires an array of requests");
+    const native = fetchLoader.addon;
+    if (!native || typeof native.fetchMany !== "function") throw new Error("Native fetchMany not available");
+
+    const urlOf = (i: number) => {
+        const r = requests[i];
+        return typeof r === "string" ? r : r.url;
+    };
+    const wrap = (i: number, r: FetchResponse | Error): CustomResponse | Error =>
+        r instanceof Error ? r : toCustomResponse(r, urlOf(i), exec.abort);
+
+    const { onResult, ...rest } = options;
+    const nativeOpts: Record<string, any> = { ...rest };
+    if (onResult) {
+        nativeOpts.onResult = (group: { index: number, response?: FetchResponse, error?: Error }[]) => {
+            for (const item of group) onResult(item.index, wrap(item.index, item.error ?? item.response!));
+        };
+    }
+
+    const exec = native.fetchMany(requests, nativeOpts);
+    const promise = exec.promise.then((out) =>
+        Array.isArray(out) ? out.map((r, i) => wrap(i, r)) : []);
+    return Object.assign(promise, { abort: exec.abort });
+}
+
+/**
+ * Downloads `url` straight into a native consumer: decoding overlaps the
+ * download and the body never becomes a JS Buffer. The consumer's error is
+ * what surfaces (a failed download shows up as its read error); once it has
+ * finished, an early end of the download (it stopped reading) is ignored.
+ */
+function pipeFromUrl(
+    url: string,
+    fetchOptions: Record<string, any>,
+    consume: (source: NativeSource) => { promise: Promise<Buffer>, abort?: () => void }
+): StickerJob {
+    if (typeof url !== "string") throw new TypeError("a URL string is required");
+    const native = fetchLoader.addon;
+    if (!native || typeof native.fetchSource !== "function") throw new Error("Native fetchSource not available");
+
+    const fetched = native.fetchSource(url, fetchOptions);
+    fetched.promise.catch(() => {});
+    let job: { promise: Promise<Buffer>, abort?: () => void };
+    try {
+        job = consume(fetched.source);
+    } catch (e) {
+        fetched.abort();
+        throw e;
+    }
+    const promise = job.promise.catch((err) => {
+        fetched.abort();
+        return rethrow(err);
+    });
+    return {
+        promise,
+        abort: () => {
+            fetched.abort();
+            job.abort?.();
+        }
+    };
+}
+
+function stickerFromUrl(url: string, options: StickerOptions = {}, fetchOptions: Record<string, any> = {}): StickerJob {
+    const opts = normalizeStickerOptions(options);
+    return pipeFromUrl(url, fetchOptions, (src) => stickerLoader.addon.startSticker(src, opts));
+}
+
+function convertFromUrl(url: string, options: ConvertOptions = {}, fetchOptions: Record<string, any> = {}): StickerJob {
+    const opts = normalizeConvertOptions(options);
+    return pipeFromUrl(url, fetchOptions, (src) => ({ promise: converterLoader.addon.convert(src, opts) }));
+}
+
+const SEGMENT_ALIGN = 1024 * 1024;
+
+interface SegmentState {
+    url: string;
+    size: number;
+    validator: string;
+    parts: { start: number; end: number; done: boolean }[];
+}
+
+function headerValue(res: CustomResponse, name: string): string | undefined {
+    return res.headers.get(name) ?? undefined;
+}
+
+async function readSegmentState(file: string): Promise<SegmentState | null> {
+    try {
+        return JSON.parse(await fsp.readFile(file, "utf8")) as SegmentState;
+    } catch {
+        return null;
+    }
+}
+
+/**
+ * `saveTo` with `segments > 1`: probes the URL with HEAD and, when the server
+ * accepts byte ranges, downloads `segments` ranges in parallel straight into
+ * the file (multiplexed over one connection on HTTP/2). The ranges finished so
+ * far are recorded in `<saveTo>.segments.json`, so `resume: true` only
+ * re-fetches the ranges that did not complete. Falls back to a single
+ * transfer when ranges are not supported.
+ */
+async function segmentedDownload(url: string, options: Record<string, any>): Promise<CustomResponse> {
+    const { saveTo, segments, resume, direct, preallocate, onProgress, onData, ...rest } = options;
+    if (typeof saveTo !== "string") throw new TypeError("segments > 1 requires saveTo to be a file path");
+    if (onData !== undefined) throw new TypeError("onData cannot be combined with segments > 1");
+
+    const head = await fetch(url, { ...rest, method: "HEAD" });
+    const size = Number(headerValue(head, "content-length"));
+    const ranges = /bytes/i.test(headerValue(head, "accept-ranges") ?? "");
+    if (!head.ok || !ranges || !(size > 0)) {
+        return fetch(url, { ...rest, saveTo, resume, direct, preallocate, onProgress });
+    }
+
+    const validator = headerValue(head, "etag") ?? headerValue(head, "last-modified") ?? "";
+    const statePath = `${saveTo}.segments.json`;
+    const count = Math.max(1, Math.min(Number(segments), Math.ceil(size / SEGMENT_ALIGN)));
+
+    let state = resume ? await readSegmentState(statePath) : null;
+    const reuse = !!state && state.url === url && state.size === size && state.validator === validator;
+    if (!reuse) {
+        const step = Math.ceil(size / count / SEGMENT_ALIGN) * SEGMENT_ALIGN;
+        const parts: SegmentState["parts"] = [];
+        for (let start = 0; start < size; start += step) {
+            parts.push({ start, end: Math.min(size, start + step) - 1, done: false });
+        }
+        state = { url, size, validator, parts };
+        const fh = await fsp.open(saveTo, "w");
+        try { await fh.truncate(size); } finally { await fh.close(); }
+    }
+    const st = state as SegmentState;
+
+    let saving = Promise.resolve();
+    const saveState = () => {
+        saving = saving.then(() => fsp.writeFile(statePath, JSON.stringify(st))).catch(() => {});
+        return saving;
+    };
+    await saveState();
+
+    const got = st.parts.map((p) => (p.done ? p.end - p.start + 1 : 0));
+    const total = () => got.reduce((a, b) => a + b, 0);
+
+    // The first segment to fail aborts the ones still running, so a failed
+    // download does not keep transferring into the file.
+    const running = new Set<() => void>();
+    let failed = false;
+
+    await Promise.all(st.parts.map(async (part, i) => {
+        if (part.done) return;
+        const length = part.end - part.start + 1;
+        const exec = startNativeFetch(url, {
+            ...rest,
+            saveTo,
+            direct,
+            range: [part.start, part.end],
+            preallocate: preallocate ? length : 0,
+            onProgress: (p: { downloaded: number }) => {
+                got[i] = p.downloaded;
+                onProgress?.({
+                    segment: i,
+                    segmentDownloaded: p.downloaded,
+                    segmentTotal: length,
+                    downloaded: total(),
+                    total: size,
+                    uploaded: 0,
+                    utotal: 0,
+                });
+            },
+        });
+        const abort = exec.abort ?? (() => {});
+        running.add(abort);
+        try {
+            const res = await exec.promise.catch(rethrow);
+            if (res.status !== 206 || (res.saved?.bytes ?? 0) !== length) {
+                throw new Error(`segment ${i} failed (status ${res.status})`);
+            }
+        } catch (err) {
+            running.delete(abort);
+            if (!failed) {
+                failed = true;
+                for (const other of running) other();
+            }
+            throw err;
+        }
+        running.delete(abort);
+        got[i] = length;
+        part.done = true;
+        await saveState();
+    }));
+
+    await saving;
+    await fsp.rm(statePath, { force: true });
+
+    return {
+        ...head,
+        status: 200,
+        statusText: "OK",
+        ok: true,
+        saved: { path: saveTo, offset: 0, bytes: size },
+    };
+}
+
+/**
+ * Streams the response body as a ReadableStream of Buffer batches (also an
+ * async iterator). Batches are `highWaterMark` bytes (default 256 KiB); when
+ * the consumer falls behind, the native transfer is paused instead of
+ * buffering. `response` resolves with status and headers once the body is
+ * done; its `body` is empty.
+ */
+function fetchStream(url: string, options: FetchStreamOptions = {}): FetchStream {
+    if (typeof url !== "string") throw new TypeError("fetchStream() requires a URL string");
+
+    let controller!: ReadableStreamDefaultController<Buffer>;
+    let waiters: Array<() => void> = [];
+    const release = () => {
+        const w = waiters;
+        waiters = [];
+        for (const fn of w) fn();
+    };
+
+    const { queueLength = 2, ...rest } = options;
+    const stream = new ReadableStream<Buffer>({
+        start(c) { controller = c; },
+        pull() { release(); },
+        cancel() { exec.abort?.(); release(); },
+    }, { highWaterMark: Math.max(1, queueLength) });
+
+    const onData = (chunk: Buffer) => {
+        controller.enqueue(chunk);
+        if ((controller.desiredSize ?? 1) > 0) return;
+        // resolved on the next pull(): returns the batch's credit to native
+        return new Promise<void>((resolve) => { waiters.push(resolve); });
+    };
+
+    const exec = startNativeFetch(url, { ...rest, onData });
+    const response = exec.promise.then(
+        (res) => {
+            try { controller.close(); } catch {}
+            release();
+            return toCustomResponse(res, url, exec.abort);
+        },
+        (err) => {
+            try { controller.error(err); } catch {}
+            release();
+            return rethrow(err);
         });
+    response.catch(() => {});   // errors also surface through the stream
+
+    return Object.assign(stream, { response, abort: exec.abort || (() => {}) });
 }
 
 export {
     addExif,
+    addExifBatch,
     sticker,
+    startSticker,
+    stickerAsync,
+    stickerFromUrl,
+    configureSticker,
+    stickerStats,
+    probe,
     convert,
-    fetch
+    convertSync,
+    createConverter,
+    createConvertStream,
+    convertFromUrl,
+    configureConverter,
+    converterStats,
+    fetch,
+    fetchMany,
+    fetchStream,
+    configureFetch,
+    fetchStats
 };
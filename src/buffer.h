@@ -0,0 +1,47 @@
+#pragma once
+#include <napi.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// A result allocated by a C library (libwebp, libav*) together with the
+// function that frees it. ToBuffer() hands the allocation to a JS Buffer
+// whose finalizer frees it, so results cross the N-API boundary without a
+// copy. Where external buffers are disallowed, NewOrCopy copies instead and
+// the allocation is released immediately.
+class OwnedBuffer {
+public:
+  using FreeFn = void(*)(void*);
+
+  OwnedBuffer() = default;
+  OwnedBuffer(uint8_t* data, size_t size, FreeFn fn) : data_(data), size_(size), free_(fn) {}
+  OwnedBuffer(const OwnedBuffer&) = delete;
+  OwnedBuffer& operator=(const OwnedBuffer&) = delete;
+  OwnedBuffer(OwnedBuffer&& o) noexcept { swap(o); }
+  OwnedBuffer& operator=(OwnedBuffer&& o) noexcept { if (this != &o){ reset(); swap(o); } return *this; }
+  ~OwnedBuffer(){ reset(); }
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void swap(OwnedBuffer& o) noexcept {
+    std::swap(data_, o.data_); std::swap(size_, o.size_); std::swap(free_, o.free_);
+  }
+  void reset(){
+    if (data_ && free_) free_(data_);
+    data_ = nullptr; size_ = 0; free_ = nullptr;
+  }
+
+  Napi::Buffer<uint8_t> ToBuffer(Napi::Env env){
+    if (!data_) return Napi::Buffer<uint8_t>::New(env, 0);
+    uint8_t* p = data_; size_t n = size_; FreeFn fn = free_;
+    data_ = nullptr; size_ = 0; free_ = nullptr;
+    return Napi::Buffer<uint8_t>::NewOrCopy(env, p, n, [fn](Napi::Env, uint8_t* d){ if (fn) fn(d); });
+  }
+
+private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  FreeFn free_ = nullptr;
+};
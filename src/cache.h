@@ -0,0 +1,312 @@
+#pragma once
+#include <napi.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include <cstring>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), the 64-bit variant of xxHash.
+static inline uint64_t xxh_rotl64(uint64_t x, int r){ return (x << r) | (x >> (64 - r)); }
+static inline uint64_t xxh_read64(const uint8_t* p){ uint64_t v; std::memcpy(&v, p, 8); return v; }
+static inline uint32_t xxh_read32(const uint8_t* p){ uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+static inline uint64_t XXH64(const void* input, size_t len, uint64_t seed = 0){
+  const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL, P3 = 0x165667B19E3779F9ULL;
+  const uint64_t P4 = 0x85EBCA77C2B2AE63ULL, P5 = 0x27D4EB2F165667C5ULL;
+  auto round = [&](uint64_t acc, uint64_t v){ acc += v * P2; acc = xxh_rotl64(acc, 31); return acc * P1; };
+  auto merge = [&](uint64_t acc, uint64_t v){ acc ^= round(0, v); return acc * P1 + P4; };
+
+  const uint8_t* p = (const uint8_t*)input;
+  const uint8_t* end = p + len;
+  uint64_t h;
+  if (len >= 32){
+    uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+    const uint8_t* limit = end - 32;
+    do {
+      v1 = round(v1, xxh_read64(p));      v2 = round(v2, xxh_read64(p + 8));
+      v3 = round(v3, xxh_read64(p + 16)); v4 = round(v4, xxh_read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+    h = merge(h, v1); h = merge(h, v2); h = merge(h, v3); h = merge(h, v4);
+  } else {
+    h = seed + P5;
+  }
+  h += (uint64_t)len;
+
+  for (; p + 8 <= end; p += 8){ h ^= round(0, xxh_read64(p)); h = xxh_rotl64(h, 27) * P1 + P4; }
+  if (p + 4 <= end){ h ^= (uint64_t)xxh_read32(p) * P1; h = xxh_rotl64(h, 23) * P2 + P3; p += 4; }
+  for (; p < end; ++p){ h ^= (uint64_t)(*p) * P5; h = xxh_rotl64(h, 11) * P1; }
+
+  h ^= h >> 33; h *= P2; h ^= h >> 29; h *= P3; h ^= h >> 32;
+  return h;
+}
+
+static inline std::string HexU64(uint64_t v){
+  static const char* k = "0123456789abcdef";
+  std::string s(16, '0');
+  for (int i = 15; i >= 0; --i){ s[i] = k[v & 0xf]; v >>= 4; }
+  return s;
+}
+
+// Byte-capped LRU of encoded results keyed by input hash + normalized
+// options. Entries pushed out of memory are written to `spillDir` (when set)
+// as <xxh64(key)>.bin files holding the full key followed by the bytes, so a
+// later lookup - also from a new process - can still be served from disk.
+// Blobs are immutable and shared; callers copy them out before handing
+// anything mutable to JS.
+class ResultCache {
+public:
+  struct Options {
+    size_t maxBytes = 0;        // 0 = memory cache off
+    std::string spillDir;       // empty = no spill
+    size_t spillMaxBytes = 0;   // 0 = unbounded
+  };
+  struct Stats {
+    uint64_t hits, misses, evictions, spills, diskHits;
+    size_t entries, bytes, diskEntries, diskBytes;
+  };
+  using Blob = std::shared_ptr<const std::vector<uint8_t>>;
+
+  static std::string MakeKey(const uint8_t* data, size_t len, const std::string& opts){
+    return HexU64(XXH64(data, len)) + ":" + std::to_string(len) + ":" + opts;
+  }
+
+  bool Enabled(){
+    std::lock_guard<std::mutex> lk(mu_);
+    return opts_.maxBytes > 0 || !opts_.spillDir.empty();
+  }
+
+  Blob Get(const std::string& key){
+    std::string path;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      auto it = map_.find(key);
+      if (it != map_.end()){
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++hits_;
+        return it->second->blob;
+      }
+      if (opts_.spillDir.empty()){ ++misses_; return nullptr; }
+      path = spillPath(key);
+    }
+
+    Blob b = readSpill(path, key);
+    std::vector<Entry> victims;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (!b){ ++misses_; return nullptr; }
+      ++hits_; ++diskHits_;
+      if (b->size() <= opts_.maxBytes) insertLocked(key, b, victims);
+      else {
+        // would be evicted (and rewritten) at once; only refresh the file
+        auto d = diskMap_.find(spillName(key));
+        if (d != diskMap_.end()) disk_.splice(disk_.begin(), disk_, d->second);
+      }
+    }
+    spill(victims);
+    return b;
+  }
+
+  void Put(const std::string& key, const uint8_t* data, size_t len){
+    Put(key, std::make_shared<const std::vector<uint8_t>>(data, data + len));
+  }
+
+  // Shares `b` instead of copying it. With `replace`, an existing entry
+  // under `key` is swapped out (used for metadata that is updated in place).
+  void Put(const std::string& key, Blob b, bool replace = false){
+    std::vector<Entry> victims;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (opts_.maxBytes == 0 && opts_.spillDir.empty()) return;
+      auto it = map_.find(key);
+      if (it != map_.end()){
+        if (!replace) return;
+        bytes_ -= it->second->blob->size();
+        lru_.erase(it->second);
+        map_.erase(it);
+      }
+      insertLocked(key, b, victims);
+    }
+    spill(victims);
+  }
+
+  void Configure(const Options& o){
+    std::vector<Entry> victims;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      bool dirChanged = o.spillDir != opts_.spillDir;
+      opts_ = o;
+      if (dirChanged) scanSpillLocked();
+      evictLocked(victims);
+    }
+    spill(victims);
+  }
+
+  Options GetOptions(){
+    std::lock_guard<std::mutex> lk(mu_);
+    return opts_;
+  }
+
+  Stats GetStats(){
+    std::lock_guard<std::mutex> lk(mu_);
+    return Stats{ hits_, misses_, evictions_, spills_, diskHits_, map_.size(), bytes_, disk_.size(), diskBytes_ };
+  }
+
+private:
+  struct Entry { std::string key; Blob blob; };
+  struct DiskEntry { std::string name; size_t size; };
+
+  static std::string spillName(const std::string& key){
+    return HexU64(XXH64(key.data(), key.size())) + ".bin";
+  }
+
+  std::string spillPath(const std::string& key) const {
+    return (std::filesystem::path(opts_.spillDir) / spillName(key)).string();
+  }
+
+  void insertLocked(const std::string& key, const Blob& b, std::vector<Entry>& victims){
+    lru_.push_front(Entry{key, b});
+    map_[key] = lru_.begin();
+    bytes_ += b->size();
+    evictLocked(victims);
+  }
+
+  void evictLocked(std::vector<Entry>& victims){
+    while (!lru_.empty() && bytes_ > opts_.maxBytes){
+      Entry& e = lru_.back();
+      bytes_ -= e.blob->size();
+      map_.erase(e.key);
+      ++evictions_;
+      if (!opts_.spillDir.empty()) victims.push_back(std::move(e));
+      lru_.pop_back();
+    }
+  }
+
+  static Blob readSpill(const std::string& path, const std::string& key){
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return nullptr;
+    uint32_t klen = 0;
+    if (!f.read((char*)&klen, 4) || klen != key.size()) return nullptr;
+    std::string k(klen, '\0');
+    if (!f.read(k.data(), klen) || k != key) return nullptr;
+    f.seekg(0, std::ios::end);
+    std::streamoff total = f.tellg();
+    std::streamoff off = 4 + (std::streamoff)klen;
+    if (total < off) return nullptr;
+    auto v = std::make_shared<std::vector<uint8_t>>((size_t)(total - off));
+    f.seekg(off);
+    if (!v->empty() && !f.read((char*)v->data(), (std::streamsize)v->size())) return nullptr;
+    return v;
+  }
+
+  // Writes evicted entries to the spill directory outside the lock, then
+  // trims the directory to spillMaxBytes, oldest spill first.
+  void spill(std::vector<Entry>& victims){
+    if (victims.empty()) return;
+    std::string dir;
+    { std::lock_guard<std::mutex> lk(mu_); dir = opts_.spillDir; }
+    if (dir.empty()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    for (auto& e : victims){
+      std::string name = spillName(e.key);
+      std::string path = (std::filesystem::path(dir) / name).string();
+      std::string tmp = path + ".tmp";
+      {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) continue;
+        uint32_t klen = (uint32_t)e.key.size();
+        f.write((const char*)&klen, 4);
+        f.write(e.key.data(), klen);
+        f.write((const char*)e.blob->data(), (std::streamsize)e.blob->size());
+        if (!f) { f.close(); std::filesystem::remove(tmp, ec); continue; }
+      }
+      std::filesystem::rename(tmp, path, ec);
+      if (ec) { std::filesystem::remove(tmp, ec); continue; }
+
+      std::lock_guard<std::mutex> lk(mu_);
+      if (dir != opts_.spillDir) continue;
+      ++spills_;
+      auto it = diskMap_.find(name);
+      if (it != diskMap_.end()){ diskBytes_ -= it->second->size; disk_.erase(it->second); }
+      size_t sz = 4 + e.key.size() + e.blob->size();
+      disk_.push_front(DiskEntry{name, sz});
+      diskMap_[name] = disk_.begin();
+      diskBytes_ += sz;
+      while (opts_.spillMaxBytes && diskBytes_ > opts_.spillMaxBytes && disk_.size() > 1){
+        DiskEntry& old = disk_.back();
+        std::filesystem::remove(std::filesystem::path(dir) / old.name, ec);
+        diskBytes_ -= old.size;
+        diskMap_.erase(old.name);
+        disk_.pop_back();
+      }
+    }
+  }
+
+  // Indexes files left by earlier runs so spillMaxBytes covers them too.
+  void scanSpillLocked(){
+    disk_.clear(); diskMap_.clear(); diskBytes_ = 0;
+    if (opts_.spillDir.empty()) return;
+    std::error_code ec;
+    for (auto& de : std::filesystem::directory_iterator(opts_.spillDir, ec)){
+      if (!de.is_regular_file(ec) || de.path().extension() != ".bin") continue;
+      size_t sz = (size_t)de.file_size(ec);
+      if (ec) continue;
+      std::string name = de.path().filename().string();
+      disk_.push_back(DiskEntry{name, sz});
+      diskMap_[name] = std::prev(disk_.end());
+      diskBytes_ += sz;
+    }
+  }
+
+  std::mutex mu_;
+  Options opts_;
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+  size_t bytes_ = 0;
+  std::list<DiskEntry> disk_;
+  std::unordered_map<std::string, std::list<DiskEntry>::iterator> diskMap_;
+  size_t diskBytes_ = 0;
+  uint64_t hits_ = 0, misses_ = 0, evictions_ = 0, spills_ = 0, diskHits_ = 0;
+};
+
+static inline ResultCache::Options ParseCacheOptions(const Napi::Object& o, ResultCache::Options cur){
+  if (o.Has("maxBytes"))      cur.maxBytes = (size_t)std::max<int64_t>(0, o.Get("maxBytes").ToNumber().Int64Value());
+  if (o.Has("spillMaxBytes")) cur.spillMaxBytes = (size_t)std::max<int64_t>(0, o.Get("spillMaxBytes").ToNumber().Int64Value());
+  if (o.Has("spillDir")){
+    Napi::Value v = o.Get("spillDir");
+    cur.spillDir = (v.IsNull() || v.IsUndefined()) ? "" : v.ToString().Utf8Value();
+  }
+  return cur;
+}
+
+static inline Napi::Object CacheOptionsToJs(Napi::Env env, const ResultCache::Options& o){
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("maxBytes", Napi::Number::New(env, (double)o.maxBytes));
+  r.Set("spillDir", o.spillDir.empty() ? env.Null() : (Napi::Value)Napi::String::New(env, o.spillDir));
+  r.Set("spillMaxBytes", Napi::Number::New(env, (double)o.spillMaxBytes));
+  return r;
+}
+
+static inline Napi::Object CacheStatsToJs(Napi::Env env, const ResultCache::Stats& s){
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("hits",        Napi::Number::New(env, (double)s.hits));
+  r.Set("misses",      Napi::Number::New(env, (double)s.misses));
+  r.Set("evictions",   Napi::Number::New(env, (double)s.evictions));
+  r.Set("spills",      Napi::Number::New(env, (double)s.spills));
+  r.Set("diskHits",    Napi::Number::New(env, (double)s.diskHits));
+  r.Set("entries",     Napi::Number::New(env, (double)s.entries));
+  r.Set("bytes",       Napi::Number::New(env, (double)s.bytes));
+  r.Set("diskEntries", Napi::Number::New(env, (double)s.diskEntries));
+  r.Set("diskBytes",   Napi::Number::New(env, (double)s.diskBytes));
+  return r;
+}
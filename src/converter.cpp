@@ -1,9 +1,20 @@
 #include <napi.h>
+#include "pool.h"
+#include "buffer.h"
+#include "cache.h"
+#include "stream.h"
+#include "metrics.h"
 #include <string>
 #include <vector>
 #include <stdexcept>
 #include <cstring>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -26,12 +37,17 @@ struct AVCodecCtxG{ AVCodecContext* p=nullptr; ~AVCodecCtxG(){ if(p) avcodec_fre
 struct AVFrameG   { AVFrame* p=nullptr; ~AVFrameG(){ if(p) av_frame_free(&p);} };
 struct SwrGuard   { SwrContext* p=nullptr; ~SwrGuard(){ if(p) swr_free(&p);} };
 struct FifoGuard  { AVAudioFifo* p=nullptr; ~FifoGuard(){ if(p) av_audio_fifo_free(p);} };
+struct AVPacketG  { AVPacket* p=nullptr; ~AVPacketG(){ if(p) av_packet_free(&p);} };
 
 struct AVOutFmtGuard {
   AVFormatContext* oc=nullptr;
+  bool customIO=false;
   ~AVOutFmtGuard(){
     if (oc) {
-      if (oc->pb) {
+      if (oc->pb && customIO) {
+        av_free(oc->pb->buffer);
+        avio_context_free(&oc->pb);
+      } else if (oc->pb) {
         uint8_t* tmp=nullptr;
         int sz=avio_close_dyn_buf(oc->pb, &tmp);
         (void)sz;
@@ -44,6 +60,22 @@ struct AVOutFmtGuard {
   }
 };
 
+// write_packet lost its non-const buffer in libavformat 61.
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+typedef const uint8_t* AvioWriteBuf;
+#else
+typedef uint8_t* AvioWriteBuf;
+#endif
+
+// Where convertCore's muxed bytes go: collected in memory and returned, or,
+// with `write` set, handed over as the muxer produces them. The custom
+// output cannot seek, so muxers that patch their header at the end write
+// their streaming variant instead.
+struct ConvertSink {
+  int (*write)(void* opaque, AvioWriteBuf buf, int size) = nullptr;
+  void* opaque = nullptr;
+};
+
 struct BufferCtx { const uint8_t* data; size_t size; size_t pos; };
 
 static int readPacket(void* opaque, uint8_t* buf, int buf_size){
@@ -70,11 +102,31 @@ static int64_t seekPacket(void* opaque, int64_t offset, int whence){
   return (int64_t)c->pos;
 }
 
+// AVIO over a ByteStream: forward-only. MP4 with the index at the end
+// would need to seek, so convertCore holds such input until the end and
+// converts it from memory (see IsoIndexAfterMedia).
+static int readStream(void* opaque, uint8_t* buf, int buf_size){
+  int64_t r = ((ByteStreamRef*)opaque)->Read(buf, (size_t)buf_size);
+  if (r == 0) return AVERROR_EOF;
+  return r < 0 ? AVERROR(EIO) : (int)r;
+}
+static int64_t seekStream(void* opaque, int64_t offset, int whence){
+  if (whence == AVSEEK_SIZE) return ((ByteStreamRef*)opaque)->Size();
+  return -1;
+}
+
 struct OpenInputResult {
   AVFmtGuard fmt;
   AVIOGuard io;
   BufferCtx* ctx = nullptr;
 };
+
+// Where convertCore reads from: a buffer, or a stream that is still arriving.
+struct ConvertInput {
+  const uint8_t* data = nullptr;
+  size_t len = 0;
+  ByteStreamRef* stream = nullptr;
+};
 static void freeBufferCtx(OpenInputResult& R){ if(R.ctx){ delete R.ctx; R.ctx=nullptr; } }
 
 static OpenInputResult OpenFromBuffer(const uint8_t* data, size_t len){
@@ -89,12 +141,30 @@ static OpenInputResult OpenFromBuffer(const uint8_t* data, size_t len){
   R.fmt.p->pb = R.io.p;
   R.fmt.p->flags |= AVFMT_FLAG_CUSTOM_IO;
 
-  av_log_set_level(AV_LOG_QUIET);
   ensure(avformat_open_input(&R.fmt.p, "", nullptr, nullptr) == 0, "avformat_open_input failed");
   ensure(avformat_find_stream_info(R.fmt.p, nullptr) >= 0, "avformat_find_stream_info failed");
   return R;
 }
 
+static OpenInputResult OpenFromStream(ByteStreamRef& in){
+  OpenInputResult R;
+  unsigned char* iobuf = (unsigned char*)ensure_ptr(av_malloc(1<<16), "av_malloc failed");
+  R.io.p = (AVIOContext*)ensure_cptr(
+    avio_alloc_context(iobuf, 1<<16, 0, &in, &readStream, nullptr, &seekStream),
+    "avio_alloc_context failed"
+  );
+  R.io.p->seekable = 0;
+  R.fmt.p = (AVFormatContext*)ensure_cptr(avformat_alloc_context(), "avformat_alloc_context failed");
+  R.fmt.p->pb = R.io.p;
+  R.fmt.p->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+  bool opened = avformat_open_input(&R.fmt.p, "", nullptr, nullptr) == 0;
+  if (!opened && in.Failed()) throw std::runtime_error(in.Error());
+  ensure(opened, "avformat_open_input failed (input must be readable without seeking)");
+  ensure(avformat_find_stream_info(R.fmt.p, nullptr) >= 0, "avformat_find_stream_info failed");
+  return R;
+}
+
 static int64_t parseBitrate(const Napi::Value& v, int64_t def_bps){
   if (v.IsNumber()) {
     int64_t b = (int64_t)v.As<Napi::Number>().DoubleValue();
@@ -134,28 +204,131 @@ static int default_frame_size(AVCodecID id, int /*sr*/){
   return 1024;
 }
 
-static std::vector<uint8_t> convertCore(
-  const uint8_t* input, size_t inLen,
+// A prepared encoder, plus the resampler last built for it, for one output
+// profile. Each thread keeps a few, so a worker that keeps seeing the same
+// profile finds, configures and opens its encoder once and only flushes it
+// between jobs. Encoders that cannot be flushed are reopened per job.
+struct EncoderSession {
+  std::string key;
+  AVCodecCtxG ctx;       // open and flushed, or null until (re)opened
+  SwrGuard swr;
+  std::string swrKey;    // input format swr was built for
+};
+
+static std::atomic<uint64_t> g_sessionHits{0}, g_sessionMisses{0};
+static std::atomic<uint64_t> g_remuxed{0};
+
+class SessionCache {
+public:
+  static constexpr size_t kMax = 4;
+
+  // Takes the session out of the cache (a fresh one on a miss). It is only
+  // put back after a job finished cleanly, so a failed job's half-used
+  // encoder is simply dropped. Only a session whose encoder survived Put()
+  // counts as a hit; one that kept just its resampler still has to open
+  // the encoder again.
+  std::unique_ptr<EncoderSession> Take(const std::string& key) {
+    for (auto it = s_.begin(); it != s_.end(); ++it) {
+      if ((*it)->key != key) continue;
+      auto s = std::move(*it);
+      s_.erase(it);
+      (s->ctx.p ? g_sessionHits : g_sessionMisses).fetch_add(1, std::memory_order_relaxed);
+      return s;
+    }
+    g_sessionMisses.fetch_add(1, std::memory_order_relaxed);
+    auto s = std::make_unique<EncoderSession>();
+    s->key = key;
+    return s;
+  }
+
+  void Put(std::unique_ptr<EncoderSession> s) {
+    if (s->ctx.p) {
+      if (s->ctx.p->codec && (s->ctx.p->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH))
+        avcodec_flush_buffers(s->ctx.p);
+      else
+        avcodec_free_context(&s->ctx.p);
+    }
+    s_.insert(s_.begin(), std::move(s));
+    if (s_.size() > kMax) s_.pop_back();
+  }
+
+private:
+  std::vector<std::unique_ptr<EncoderSession>> s_;   // most recent first
+};
+
+static SessionCache& Sessions(){
+  thread_local SessionCache cache;
+  return cache;
+}
+
+static void OpenEncoder(AVCodecCtxG& ctx, AVCodecID id, int sr, int channels, int64_t bitrate_bps, bool ptt, bool vbr){
+  const AVCodec* enc = avcodec_find_encoder(id);
+  ensure_cptr(enc, "Encoder not found");
+  ctx.p = avcodec_alloc_context3(enc);
+  ensure_cptr(ctx.p, "alloc enc ctx failed");
+
+  AVChannelLayout out_ch{};
+  set_layout_default(&out_ch, channels);
+
+  ctx.p->codec_id    = id;
+  ctx.p->codec_type  = AVMEDIA_TYPE_AUDIO;
+  ctx.p->sample_rate = sr;
+  ctx.p->sample_fmt  = pick_sample_fmt(enc);
+  ensure(av_channel_layout_copy(&ctx.p->ch_layout, &out_ch) == 0, "copy out ch_layout failed");
+  ctx.p->time_base   = AVRational{1, sr};
+  ctx.p->bit_rate    = bitrate_bps;
+
+  if (id == AV_CODEC_ID_OPUS && ctx.p->priv_data) {
+    av_opt_set(ctx.p->priv_data, "application", (ptt ? "voip" : "audio"), 0);
+    av_opt_set(ctx.p->priv_data, "vbr", (vbr ? "on" : "off"), 0);
+  }
+
+  if (avcodec_open2(ctx.p, enc, nullptr) != 0) {
+    avcodec_free_context(&ctx.p);
+    throw std::runtime_error("open encoder failed");
+  }
+}
+
+// Where a conversion's time goes, for stats() and `trace`. Opening the
+// input and probing it counts as decode.
+enum : size_t { kStageDecode, kStageResample, kStageEncode, kStageRemux };
+enum : size_t { kBytesIn, kBytesOut, kFailedJobs };
+
+static Metrics& ConverterMetrics(){
+  static Metrics* m = new Metrics({ "decode", "resample", "encode", "remux" },
+                                  { "bytesIn", "bytesOut", "failed" });
+  return *m;
+}
+
+static OwnedBuffer convertCore(
+  const ConvertInput& input,
+  const ConvertSink& sink,
   const std::string& out_format,
   int64_t bitrate_bps,
   int sample_rate,
   int channels,
   bool ptt,
-  bool vbr
+  bool vbr,
+  bool remux,
+  StageClock& clock
 ){
-  auto Rin = OpenFromBuffer(input, inLen);
+  // MP4/M4A with the index at the end cannot be demuxed front to back;
+  // it is read in full and opened as a buffer instead.
+  std::vector<uint8_t> whole;
+  auto open = [&]{
+    auto t = clock.Time(kStageDecode);
+    if (input.stream && IsoIndexAfterMedia(*input.stream)) {
+      whole = input.stream->ReadAll();
+      return OpenFromBuffer(whole.data(), whole.size());
+    }
+    return input.stream ? OpenFromStream(*input.stream) : OpenFromBuffer(input.data, input.len);
+  };
+  auto Rin = open();
   int aidx = av_find_best_stream(Rin.fmt.p, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
   ensure(aidx >= 0, "No audio stream found");
 
   AVStream* in_st = Rin.fmt.p->streams[aidx];
-  const AVCodec* dec = avcodec_find_decoder(in_st->codecpar->codec_id);
-  ensure_cptr(dec, "Decoder not found");
-
-  AVCodecCtxG dec_ctx;
-  dec_ctx.p = avcodec_alloc_context3(dec);
-  ensure_cptr(dec_ctx.p, "alloc dec ctx failed");
-  ensure(avcodec_parameters_to_context(dec_ctx.p, in_st->codecpar) == 0, "params->dec_ctx failed");
-  ensure(avcodec_open2(dec_ctx.p, dec, nullptr) == 0, "open decoder failed");
+  const AVCodecParameters* in_par = in_st->codecpar;
 
   std::string fmt = out_format;
   std::transform(fmt.begin(), fmt.end(), fmt.begin(), ::tolower);
@@ -170,33 +343,83 @@ static std::vector<uint8_t> convertCore(
 
   AVOutFmtGuard out_guard;
   ensure(avformat_alloc_output_context2(&out_guard.oc, nullptr, mux_name.c_str(), nullptr) == 0 && out_guard.oc, "alloc outctx failed");
-  ensure(avio_open_dyn_buf(&out_guard.oc->pb) == 0, "avio_open_dyn_buf failed");
-
-  const AVCodec* enc = avcodec_find_encoder(out_codec_id);
-  ensure_cptr(enc, "Encoder not found");
+  if (sink.write) {
+    unsigned char* obuf = (unsigned char*)ensure_ptr(av_malloc(1<<16), "av_malloc failed");
+    out_guard.oc->pb = avio_alloc_context(obuf, 1<<16, 1, sink.opaque, nullptr, sink.write, nullptr);
+    if (!out_guard.oc->pb) { av_free(obuf); throw std::runtime_error("avio_alloc_context failed"); }
+    out_guard.customIO = true;
+  } else {
+    ensure(avio_open_dyn_buf(&out_guard.oc->pb) == 0, "avio_open_dyn_buf failed");
+  }
 
-  AVStream* out_st = avformat_new_stream(out_guard.oc, enc);
-  ensure_cptr(out_st, "new out stream failed");
+  int sr = sample_rate > 0 ? sample_rate : (in_par->sample_rate > 0 ? in_par->sample_rate : 48000);
+  if (out_codec_id == AV_CODEC_ID_OPUS || ptt) sr = 48000;
+  int want_ch = (channels == 1 || ptt) ? 1 : 2;
 
-  AVCodecCtxG enc_ctx;
-  enc_ctx.p = avcodec_alloc_context3(enc);
-  ensure_cptr(enc_ctx.p, "alloc enc ctx failed");
+  auto write_header = [&](){
+    AVDictionary* mux_opts = nullptr;
+    if (sink.write && mux_name == "ipod")
+      av_dict_set(&mux_opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    int wh = avformat_write_header(out_guard.oc, &mux_opts);
+    av_dict_free(&mux_opts);
+    ensure(wh >= 0, "write header failed");
+  };
 
-  int sr = sample_rate > 0 ? sample_rate : (dec_ctx.p->sample_rate > 0 ? dec_ctx.p->sample_rate : 48000);
-  if (out_codec_id == AV_CODEC_ID_OPUS || ptt) sr = 48000;
+  auto finish = [&]() -> OwnedBuffer {
+    ensure(av_write_trailer(out_guard.oc) == 0, "av_write_trailer failed");
+    freeBufferCtx(Rin);
+    if (sink.write) {
+      avio_flush(out_guard.oc->pb);
+      ensure(out_guard.oc->pb->error == 0, "writing output failed");
+      return OwnedBuffer();
+    }
+    uint8_t* out_buf = nullptr;
+    int out_size = avio_close_dyn_buf(out_guard.oc->pb, &out_buf);
+    out_guard.oc->pb = nullptr;
+    ensure(out_size >= 0 && out_buf, "close_dyn_buf failed");
+    return OwnedBuffer(out_buf, (size_t)out_size, av_free);
+  };
 
-  int want_ch = (channels == 1 || ptt) ? 1 : 2;
-  AVSampleFormat out_sfmt = pick_sample_fmt(enc);
+  // Already in the target codec, rate and layout: copy the packets into the
+  // new container and skip decoding and encoding altogether. The source's
+  // bitrate is kept.
+  bool passthrough = remux &&
+    (out_codec_id == AV_CODEC_ID_OPUS || out_codec_id == AV_CODEC_ID_AAC || out_codec_id == AV_CODEC_ID_MP3) &&
+    in_par->codec_id == out_codec_id && in_par->sample_rate == sr && in_par->ch_layout.nb_channels == want_ch;
+  if (passthrough) {
+    AVStream* out_st = avformat_new_stream(out_guard.oc, nullptr);
+    ensure_cptr(out_st, "new out stream failed");
+    ensure(avcodec_parameters_copy(out_st->codecpar, in_par) >= 0, "copy stream params failed");
+    out_st->codecpar->codec_tag = 0;
+    out_st->time_base = in_st->time_base;
+    auto t = clock.Time(kStageRemux);
+    write_header();
+
+    AVPacketG pkt; pkt.p = av_packet_alloc(); ensure_cptr(pkt.p, "pkt alloc failed");
+    while (av_read_frame(Rin.fmt.p, pkt.p) >= 0) {
+      if (pkt.p->stream_index != aidx) { av_packet_unref(pkt.p); continue; }
+      av_packet_rescale_ts(pkt.p, in_st->time_base, out_st->time_base);
+      pkt.p->stream_index = out_st->index;
+      pkt.p->pos = -1;
+      ensure(av_interleaved_write_frame(out_guard.oc, pkt.p) == 0, "write_frame failed");  // unrefs pkt
+    }
+    if (input.stream && input.stream->Failed()) throw std::runtime_error(input.stream->Error());
+    OwnedBuffer out = finish();
+    g_remuxed.fetch_add(1, std::memory_order_relaxed);
+    return out;
+  }
 
-  AVChannelLayout out_ch{};
-  set_layout_default(&out_ch, want_ch);
+  const AVCodec* dec = avcodec_find_decoder(in_par->codec_id);
+  ensure_cptr(dec, "Decoder not found");
 
-  enc_ctx.p->codec_id    = out_codec_id;
-  enc_ctx.p->codec_type  = AVMEDIA_TYPE_AUDIO;
-  enc_ctx.p->sample_rate = sr;
-  enc_ctx.p->sample_fmt  = out_sfmt;
-  ensure(av_channel_layout_copy(&enc_ctx.p->ch_layout, &out_ch) == 0, "copy out ch_layout failed");
-  enc_ctx.p->time_base   = AVRational{1, sr};
+  AVCodecCtxG dec_ctx;
+  dec_ctx.p = avcodec_alloc_context3(dec);
+  ensure_cptr(dec_ctx.p, "alloc dec ctx failed");
+  ensure(avcodec_parameters_to_context(dec_ctx.p, in_par) == 0, "params->dec_ctx failed");
+  {
+    auto t = clock.Time(kStageDecode);
+    ensure(avcodec_open2(dec_ctx.p, dec, nullptr) == 0, "open decoder failed");
+  }
 
   if (bitrate_bps <= 0) {
     if (out_codec_id == AV_CODEC_ID_MP3) bitrate_bps = 128000;
@@ -204,255 +427,697 @@ static std::vector<uint8_t> convertCore(
     else if (out_codec_id == AV_CODEC_ID_AAC) bitrate_bps = 128000;
     else bitrate_bps = 128000;
   }
-  enc_ctx.p->bit_rate = bitrate_bps;
 
-  if (out_codec_id == AV_CODEC_ID_OPUS && enc_ctx.p->priv_data) {
-    av_opt_set(enc_ctx.p->priv_data, "application", (ptt ? "voip" : "audio"), 0);
-    av_opt_set(enc_ctx.p->priv_data, "vbr", (vbr ? "on" : "off"), 0);
+  char profile[96];
+  std::snprintf(profile, sizeof(profile), "%d r%d c%d b%lld p%d v%d", (int)out_codec_id, sr, want_ch,
+                (long long)bitrate_bps, (int)ptt, (int)vbr);
+  std::unique_ptr<EncoderSession> session = Sessions().Take(profile);
+  if (!session->ctx.p) {
+    auto t = clock.Time(kStageEncode);
+    OpenEncoder(session->ctx, out_codec_id, sr, want_ch, bitrate_bps, ptt, vbr);
   }
+  AVCodecCtxG& enc_ctx = session->ctx;
 
-  ensure(avcodec_open2(enc_ctx.p, enc, nullptr) == 0, "open encoder failed");
+  AVStream* out_st = avformat_new_stream(out_guard.oc, enc_ctx.p->codec);
+  ensure_cptr(out_st, "new out stream failed");
 
   out_st->time_base = enc_ctx.p->time_base;
   ensure(avcodec_parameters_from_context(out_st->codecpar, enc_ctx.p) == 0, "enc params -> stream failed");
-  ensure(avformat_write_header(out_guard.oc, nullptr) == 0, "write header failed");
+  write_header();
 
   AVChannelLayout in_ch{};
-  if (in_st->codecpar->ch_layout.nb_channels > 0) {
-    ensure(av_channel_layout_copy(&in_ch, &in_st->codecpar->ch_layout) == 0, "copy in ch_layout failed");
+  if (in_par->ch_layout.nb_channels > 0) {
+    ensure(av_channel_layout_copy(&in_ch, &in_par->ch_layout) == 0, "copy in ch_layout failed");
   } else {
     set_layout_default(&in_ch, dec_ctx.p->channels > 0 ? dec_ctx.p->channels : 2);
   }
 
-  SwrGuard swr;
-  ensure(
-    swr_alloc_set_opts2(
-      &swr.p,
-      &enc_ctx.p->ch_layout, enc_ctx.p->sample_fmt, enc_ctx.p->sample_rate,
-      &in_ch,               dec_ctx.p->sample_fmt, dec_ctx.p->sample_rate,
-      0, nullptr
-    ) == 0, "swr_alloc_set_opts2 failed"
-  );
+  // the session's resampler is rebuilt only when the input format changes;
+  // otherwise swr_init just resets it
+  char layout[64] = "";
+  av_channel_layout_describe(&in_ch, layout, sizeof(layout));
+  char swrKey[128];
+  std::snprintf(swrKey, sizeof(swrKey), "%s %d %d", layout, (int)dec_ctx.p->sample_fmt, dec_ctx.p->sample_rate);
+  SwrGuard& swr = session->swr;
+  if (!swr.p || session->swrKey != swrKey) {
+    if (swr.p) swr_free(&swr.p);
+    session->swrKey.clear();
+    ensure(
+      swr_alloc_set_opts2(
+        &swr.p,
+        &enc_ctx.p->ch_layout, enc_ctx.p->sample_fmt, enc_ctx.p->sample_rate,
+        &in_ch,               dec_ctx.p->sample_fmt, dec_ctx.p->sample_rate,
+        0, nullptr
+      ) == 0, "swr_alloc_set_opts2 failed"
+    );
+  }
+  av_channel_layout_uninit(&in_ch);
   ensure(swr_init(swr.p) == 0, "swr_init failed");
+  session->swrKey = swrKey;
 
-  FifoGuard fifo;
-  fifo.p = av_audio_fifo_alloc(enc_ctx.p->sample_fmt, enc_ctx.p->ch_layout.nb_channels, 1024);
-  ensure_cptr(fifo.p, "av_audio_fifo_alloc failed");
+  // Everything the loop needs is allocated here, once: frames and packets
+  // are reused, and buffers only grow if an unusually long frame turns up.
+  // out_fr feeds the encoder; rs_fr takes resampler output that does not
+  // fill an encoder frame by itself.
+  const int dec_sr = dec_ctx.p->sample_rate;
+  const int enc_frame_size =
+    (enc_ctx.p->frame_size > 0) ? enc_ctx.p->frame_size : default_frame_size(out_codec_id, enc_ctx.p->sample_rate);
+  const int in_frame_hint = dec_ctx.p->frame_size > 0 ? dec_ctx.p->frame_size : 4096;
+  int rs_cap = (int)av_rescale_rnd(in_frame_hint + 256, enc_ctx.p->sample_rate, dec_sr, AV_ROUND_UP);
 
-  AVPacket* ipkt = av_packet_alloc(); ensure_cptr(ipkt, "ipkt alloc failed");
+  AVPacketG ipkt; ipkt.p = av_packet_alloc(); ensure_cptr(ipkt.p, "ipkt alloc failed");
+  AVPacketG opkt; opkt.p = av_packet_alloc(); ensure_cptr(opkt.p, "opkt alloc failed");
   AVFrameG  in_fr;  in_fr.p  = av_frame_alloc(); ensure_cptr(in_fr.p, "in frame alloc failed");
   AVFrameG  out_fr; out_fr.p = av_frame_alloc(); ensure_cptr(out_fr.p, "out frame alloc failed");
+  AVFrameG  rs_fr;  rs_fr.p  = av_frame_alloc(); ensure_cptr(rs_fr.p, "resample frame alloc failed");
+
+  auto alloc_frame = [&](AVFrame* f, int nb){
+    av_frame_unref(f);
+    f->format      = enc_ctx.p->sample_fmt;
+    f->sample_rate = enc_ctx.p->sample_rate;
+    ensure(av_channel_layout_copy(&f->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy frame ch_layout failed");
+    f->nb_samples  = nb;
+    ensure(av_frame_get_buffer(f, 0) == 0, "frame get_buffer failed");
+  };
+  alloc_frame(out_fr.p, enc_frame_size);
+  alloc_frame(rs_fr.p, rs_cap);
 
-  const int enc_frame_size =
-    (enc_ctx.p->frame_size > 0) ? enc_ctx.p->frame_size : default_frame_size(out_codec_id, enc_ctx.p->sample_rate);
+  // holds at most one encoder frame short of full plus one resampled frame
+  FifoGuard fifo;
+  fifo.p = av_audio_fifo_alloc(enc_ctx.p->sample_fmt, enc_ctx.p->ch_layout.nb_channels, enc_frame_size + rs_cap);
+  ensure_cptr(fifo.p, "av_audio_fifo_alloc failed");
 
   int64_t samples_written = 0;
 
-  auto encode_and_write = [&](AVFrame* frame)->void {
+  auto encode_and_write = [&](AVFrame* frame){
+    auto t = clock.Time(kStageEncode);
     ensure(avcodec_send_frame(enc_ctx.p, frame) == 0, "send_frame failed");
-    AVPacket* opkt = av_packet_alloc();
-    ensure_cptr(opkt, "opkt alloc failed");
     while (true) {
-      int er = avcodec_receive_packet(enc_ctx.p, opkt);
+      int er = avcodec_receive_packet(enc_ctx.p, opkt.p);
       if (er == AVERROR(EAGAIN) || er == AVERROR_EOF) break;
       ensure(er == 0, "receive_packet failed");
-      av_packet_rescale_ts(opkt, enc_ctx.p->time_base, out_st->time_base);
-      opkt->stream_index = out_st->index;
-      ensure(av_interleaved_write_frame(out_guard.oc, opkt) == 0, "write_frame failed");
-      av_packet_unref(opkt);
+      av_packet_rescale_ts(opkt.p, enc_ctx.p->time_base, out_st->time_base);
+      opkt.p->stream_index = out_st->index;
+      ensure(av_interleaved_write_frame(out_guard.oc, opkt.p) == 0, "write_frame failed");  // unrefs opkt
+    }
+  };
+
+  // The encoder may still reference the last frame it was sent.
+  auto writable_out = [&](){
+    out_fr.p->nb_samples = enc_frame_size;
+    ensure(av_frame_make_writable(out_fr.p) == 0, "out frame make_writable failed");
+  };
+
+  auto emit = [&](int nb){
+    out_fr.p->nb_samples = nb;
+    out_fr.p->pts = samples_written;
+    samples_written += nb;
+    encode_and_write(out_fr.p);
+  };
+
+  // Encodes every full frame in the FIFO; `all` also sends the short tail.
+  auto drain_fifo = [&](bool all){
+    while (true) {
+      int have = av_audio_fifo_size(fifo.p);
+      if (have < enc_frame_size && !(all && have > 0)) break;
+      int nb = std::min(have, enc_frame_size);
+      writable_out();
+      ensure(av_audio_fifo_read(fifo.p, (void**)out_fr.p->data, nb) == nb, "fifo_read failed");
+      emit(nb);
     }
-    av_packet_free(&opkt);
   };
 
-  auto drain_fifo_to_encoder = [&](){
-    while (av_audio_fifo_size(fifo.p) >= enc_frame_size) {
-      out_fr.p->nb_samples     = enc_frame_size;
-      ensure(av_channel_layout_copy(&out_fr.p->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy out ch_layout to frame failed");
-      out_fr.p->format         = enc_ctx.p->sample_fmt;
-      out_fr.p->sample_rate    = enc_ctx.p->sample_rate;
-      ensure(av_frame_get_buffer(out_fr.p, 0) == 0, "out frame get_buffer failed");
-
-      ensure(
-        av_audio_fifo_read(
-          fifo.p,
-          (void**)out_fr.p->data,
-          enc_frame_size
-        ) == enc_frame_size, "fifo_read failed");
-
-      out_fr.p->pts = samples_written;
-      samples_written += enc_frame_size;
-
-      encode_and_write(out_fr.p);
-      av_frame_unref(out_fr.p);
+  // Resamples `nb` input samples; a null `in` drains the resampler's delay.
+  // When the FIFO is empty and the output fits one encoder frame, it goes
+  // straight into that frame. Returns the samples produced.
+  // swr_convert is timed call by call, since emit() encodes in between.
+  auto convert = [&](uint8_t** out, int cap, const uint8_t** in, int nb) -> int {
+    auto t = clock.Time(kStageResample);
+    return swr_convert(swr.p, out, cap, in, nb);
+  };
+
+  auto resample = [&](const uint8_t** in, int nb) -> int {
+    int dst_nb = (int)av_rescale_rnd(swr_get_delay(swr.p, dec_sr) + nb, enc_ctx.p->sample_rate, dec_sr, AV_ROUND_UP);
+    if (dst_nb <= 0) return 0;
+    if (av_audio_fifo_size(fifo.p) == 0 && dst_nb <= enc_frame_size) {
+      writable_out();
+      int got = convert(out_fr.p->data, enc_frame_size, in, nb);
+      ensure(got >= 0, "swr_convert failed");
+      if (got == enc_frame_size) { emit(got); return got; }
+      if (got > 0) ensure(av_audio_fifo_write(fifo.p, (void**)out_fr.p->data, got) == got, "fifo write failed");
+      return got;
     }
+    if (dst_nb > rs_cap) { rs_cap = dst_nb; alloc_frame(rs_fr.p, rs_cap); }
+    int got = convert(rs_fr.p->data, rs_cap, in, nb);
+    ensure(got >= 0, "swr_convert failed");
+    if (got > 0) ensure(av_audio_fifo_write(fifo.p, (void**)rs_fr.p->data, got) == got, "fifo write failed");
+    drain_fifo(false);
+    return got;
   };
 
-  while (av_read_frame(Rin.fmt.p, ipkt) >= 0) {
-    if (ipkt->stream_index != aidx) { av_packet_unref(ipkt); continue; }
-    ensure(avcodec_send_packet(dec_ctx.p, ipkt) == 0, "send_packet(dec) failed");
-    av_packet_unref(ipkt);
+  AVFormatContext* in_fmt = Rin.fmt.p;
+  auto next_packet = [&]{ auto t = clock.Time(kStageDecode); return av_read_frame(in_fmt, ipkt.p) >= 0; };
+  auto send_packet = [&](const AVPacket* p){ auto t = clock.Time(kStageDecode); return avcodec_send_packet(dec_ctx.p, p); };
+  auto receive_frame = [&]{ auto t = clock.Time(kStageDecode); return avcodec_receive_frame(dec_ctx.p, in_fr.p); };
 
+  auto pump_decoder = [&](){
     while (true) {
-      int r = avcodec_receive_frame(dec_ctx.p, in_fr.p);
-      if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) break;
+      int r = receive_frame();
+      if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) return;
       ensure(r == 0, "receive_frame(dec) failed");
+      resample((const uint8_t**)in_fr.p->extended_data, in_fr.p->nb_samples);
+      av_frame_unref(in_fr.p);
+    }
+  };
 
-      const int dst_nb = av_rescale_rnd(
-        swr_get_delay(swr.p, dec_ctx.p->sample_rate) + in_fr.p->nb_samples,
-        enc_ctx.p->sample_rate, dec_ctx.p->sample_rate, AV_ROUND_UP
-      );
-
-      AVFrame* tmp = av_frame_alloc();
-      ensure_cptr(tmp, "tmp frame alloc failed");
-      ensure(av_channel_layout_copy(&tmp->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy tmp ch_layout failed");
-      tmp->format         = enc_ctx.p->sample_fmt;
-      tmp->sample_rate    = enc_ctx.p->sample_rate;
-      tmp->nb_samples     = dst_nb > 0 ? dst_nb : enc_frame_size;
-      ensure(av_frame_get_buffer(tmp, 0) == 0, "tmp get_buffer failed");
-
-      int out_samples = swr_convert(
-        swr.p,
-        tmp->data, tmp->nb_samples,
-        (const uint8_t**)in_fr.p->data, in_fr.p->nb_samples
-      );
-      ensure(out_samples >= 0, "swr_convert failed");
-      tmp->nb_samples = out_samples;
-
-      if (out_samples > 0) {
-        ensure(av_audio_fifo_realloc(fifo.p, av_audio_fifo_size(fifo.p) + out_samples) >= 0, "fifo realloc failed");
-        ensure(av_audio_fifo_write(fifo.p, (void**)tmp->data, out_samples) == out_samples, "fifo write failed");
-      }
+  while (next_packet()) {
+    if (ipkt.p->stream_index != aidx) { av_packet_unref(ipkt.p); continue; }
+    ensure(send_packet(ipkt.p) == 0, "send_packet(dec) failed");
+    av_packet_unref(ipkt.p);
+    pump_decoder();
+  }
+  // a stream that broke off must not pass for a short input
+  if (input.stream && input.stream->Failed()) throw std::runtime_error(input.stream->Error());
 
-      av_frame_unref(in_fr.p);
-      av_frame_free(&tmp);
-      drain_fifo_to_encoder();
+  ensure(send_packet(nullptr) == 0, "send_packet(dec,NULL) failed");
+  pump_decoder();
+  while (resample(nullptr, 0) > 0) {}
+  drain_fifo(true);
+
+  encode_and_write(nullptr);
+  OwnedBuffer out = [&]{ auto t = clock.Time(kStageEncode); return finish(); }();
+  Sessions().Put(std::move(session));
+  return out;
+}
+
+struct ConvertOptions {
+  std::string format;
+  int64_t bitrate;
+  int sampleRate;
+  int channels;
+  bool ptt;
+  bool vbr;
+  bool remux;
+  bool trace;   // attach per-stage timings to the result
+};
+
+static ConvertOptions ParseConvertOptions(Napi::Env env, const Napi::Object& opt){
+  ConvertOptions o;
+  o.format     = opt.Has("format")     ? opt.Get("format").ToString().Utf8Value()      : "opus";
+  o.sampleRate = opt.Has("sampleRate") ? opt.Get("sampleRate").ToNumber().Int32Value() : 48000;
+  o.channels   = opt.Has("channels")   ? opt.Get("channels").ToNumber().Int32Value()   : 2;
+  o.ptt        = opt.Has("ptt")        ? opt.Get("ptt").ToBoolean().Value()            : false;
+  o.vbr        = opt.Has("vbr")        ? opt.Get("vbr").ToBoolean().Value()            : true;
+  o.remux      = opt.Has("remux")      ? opt.Get("remux").ToBoolean().Value()          : true;
+  o.trace      = opt.Has("trace")      ? opt.Get("trace").ToBoolean().Value()          : false;
+  o.bitrate    = parseBitrate(opt.Has("bitrate") ? opt.Get("bitrate") : env.Null(),
+                              (o.format=="mp3"?128000:64000));
+  return o;
+}
+
+static ResultCache& ConvertCache(){
+  static ResultCache* cache = new ResultCache();
+  return *cache;
+}
+
+// convertCore behind the result cache. Hits are copied out because the
+// cached blob is shared and JS may write to the Buffer it gets back.
+static OwnedBuffer ConvertCached(const uint8_t* data, size_t len, const ConvertOptions& o, StageClock& clock){
+  ResultCache& cache = ConvertCache();
+  std::string key;
+  if (cache.Enabled()){
+    std::string fmt = o.format;
+    std::transform(fmt.begin(), fmt.end(), fmt.begin(), ::tolower);
+    char opts[160];
+    std::snprintf(opts, sizeof(opts), "%s b%lld r%d c%d p%d v%d x%d", fmt.c_str(), (long long)o.bitrate,
+                  o.sampleRate, o.channels, (int)o.ptt, (int)o.vbr, (int)o.remux);
+    key = ResultCache::MakeKey(data, len, opts);
+    if (auto hit = cache.Get(key)){
+      uint8_t* p = (uint8_t*)std::malloc(std::max<size_t>(1, hit->size()));
+      ensure_ptr(p, "malloc failed");
+      std::memcpy(p, hit->data(), hit->size());
+      return OwnedBuffer(p, hit->size(), std::free);
     }
   }
+  auto out = convertCore(ConvertInput{ data, len, nullptr }, ConvertSink{}, o.format, o.bitrate, o.sampleRate, o.channels, o.ptt, o.vbr, o.remux, clock);
+  if (!key.empty()) cache.Put(key, out.data(), out.size());
+  return out;
+}
 
-  ensure(avcodec_send_packet(dec_ctx.p, nullptr) == 0, "send_packet(dec,NULL) failed");
-  while (true) {
-    int r = avcodec_receive_frame(dec_ctx.p, in_fr.p);
-    if (r == AVERROR_EOF || r == AVERROR(EAGAIN)) break;
-    ensure(r == 0, "receive_frame(dec,flush) failed");
+static TaskPool& ConvertPool(){
+  static TaskPool* pool = new TaskPool(TaskPool::Options{ TaskPool::DefaultThreads(), 64, TaskPool::Overflow::Wait });
+  return *pool;
+}
 
-    const int dst_nb = av_rescale_rnd(
-      swr_get_delay(swr.p, dec_ctx.p->sample_rate) + in_fr.p->nb_samples,
-      enc_ctx.p->sample_rate, dec_ctx.p->sample_rate, AV_ROUND_UP
-    );
+class ConvertWorker : public PoolTask {
+public:
+  ConvertWorker(Napi::Env env, Napi::Buffer<uint8_t> input, ConvertOptions opts)
+  : PoolTask(env, "converter:convert"), deferred_(Napi::Promise::Deferred::New(env)),
+    data_(input.Data()), len_(input.Length()), opts_(std::move(opts)) {
+    inputRef_ = Napi::Reference<Napi::Buffer<uint8_t>>::New(input, 1);
+  }
 
-    AVFrame* tmp = av_frame_alloc();
-    ensure_cptr(tmp, "tmp frame alloc2 failed");
-    ensure(av_channel_layout_copy(&tmp->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy tmp2 ch_layout failed");
-    tmp->format         = enc_ctx.p->sample_fmt;
-    tmp->sample_rate    = enc_ctx.p->sample_rate;
-    tmp->nb_samples     = dst_nb > 0 ? dst_nb : enc_frame_size;
-    ensure(av_frame_get_buffer(tmp, 0) == 0, "tmp get_buffer2 failed");
-
-    int out_samples = swr_convert(
-      swr.p,
-      tmp->data, tmp->nb_samples,
-      (const uint8_t**)in_fr.p->data, in_fr.p->nb_samples
-    );
-    ensure(out_samples >= 0, "swr_convert flush failed");
-    tmp->nb_samples = out_samples;
+  // Input still arriving from another addon; never cached, since the key
+  // would need the whole input.
+  ConvertWorker(Napi::Env env, ByteStream* input, ConvertOptions opts)
+  : PoolTask(env, "converter:convert"), deferred_(Napi::Promise::Deferred::New(env)),
+    data_(nullptr), len_(0), opts_(std::move(opts)), stream_(input) {}
+
+  Napi::Promise Promise() const { return deferred_.Promise(); }
 
-    if (out_samples > 0) {
-      ensure(av_audio_fifo_realloc(fifo.p, av_audio_fifo_size(fifo.p) + out_samples) >= 0, "fifo realloc2 failed");
-      ensure(av_audio_fifo_write(fifo.p, (void**)tmp->data, out_samples) == out_samples, "fifo write2 failed");
+  void Execute() override {
+    try {
+      if (stream_) {
+        out_ = convertCore(ConvertInput{ nullptr, 0, &stream_ }, ConvertSink{}, opts_.format, opts_.bitrate,
+                           opts_.sampleRate, opts_.channels, opts_.ptt, opts_.vbr, opts_.remux, clock_);
+        if (stream_.Size() > 0) clock_.Count(kBytesIn, (uint64_t)stream_.Size());
+        stream_ = ByteStreamRef();
+      } else {
+        clock_.Count(kBytesIn, len_);
+        out_ = ConvertCached(data_, len_, opts_, clock_);
+      }
+    } catch (...) {
+      clock_.Count(kFailedJobs, 1);
+      throw;
     }
+    clock_.Count(kBytesOut, out_.size());
+    clock_.Commit();
+  }
 
-    av_frame_unref(in_fr.p);
-    av_frame_free(&tmp);
-    drain_fifo_to_encoder();
+  void OnOK() override {
+    Napi::Env env = Env();
+    inputRef_.Reset();
+    Napi::Buffer<uint8_t> buf = out_.ToBuffer(env);
+    if (opts_.trace) buf.Set("trace", clock_.ToJs(env));
+    deferred_.Resolve(buf);
   }
 
-  while (true) {
-    int delay = swr_get_delay(swr.p, dec_ctx.p->sample_rate);
-    if (delay <= 0) break;
+  void OnError(const Napi::Error& e) override {
+    inputRef_.Reset();
+    deferred_.Reject(e.Value());
+  }
 
-    AVFrame* tmp = av_frame_alloc();
-    ensure_cptr(tmp, "tmp frame alloc3 failed");
-    ensure(av_channel_layout_copy(&tmp->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy tmp3 ch_layout failed");
-    tmp->format         = enc_ctx.p->sample_fmt;
-    tmp->sample_rate    = enc_ctx.p->sample_rate;
-    tmp->nb_samples     = av_rescale_rnd(delay, enc_ctx.p->sample_rate, dec_ctx.p->sample_rate, AV_ROUND_UP);
-    if (tmp->nb_samples <= 0) { av_frame_free(&tmp); break; }
-    ensure(av_frame_get_buffer(tmp, 0) == 0, "tmp get_buffer3 failed");
+private:
+  Napi::Promise::Deferred deferred_;
+  Napi::Reference<Napi::Buffer<uint8_t>> inputRef_;
+  const uint8_t* data_;
+  size_t len_;
+  ConvertOptions opts_;
+  ByteStreamRef stream_;
+  OwnedBuffer out_;
+  StageClock clock_{ ConverterMetrics() };
+};
 
-    int out_samples = swr_convert(swr.p, tmp->data, tmp->nb_samples, nullptr, 0);
-    ensure(out_samples >= 0, "swr_convert drain failed");
-    tmp->nb_samples = out_samples;
+// createConvertStream: one conversion, run as a ConvertStreamTask on
+// ConvertPool. An open stream holds that transcode thread while it waits on
+// JS input, so `threads` open streams starve convert(), and awaiting a
+// convert() before ending a stream can hang.
+// JS pushes chunks into a PipeStream; the muxer writes through a custom
+// AVIO into batches of `highWaterMark` bytes that go to onData as they
+// fill. Input is bounded by the pipe and output by two unacknowledged
+// batches, so memory stays flat however long the recording runs.
+class ConvertStreamJob : public std::enable_shared_from_this<ConvertStreamJob> {
+public:
+  ConvertStreamJob(Napi::Env env, ConvertOptions o, size_t hwm, Napi::Function onData, Napi::Value onDrain)
+  : deferred_(Napi::Promise::Deferred::New(env)), opts_(std::move(o)), hwm_(hwm),
+    pipe_(new PipeStream(hwm * 4)) {
+    // Weak: the handle keeps the callbacks alive (see Start), so a caller
+    // that drops the handle lets it be collected.
+    onData_ = Napi::Weak(onData);
+    if (onDrain.IsFunction()) onDrain_ = Napi::Weak(onDrain.As<Napi::Function>());
+    tsfn_ = Napi::ThreadSafeFunction::New(env,
+      Napi::Function::New(env, [](const Napi::CallbackInfo&){}), "converter:stream", 0, 1);
+  }
+  ~ConvertStreamJob(){ std::free(buf_); }
+
+  // JS thread: the { write, end, destroy, promise } handle.
+  static Napi::Object Start(std::shared_ptr<ConvertStreamJob> job, Napi::Env env) {
+    std::weak_ptr<ConvertStreamJob> weak = job;
+    job->pipe_->onDrain = [weak](){ if (auto j = weak.lock()) j->postDrain(); };
+
+    Napi::Object h = Napi::Object::New(env);
+    h.Set("write", Napi::Function::New(env, [job](const Napi::CallbackInfo& info) -> Napi::Value {
+      Napi::Env env = info.Env();
+      if (info.Length() < 1 || !info[0].IsBuffer()) {
+        Napi::TypeError::New(env, "write(chunk) requires a Buffer").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      if (job->ended_) {
+        Napi::Error::New(env, "write after end").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      auto b = info[0].As<Napi::Buffer<uint8_t>>();
+      job->received_.fetch_add(b.Length(), std::memory_order_relaxed);
+      return Napi::Boolean::New(env, job->pipe_->Offer(b.Data(), b.Length()));
+    }));
+    h.Set("end", Napi::Function::New(env, [job](const Napi::CallbackInfo& info){
+      job->ended_ = true;
+      job->pipe_->Close("");
+      return info.Env().Undefined();
+    }));
+    h.Set("destroy", Napi::Function::New(env, [job](const Napi::CallbackInfo& info){
+      job->destroy();
+      return info.Env().Undefined();
+    }));
+    h.Set("promise", job->deferred_.Promise());
+    h.DefineProperty(Napi::PropertyDescriptor::Value("onData", job->onData_.Value()));
+    if (!job->onDrain_.IsEmpty())
+      h.DefineProperty(Napi::PropertyDescriptor::Value("onDrain", job->onDrain_.Value()));
+
+    // A handle collected without end()/destroy() would leave the
+    // conversion parked on its pipe forever, holding a pool thread.
+    h.AddFinalizer([](Napi::Env, std::weak_ptr<ConvertStreamJob>* w){
+      if (auto j = w->lock()) j->destroy();
+      delete w;
+    }, new std::weak_ptr<ConvertStreamJob>(weak));
+    return h;
+  }
 
-    if (out_samples > 0) {
-      ensure(av_audio_fifo_realloc(fifo.p, av_audio_fifo_size(fifo.p) + out_samples) >= 0, "fifo realloc drain failed");
-      ensure(av_audio_fifo_write(fifo.p, (void**)tmp->data, out_samples) == out_samples, "fifo write drain failed");
+  // JS thread: stop the conversion; its promise rejects.
+  void destroy() {
+    ended_ = true;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      destroyed_ = true;
     }
-    av_frame_free(&tmp);
-    drain_fifo_to_encoder();
-    if (out_samples == 0) break;
-  }
-
-  int left = av_audio_fifo_size(fifo.p);
-  if (left > 0) {
-    out_fr.p->nb_samples = left;
-    ensure(av_channel_layout_copy(&out_fr.p->ch_layout, &enc_ctx.p->ch_layout) == 0, "copy tail ch_layout failed");
-    out_fr.p->format      = enc_ctx.p->sample_fmt;
-    out_fr.p->sample_rate = enc_ctx.p->sample_rate;
-    ensure(av_frame_get_buffer(out_fr.p, 0) == 0, "out frame get_buffer (tail) failed");
-    ensure(av_audio_fifo_read(fifo.p, (void**)out_fr.p->data, left) == left, "fifo read tail failed");
-    out_fr.p->pts = samples_written;
-    samples_written += left;
-    encode_and_write(out_fr.p);
-    av_frame_unref(out_fr.p);
+    cv_.notify_all();
+    pipe_->cancel(pipe_.get());
   }
 
-  encode_and_write(nullptr);
-  ensure(av_write_trailer(out_guard.oc) == 0, "av_write_trailer failed");
+  // JS thread: the conversion never ran (the pool refused it).
+  void Fail(Napi::Env env, const std::string& msg) {
+    destroy();
+    deferred_.Reject(Napi::Error::New(env, msg).Value());
+    tsfn_.Release();
+  }
 
-  uint8_t* out_buf = nullptr;
-  int out_size = avio_close_dyn_buf(out_guard.oc->pb, &out_buf);
-  out_guard.oc->pb = nullptr;
-  ensure(out_size >= 0 && out_buf, "close_dyn_buf failed");
+private:
+  friend class ConvertStreamTask;
+  struct Batch { std::shared_ptr<ConvertStreamJob> job; OwnedBuffer buf; size_t size; };
+  struct Done  { std::shared_ptr<ConvertStreamJob> job; std::string error; };
 
-  std::vector<uint8_t> out((size_t)out_size);
-  std::memcpy(out.data(), out_buf, (size_t)out_size);
-  av_free(out_buf);
+  // Conversion thread. Its reference to the job travels with the final
+  // call, so the job is always destroyed on the JS thread.
+  static void Run(std::shared_ptr<ConvertStreamJob> job) {
+    std::string error;
+    StageClock clock(ConverterMetrics());
+    try {
+      ByteStreamRef in(job->pipe_.get());
+      const ConvertOptions& o = job->opts_;
+      convertCore(ConvertInput{ nullptr, 0, &in }, ConvertSink{ &ConvertStreamJob::writeTramp, job.get() },
+                  o.format, o.bitrate, o.sampleRate, o.channels, o.ptt, o.vbr, o.remux, clock);
+      if (!job->flush()) error = "converter stream destroyed";
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    {
+      std::lock_guard<std::mutex> lk(job->mu_);
+      if (job->destroyed_) error = "converter stream destroyed";
+    }
+    if (!error.empty()) clock.Count(kFailedJobs, 1);
+    clock.Count(kBytesIn, job->received_.load(std::memory_order_relaxed));
+    clock.Count(kBytesOut, job->written_);
+    clock.Commit();
+    Napi::ThreadSafeFunction tsfn = job->tsfn_;
+    auto* d = new Done{ std::move(job), std::move(error) };
+    napi_status st = tsfn.NonBlockingCall(d, [](Napi::Env env, Napi::Function, Done* d){
+      Napi::HandleScope scope(env);
+      if (d->error.empty()) d->job->deferred_.Resolve(env.Undefined());
+      else d->job->deferred_.Reject(Napi::Error::New(env, d->error).Value());
+      delete d;
+    });
+    tsfn.Release();
+    if (st != napi_ok) delete d;  // environment is going away
+  }
 
-  freeBufferCtx(Rin);
-  av_packet_free(&ipkt);
+  static int writeTramp(void* opaque, AvioWriteBuf buf, int size) {
+    return static_cast<ConvertStreamJob*>(opaque)->write(buf, (size_t)size);
+  }
 
-  return out;
+  // Conversion thread: stage muxed bytes; a full batch goes to JS.
+  int write(AvioWriteBuf p, size_t n) {
+    if (len_ + n > cap_) {
+      size_t cap = std::max(hwm_ + (1 << 16), len_ + n);
+      void* nb = std::realloc(buf_, cap);
+      if (!nb) return AVERROR(ENOMEM);
+      buf_ = (unsigned char*)nb;
+      cap_ = cap;
+    }
+    std::memcpy(buf_ + len_, p, n);
+    len_ += n;
+    written_ += n;
+    if (len_ >= hwm_ && !flush()) return AVERROR_EXIT;
+    return (int)n;
+  }
+
+  // Conversion thread: hand the staged batch to JS, first waiting while
+  // two batches are still unconsumed. False once destroyed.
+  bool flush() {
+    if (len_ == 0) return true;
+    size_t n = len_;
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      cv_.wait(lk, [&]{ return destroyed_ || inflight_ < 2 * hwm_; });
+      if (destroyed_) return false;
+      inflight_ += n;
+    }
+    auto* b = new Batch{ shared_from_this(), OwnedBuffer(buf_, n, std::free), n };
+    buf_ = nullptr; len_ = 0; cap_ = 0;
+    napi_status st = tsfn_.NonBlockingCall(b, [](Napi::Env env, Napi::Function, Batch* b){
+      Napi::HandleScope scope(env);
+      std::shared_ptr<ConvertStreamJob> job = b->job;
+      size_t size = b->size;
+      Napi::Function onData = job->onData_.Value();
+      Napi::Value r = onData.IsEmpty() ? env.Undefined() : onData.Call({ b->buf.ToBuffer(env) });
+      delete b;
+      job->ackWhenSettled(env, r, size);
+    });
+    if (st != napi_ok) { delete b; return false; }
+    return true;
+  }
+
+  // JS thread: credit `n` bytes back once onData's result settles.
+  void ackWhenSettled(Napi::Env env, Napi::Value r, size_t n) {
+    auto self = shared_from_this();
+    auto ack = [self, n](){
+      { std::lock_guard<std::mutex> lk(self->mu_); self->inflight_ -= n; }
+      self->cv_.notify_all();
+    };
+    if (r.IsObject()) {
+      Napi::Value then = r.As<Napi::Object>().Get("then");
+      if (then.IsFunction()) {
+        auto settle = Napi::Function::New(env, [ack](const Napi::CallbackInfo& info){
+          ack();
+          return info.Env().Undefined();
+        });
+        then.As<Napi::Function>().Call(r, { settle, settle });
+        return;
+      }
+    }
+    ack();
+  }
+
+  // Conversion thread (inside a pipe read): input has room again.
+  void postDrain() {
+    if (onDrain_.IsEmpty()) return;
+    auto* self = new std::shared_ptr<ConvertStreamJob>(shared_from_this());
+    napi_status st = tsfn_.NonBlockingCall(self, [](Napi::Env env, Napi::Function, std::shared_ptr<ConvertStreamJob>* j){
+      Napi::HandleScope scope(env);
+      Napi::Function onDrain = (*j)->onDrain_.Value();
+      if (!onDrain.IsEmpty()) onDrain.Call({});
+      delete j;
+    });
+    if (st != napi_ok) delete self;
+  }
+
+  Napi::Promise::Deferred deferred_;
+  ConvertOptions opts_;
+  size_t hwm_;
+  std::unique_ptr<PipeStream, PipeStream::Unref> pipe_;
+  Napi::ThreadSafeFunction tsfn_;
+  Napi::FunctionReference onData_, onDrain_;
+  bool ended_ = false;   // JS thread only
+  std::atomic<uint64_t> received_{0};
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  size_t inflight_ = 0;
+  bool destroyed_ = false;
+
+  unsigned char* buf_ = nullptr;   // conversion thread only
+  size_t len_ = 0, cap_ = 0;
+  uint64_t written_ = 0;
+};
+
+// Pool slot for a stream. The job settles its own promise through its own
+// TSFN, behind its last batch, so this task only occupies the slot, and
+// answers only when the pool refuses it.
+class ConvertStreamTask : public PoolTask {
+public:
+  ConvertStreamTask(Napi::Env env, std::shared_ptr<ConvertStreamJob> job)
+  : PoolTask(env, "converter:stream-slot"), job_(std::move(job)) {}
+
+  void Execute() override { ConvertStreamJob::Run(std::move(job_)); }
+  void OnOK() override {}
+  void OnError(const Napi::Error& e) override {
+    if (job_) job_->Fail(Env(), e.Message());
+  }
+
+private:
+  std::shared_ptr<ConvertStreamJob> job_;
+};
+
+Napi::Value CreateConvertStream(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "createConvertStream(options, onData, onDrain?)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object opt = info[0].As<Napi::Object>();
+  int64_t hwm = opt.Has("highWaterMark") ? opt.Get("highWaterMark").ToNumber().Int64Value() : 64 * 1024;
+  auto job = std::make_shared<ConvertStreamJob>(env, ParseConvertOptions(env, opt),
+                                                (size_t)std::max<int64_t>(4096, hwm),
+                                                info[1].As<Napi::Function>(),
+                                                info.Length() >= 3 ? info[2] : env.Undefined());
+  Napi::Object h = ConvertStreamJob::Start(job, env);
+  auto* task = new ConvertStreamTask(env, std::move(job));
+  if (!ConvertPool().Submit(task)) {
+    task->SetError("converter queue is full");
+    task->Complete();
+  }
+  return h;
 }
 
 Napi::Value Convert(const Napi::CallbackInfo& info){
   Napi::Env env = info.Env();
-  if (info.Length() < 1 || !info[0].IsBuffer()) {
-    Napi::TypeError::New(env, "convert(inputBuffer, options?)").ThrowAsJavaScriptException();
+  ByteStream* stream = info.Length() >= 1 ? UnwrapByteStream(info[0]) : nullptr;
+  if (info.Length() < 1 || (!info[0].IsBuffer() && !stream)) {
+    Napi::TypeError::New(env, "convert(inputBuffer | source, options?)").ThrowAsJavaScriptException();
     return env.Null();
   }
-  auto input = info[0].As<Napi::Buffer<uint8_t>>();
   Napi::Object opt = (info.Length() >= 2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
 
-  std::string format = opt.Has("format") ? opt.Get("format").ToString().Utf8Value() : "opus";
-  int sampleRate     = opt.Has("sampleRate") ? opt.Get("sampleRate").ToNumber().Int32Value() : 48000;
-  int channels       = opt.Has("channels")   ? opt.Get("channels").ToNumber().Int32Value()   : 2;
-  bool ptt           = opt.Has("ptt")        ? opt.Get("ptt").ToBoolean().Value()            : false;
-  bool vbr           = opt.Has("vbr")        ? opt.Get("vbr").ToBoolean().Value()            : true;
-  int64_t bitrate    = parseBitrate(opt.Has("bitrate") ? opt.Get("bitrate") : env.Null(),
-                                    (format=="mp3"?128000:64000));
+  auto* worker = stream
+    ? new ConvertWorker(env, stream, ParseConvertOptions(env, opt))
+    : new ConvertWorker(env, info[0].As<Napi::Buffer<uint8_t>>(), ParseConvertOptions(env, opt));
+  Napi::Promise promise = worker->Promise();
+  if (!ConvertPool().Submit(worker)) {
+    worker->SetError("converter queue is full");
+    worker->Complete();
+  }
+  return promise;
+}
 
+// The synchronous paths: ConvertCached on the JS thread, with the call's
+// trace attached when asked for. Throws into JS on failure.
+static Napi::Value ConvertOnJsThread(Napi::Env env, Napi::Buffer<uint8_t> input, const ConvertOptions& o){
+  StageClock clock(ConverterMetrics());
   try {
-    auto out = convertCore(input.Data(), input.Length(), format, bitrate, sampleRate, channels, ptt, vbr);
-    return Napi::Buffer<uint8_t>::Copy(env, out.data(), out.size());
+    clock.Count(kBytesIn, input.Length());
+    OwnedBuffer out = ConvertCached(input.Data(), input.Length(), o, clock);
+    clock.Count(kBytesOut, out.size());
+    clock.Commit();
+    Napi::Buffer<uint8_t> buf = out.ToBuffer(env);
+    if (o.trace) buf.Set("trace", clock.ToJs(env));
+    return buf;
   } catch (const std::exception& e) {
+    clock.Count(kFailedJobs, 1);
     Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
     return env.Null();
   }
 }
 
+Napi::Value ConvertSync(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsBuffer()) {
+    Napi::TypeError::New(env, "convertSync(inputBuffer, options?)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  auto input = info[0].As<Napi::Buffer<uint8_t>>();
+  Napi::Object opt = (info.Length() >= 2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+  return ConvertOnJsThread(env, input, ParseConvertOptions(env, opt));
+}
+
+// createConverter: options parsed once and bound to { convert, convertSync }.
+// Jobs with the same profile land on warm EncoderSessions in the workers.
+Napi::Value CreateConverter(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  Napi::Object opt = (info.Length() >= 1 && info[0].IsObject()) ? info[0].As<Napi::Object>() : Napi::Object::New(env);
+  auto o = std::make_shared<const ConvertOptions>(ParseConvertOptions(env, opt));
+
+  Napi::Object h = Napi::Object::New(env);
+  h.Set("convert", Napi::Function::New(env, [o](const Napi::CallbackInfo& info) -> Napi::Value {
+    Napi::Env env = info.Env();
+    ByteStream* stream = info.Length() >= 1 ? UnwrapByteStream(info[0]) : nullptr;
+    if (info.Length() < 1 || (!info[0].IsBuffer() && !stream)) {
+      Napi::TypeError::New(env, "convert(inputBuffer | source)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    auto* worker = stream ? new ConvertWorker(env, stream, *o)
+                          : new ConvertWorker(env, info[0].As<Napi::Buffer<uint8_t>>(), *o);
+    Napi::Promise promise = worker->Promise();
+    if (!ConvertPool().Submit(worker)) {
+      worker->SetError("converter queue is full");
+      worker->Complete();
+    }
+    return promise;
+  }));
+  h.Set("convertSync", Napi::Function::New(env, [o](const Napi::CallbackInfo& info) -> Napi::Value {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsBuffer()) {
+      Napi::TypeError::New(env, "convertSync(inputBuffer)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    return ConvertOnJsThread(env, info[0].As<Napi::Buffer<uint8_t>>(), *o);
+  }));
+  return h;
+}
+
+Napi::Value Configure(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length() >= 1 && info[0].IsObject()) {
+    try {
+      Napi::Object o = info[0].As<Napi::Object>();
+      ConvertPool().Configure(ParsePoolOptions(o, ConvertPool().GetOptions()));
+      if (o.Has("cache") && o.Get("cache").IsObject())
+        ConvertCache().Configure(ParseCacheOptions(o.Get("cache").As<Napi::Object>(), ConvertCache().GetOptions()));
+    } catch (const std::exception& e) {
+      Napi::TypeError::New(env, e.what()).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+  Napi::Object r = PoolOptionsToJs(env, ConvertPool().GetOptions());
+  r.Set("cache", CacheOptionsToJs(env, ConvertCache().GetOptions()));
+  return r;
+}
+
+Napi::Value Stats(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("pool", PoolStatsToJs(env, ConvertPool().GetStats()));
+  r.Set("cache", CacheStatsToJs(env, ConvertCache().GetStats()));
+  Napi::Object sessions = Napi::Object::New(env);
+  sessions.Set("hits",   Napi::Number::New(env, (double)g_sessionHits.load()));
+  sessions.Set("misses", Napi::Number::New(env, (double)g_sessionMisses.load()));
+  r.Set("sessions", sessions);
+  r.Set("remuxed", Napi::Number::New(env, (double)g_remuxed.load()));
+  Napi::Object mem = Napi::Object::New(env);
+  mem.Set("peakRss", Napi::Number::New(env, PeakRssBytes()));
+  r.Set("memory", mem);
+  r.Set("stages", ConverterMetrics().StagesToJs(env));
+  r.Set("counters", ConverterMetrics().CountersToJs(env));
+  return r;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports){
-  exports.Set("convert", Napi::Function::New(env, Convert));
+  av_log_set_level(AV_LOG_QUIET);
+  exports.Set("convert",     Napi::Function::New(env, Convert));
+  exports.Set("convertSync", Napi::Function::New(env, ConvertSync));
+  exports.Set("createConvertStream", Napi::Function::New(env, CreateConvertStream));
+  exports.Set("createConverter", Napi::Function::New(env, CreateConverter));
+  exports.Set("configure",   Napi::Function::New(env, Configure));
+  exports.Set("stats",       Napi::Function::New(env, Stats));
   return exports;
 }
 
-NODE_API_MODULE(converter, Init)
\ No newline at end of file
+NODE_API_MODULE(converter, Init)
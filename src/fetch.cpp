@@ -5,12 +5,28 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include <algorithm>
-#include <sstream>
 #include <cctype>
 #include <atomic>
 #include <chrono>
 #include <random>
+#include <thread>
+#include <deque>
+#include <unordered_map>
+#include <optional>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "buffer.h"
+#include "cache.h"
+#include "stream.h"
+#include "metrics.h"
 
 namespace {
 
@@ -51,10 +67,49 @@ struct SList {
 static CURLSH* g_share = nullptr;
 static std::once_flag g_onceShare;
 
+// One reader/writer lock per curl_lock_data, so DNS lookups, cookie reads and
+// TLS session resumption from different I/O threads only wait for writers
+// of the same cache. libcurl's unlock callback does not say which mode was
+// taken, so each thread remembers it (a thread holds one lock per type).
+struct ShareLocks {
+  std::shared_mutex mu[CURL_LOCK_DATA_LAST];
+  std::atomic<uint64_t> locks[CURL_LOCK_DATA_LAST] = {};
+  std::atomic<uint64_t> contended[CURL_LOCK_DATA_LAST] = {};
+};
+static ShareLocks g_shareLocks;
+static thread_local bool t_shareExclusive[CURL_LOCK_DATA_LAST];
+
+static void shareLock(CURL*, curl_lock_data data, curl_lock_access access, void*) {
+  if (data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  std::shared_mutex& m = g_shareLocks.mu[data];
+  g_shareLocks.locks[data].fetch_add(1, std::memory_order_relaxed);
+  if (access == CURL_LOCK_ACCESS_SHARED) {
+    if (!m.try_lock_shared()) {
+      g_shareLocks.contended[data].fetch_add(1, std::memory_order_relaxed);
+      m.lock_shared();
+    }
+    t_shareExclusive[data] = false;
+  } else {
+    if (!m.try_lock()) {
+      g_shareLocks.contended[data].fetch_add(1, std::memory_order_relaxed);
+      m.lock();
+    }
+    t_shareExclusive[data] = true;
+  }
+}
+
+static void shareUnlock(CURL*, curl_lock_data data, void*) {
+  if (data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  if (t_shareExclusive[data]) g_shareLocks.mu[data].unlock();
+  else g_shareLocks.mu[data].unlock_shared();
+}
+
 static void initShare() {
   std::call_once(g_onceShare, [](){
     g_share = curl_share_init();
     if (g_share) {
+      curl_share_setopt(g_share, CURLSHOPT_LOCKFUNC, shareLock);
+      curl_share_setopt(g_share, CURLSHOPT_UNLOCKFUNC, shareUnlock);
       curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
       curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
       curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
@@ -80,8 +135,220 @@ static inline std::string trim(const std::string& s) {
   return s.substr(a, b-a);
 }
 
+// "scheme://host:port" in lower case; the unit for connection limits.
+static std::string hostKey(const std::string& url) {
+  size_t s = url.find("://");
+  size_t start = (s == std::string::npos) ? 0 : s + 3;
+  size_t end = url.find_first_of("/?#", start);
+  std::string authority = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+  size_t at = authority.rfind('@');
+  if (at != std::string::npos) authority = authority.substr(at + 1);
+  std::string scheme = (s == std::string::npos) ? "http" : url.substr(0, s);
+  return lower(scheme + "://" + authority);
+}
+
+// Idle easy handles kept per host. Handles are recycled with
+// curl_easy_reset so each transfer skips handle setup; the connections
+// themselves live in the engine's multi handle and are shared by every
+// transfer to the same host (see FetchEngine).
+class ConnPool {
+public:
+  struct Options {
+    long maxPerHost = 8;        // CURLMOPT_MAX_HOST_CONNECTIONS, 0 = unlimited
+    long idleTimeoutMs = 60000; // idle connections older than this are closed
+  };
+  struct Stats {
+    uint64_t requests, reusedConnections, newConnections, handleReuses;
+    size_t idleHandles, active, hosts;
+  };
+
+  CURL* Acquire(const std::string& host) {
+    std::unique_lock<std::mutex> lk(mu_);
+    Host& h = hosts_[host];
+    ++h.active;
+    ++active_;
+    ++requests_;
+    pruneLocked(std::chrono::steady_clock::now());
+    if (!h.idle.empty()) {
+      CURL* e = h.idle.back().easy;
+      h.idle.pop_back();
+      --idle_;
+      ++handleReuses_;
+      return e;
+    }
+    lk.unlock();
+    CURL* e = curl_easy_init();
+    if (!e) {
+      lk.lock();
+      --h.active; --active_;
+      throw std::runtime_error("curl_easy_init failed");
+    }
+    return e;
+  }
+
+  // `reusable` is false when the transfer was cut short and its handle
+  // should not be trusted.
+  void Release(const std::string& host, CURL* e, bool reusable) {
+    long connects = 0;
+    curl_easy_getinfo(e, CURLINFO_NUM_CONNECTS, &connects);
+    if (reusable) curl_easy_reset(e);
+
+    std::lock_guard<std::mutex> lk(mu_);
+    Host& h = hosts_[host];
+    --h.active;
+    --active_;
+    if (connects > 0) newConnections_ += (uint64_t)connects;
+    else ++reusedConnections_;
+
+    size_t cap = opts_.maxPerHost > 0 ? (size_t)opts_.maxPerHost : 16;
+    if (reusable && opts_.idleTimeoutMs > 0 && h.idle.size() < cap) {
+      h.idle.push_back(Idle{ e, std::chrono::steady_clock::now() });
+      ++idle_;
+    } else {
+      curl_easy_cleanup(e);
+    }
+  }
+
+  void Configure(const Options& o) {
+    std::lock_guard<std::mutex> lk(mu_);
+    opts_ = o;
+    pruneLocked(std::chrono::steady_clock::now());
+  }
+
+  Options GetOptions() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return opts_;
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return Stats{ requests_, reusedConnections_, newConnections_, handleReuses_, idle_, active_, hosts_.size() };
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lk(mu_);
+    for (auto& kv : hosts_) for (auto& i : kv.second.idle) curl_easy_cleanup(i.easy);
+    hosts_.clear();
+    idle_ = 0;
+  }
+
+private:
+  struct Idle { CURL* easy; std::chrono::steady_clock::time_point since; };
+  struct Host { std::vector<Idle> idle; size_t active = 0; };
+
+  void pruneLocked(std::chrono::steady_clock::time_point now) {
+    auto maxIdle = std::chrono::milliseconds(std::max(0L, opts_.idleTimeoutMs));
+    for (auto it = hosts_.begin(); it != hosts_.end(); ) {
+      auto& idle = it->second.idle;
+      size_t keep = 0;
+      for (auto& i : idle) {
+        if (now - i.since >= maxIdle) { curl_easy_cleanup(i.easy); --idle_; }
+        else idle[keep++] = i;
+      }
+      idle.resize(keep);
+      if (idle.empty() && it->second.active == 0) it = hosts_.erase(it);
+      else ++it;
+    }
+  }
+
+  std::mutex mu_;
+  Options opts_;
+  std::map<std::string, Host> hosts_;
+  size_t idle_ = 0, active_ = 0;
+  uint64_t requests_ = 0, reusedConnections_ = 0, newConnections_ = 0, handleReuses_ = 0;
+};
+
+static ConnPool& connPool() {
+  static ConnPool* pool = new ConnPool();
+  return *pool;
+}
+
+// Response body accumulator. Reserves Content-Length up front when the
+// server sends one; otherwise collects chunks that grow with the body, so a
+// large download never reallocates and re-copies what it already has.
+// Take() yields one malloc'd block that becomes an external JS Buffer.
+class BodyBuffer {
+public:
+  BodyBuffer() = default;
+  BodyBuffer(const BodyBuffer&) = delete;
+  BodyBuffer& operator=(const BodyBuffer&) = delete;
+  ~BodyBuffer(){ for (auto& c : chunks_) std::free(c.p); }
+
+  size_t size() const { return size_; }
+
+  // Only honoured before the first Append; a wrong hint is harmless.
+  void Reserve(size_t n) {
+    if (!chunks_.empty() || n == 0) return;
+    addChunk(n);
+  }
+
+  bool Append(const unsigned char* p, size_t n) {
+    while (n) {
+      if (chunks_.empty() || chunks_.back().len == chunks_.back().cap) {
+        size_t next = std::min<size_t>(std::max<size_t>(size_, kMinChunk), kMaxChunk);
+        if (!addChunk(std::max(next, std::min(n, kMaxChunk)))) return false;
+      }
+      Chunk& c = chunks_.back();
+      size_t k = std::min(n, c.cap - c.len);
+      std::memcpy(c.p + c.len, p, k);
+      c.len += k; size_ += k; p += k; n -= k;
+    }
+    return true;
+  }
+
+  // Coalesces at most once, releasing each chunk as soon as it is copied.
+  OwnedBuffer Take() {
+    if (chunks_.empty()) return OwnedBuffer();
+    unsigned char* out;
+    if (chunks_.size() == 1) {
+      out = chunks_[0].p;
+      if (chunks_[0].len < chunks_[0].cap) {
+        void* shrunk = std::realloc(out, std::max<size_t>(1, chunks_[0].len));
+        if (shrunk) out = static_cast<unsigned char*>(shrunk);
+      }
+    } else {
+      out = static_cast<unsigned char*>(std::malloc(size_));
+      if (!out) throw std::runtime_error("out of memory assembling response body");
+      size_t off = 0;
+      for (auto& c : chunks_) {
+        std::memcpy(out + off, c.p, c.len);
+        off += c.len;
+        std::free(c.p);
+      }
+    }
+    size_t n = size_;
+    chunks_.clear();
+    size_ = 0;
+    return OwnedBuffer(out, n, std::free);
+  }
+
+  // Copy into a shareable blob for the cache; the chunks stay for Take(),
+  // so a stored response costs this one copy.
+  std::shared_ptr<const std::vector<uint8_t>> CopyBlob() const {
+    auto v = std::make_shared<std::vector<uint8_t>>();
+    v->reserve(size_);
+    for (auto& c : chunks_) v->insert(v->end(), c.p, c.p + c.len);
+    return v;
+  }
+
+private:
+  static constexpr size_t kMinChunk = 64 * 1024;
+  static constexpr size_t kMaxChunk = 8 * 1024 * 1024;
+  struct Chunk { unsigned char* p; size_t cap, len; };
+
+  bool addChunk(size_t cap) {
+    auto* p = static_cast<unsigned char*>(std::malloc(cap));
+    if (!p) return false;
+    chunks_.push_back(Chunk{ p, cap, 0 });
+    return true;
+  }
+
+  std::vector<Chunk> chunks_;
+  size_t size_ = 0;
+};
+
 struct ResponseData {
-  std::vector<unsigned char> body;
+  BodyBuffer body;
   std::map<std::string, std::vector<std::string>> headers;
   long status = 0;
   std::string url;
@@ -95,12 +362,14 @@ struct ResponseData {
     if (line.empty()) return;
 
     if (line.rfind("HTTP/", 0) == 0) {
+      // "HTTP/1.1 200 OK" / "HTTP/2 200"
       resetHop();
-      std::istringstream iss(line);
-      std::string proto; iss >> proto;
-      iss >> status;
-      std::string rest; std::getline(iss, rest);
-      statusText = trim(rest);
+      size_t sp = line.find(' ');
+      if (sp == std::string::npos) return;
+      const char* codeStart = line.c_str() + sp + 1;
+      char* codeEnd = nullptr;
+      status = std::strtol(codeStart, &codeEnd, 10);
+      statusText = trim(line.substr((size_t)(codeEnd - line.c_str())));
       return;
     }
 
@@ -112,101 +381,625 @@ struct ResponseData {
   }
 };
 
-struct BodyHolder {
-  std::vector<unsigned char> data;
-  explicit BodyHolder(std::vector<unsigned char>&& v): data(std::move(v)) {}
+// Opt-in HTTP cache for GET responses (configure({ cache })). Each URL has
+// two ResultCache entries: "m:" metadata (status, headers, freshness) and
+// "b:" the body, so a 304 only rewrites the small metadata blob and the
+// cached body is handed to JS as-is. Freshness follows Cache-Control
+// max-age / no-cache / no-store, then Expires, then the usual 10%-of-age
+// heuristic on Last-Modified.
+static ResultCache& httpCache() {
+  static ResultCache* cache = new ResultCache();
+  return *cache;
+}
+
+struct HttpCacheCounters {
+  std::atomic<uint64_t> hits{0}, revalidated{0}, misses{0}, stored{0};
 };
+static HttpCacheCounters g_httpCache;
+
+// Where a transfer's time goes, from curl's own CURLINFO_*_TIME_T clocks,
+// for stats() and `trace`. dns, connect and tls only count transfers that
+// opened a connection; ttfb is the wait after the request went out,
+// transfer the body after the first byte.
+enum : size_t { kStageDns, kStageConnect, kStageTls, kStageTtfb, kStageTransfer, kStageTotal };
+enum : size_t { kBytesIn, kBytesOut, kFailedTransfers };
+
+static Metrics& fetchMetrics() {
+  static Metrics* m = new Metrics({ "dns", "connect", "tls", "ttfb", "transfer", "total" },
+                                  { "bytesIn", "bytesOut", "failed" });
+  return *m;
+}
 
-static inline void vecAppend(std::vector<unsigned char>& dst, const std::string& s) {
-  dst.insert(dst.end(), s.begin(), s.end());
+static int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
 }
-static inline void vecAppendRaw(std::vector<unsigned char>& dst, const unsigned char* p, size_t n) {
-  dst.insert(dst.end(), p, p + n);
+
+struct CachedMeta {
+  long status = 0;
+  int64_t freshUntilMs = 0;
+  bool noCache = false;
+  std::string statusText;
+  std::string url;
+  std::map<std::string, std::vector<std::string>> headers;
+
+  const std::string* header(const char* k) const {
+    auto it = headers.find(k);
+    return (it == headers.end() || it->second.empty()) ? nullptr : &it->second.back();
+  }
+
+  // "status freshUntil noCache\nstatusText\nurl\n" then one "key: value"
+  // line per header value.
+  ResultCache::Blob Serialize() const {
+    std::string out = std::to_string(status) + " " + std::to_string(freshUntilMs) + " " + (noCache ? "1" : "0") + "\n";
+    out += statusText; out += '\n';
+    out += url; out += '\n';
+    for (const auto& kv : headers)
+      for (const auto& v : kv.second) { out += kv.first; out += ": "; out += v; out += '\n'; }
+    return std::make_shared<const std::vector<uint8_t>>(out.begin(), out.end());
+  }
+
+  static bool Parse(const ResultCache::Blob& b, CachedMeta& m) {
+    std::string s(b->begin(), b->end());
+    size_t l1 = s.find('\n');
+    if (l1 == std::string::npos) return false;
+    char* end = nullptr;
+    m.status = std::strtol(s.c_str(), &end, 10);
+    m.freshUntilMs = std::strtoll(end, &end, 10);
+    m.noCache = std::strtol(end, &end, 10) != 0;
+    size_t l2 = s.find('\n', l1 + 1);
+    size_t l3 = l2 == std::string::npos ? l2 : s.find('\n', l2 + 1);
+    if (l3 == std::string::npos) return false;
+    m.statusText = s.substr(l1 + 1, l2 - l1 - 1);
+    m.url = s.substr(l2 + 1, l3 - l2 - 1);
+    for (size_t p = l3 + 1; p < s.size(); ) {
+      size_t nl = s.find('\n', p);
+      if (nl == std::string::npos) nl = s.size();
+      size_t colon = s.find(": ", p);
+      if (colon != std::string::npos && colon < nl)
+        m.headers[s.substr(p, colon - p)].push_back(s.substr(colon + 2, nl - colon - 2));
+      p = nl + 1;
+    }
+    return m.status > 0;
+  }
+};
+
+// Freshness of a response from its headers. Returns false when the
+// response must not be stored at all.
+static bool cacheFreshness(const std::map<std::string, std::vector<std::string>>& h,
+                           int64_t now, int64_t& freshUntil, bool& noCache) {
+  auto get = [&](const char* k) -> const std::string* {
+    auto it = h.find(k);
+    return (it == h.end() || it->second.empty()) ? nullptr : &it->second.back();
+  };
+  noCache = false;
+  int64_t lifetimeMs = -1;
+  if (const std::string* cc = get("cache-control")) {
+    std::string v = lower(*cc);
+    size_t p = 0;
+    while (p < v.size()) {
+      size_t comma = v.find(',', p);
+      std::string tok = trim(v.substr(p, comma == std::string::npos ? std::string::npos : comma - p));
+      if (tok == "no-store") return false;
+      if (tok == "no-cache") noCache = true;
+      if (tok.rfind("max-age=", 0) == 0) lifetimeMs = std::strtoll(tok.c_str() + 8, nullptr, 10) * 1000;
+      if (comma == std::string::npos) break;
+      p = comma + 1;
+    }
+  }
+  if (const std::string* vary = get("vary")) {
+    // the key holds decompress and the caller's Accept* headers, so the
+    // only variation it can answer for is Accept-Encoding
+    if (lower(trim(*vary)) != "accept-encoding") return false;
+  }
+  int64_t date = now;
+  if (const std::string* d = get("date")) {
+    time_t t = curl_getdate(d->c_str(), nullptr);
+    if (t > 0) date = (int64_t)t * 1000;
+  }
+  if (lifetimeMs < 0) {
+    if (const std::string* e = get("expires")) {
+      time_t t = curl_getdate(e->c_str(), nullptr);
+      lifetimeMs = t > 0 ? std::max<int64_t>(0, (int64_t)t * 1000 - date) : 0;
+    } else if (const std::string* lm = get("last-modified")) {
+      time_t t = curl_getdate(lm->c_str(), nullptr);
+      if (t > 0) lifetimeMs = std::min<int64_t>(std::max<int64_t>(0, (date - (int64_t)t * 1000) / 10), 24 * 3600 * 1000LL);
+    }
+  }
+  if (lifetimeMs < 0) lifetimeMs = 0;
+  int64_t ageMs = 0;
+  if (const std::string* a = get("age")) ageMs = std::strtoll(a->c_str(), nullptr, 10) * 1000;
+  freshUntil = now + lifetimeMs - ageMs;
+  return true;
+}
+
+// Hands a cached blob to JS as its own copy. The blob is shared with every
+// later hit, and JS may write to the Buffer it gets (decrypting media in
+// place, say), so it must not alias the cache entry.
+static Napi::Buffer<uint8_t> BlobToBuffer(Napi::Env env, const ResultCache::Blob& b) {
+  if (b->empty()) return Napi::Buffer<uint8_t>::New(env, 0);
+  return Napi::Buffer<uint8_t>::Copy(env, b->data(), b->size());
 }
+
+// Request body as a list of segments: generated text (multipart framing,
+// string fields), JS Buffers pinned by reference, and open files. Nothing is
+// copied up front; curl pulls the bytes through Read() on the I/O thread.
+// The total length is known before the transfer starts, so the request goes
+// out with an exact Content-Length instead of chunked encoding.
+class UploadBody {
+public:
+  UploadBody() = default;
+  UploadBody(const UploadBody&) = delete;
+  UploadBody& operator=(const UploadBody&) = delete;
+  ~UploadBody(){ for (auto& s : segs_) if (s.ownsFd) ::close(s.fd); }
+
+  curl_off_t size() const { return total_; }
+
+  void AddText(const std::string& t) {
+    if (t.empty()) return;
+    if (!segs_.empty() && segs_.back().kind == Seg::Text) segs_.back().text += t;
+    else { Seg s; s.kind = Seg::Text; s.text = t; segs_.push_back(std::move(s)); }
+    total_ += (curl_off_t)t.size();
+  }
+
+  // JS thread. The reference keeps the Buffer alive until the transfer is
+  // deleted, which also happens on the JS thread.
+  void AddBuffer(Napi::Buffer<uint8_t> b) {
+    if (b.Length() == 0) return;
+    pins_.push_back(Napi::Persistent(b));
+    Seg s; s.kind = Seg::Memory; s.ptr = b.Data(); s.len = b.Length();
+    total_ += (curl_off_t)s.len;
+    segs_.push_back(std::move(s));
+  }
+
+  void AddFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("cannot open upload file: " + path);
+    addFd(fd, true, path);
+  }
+
+  void AddFd(int fd) { addFd(fd, false, "fd " + std::to_string(fd)); }
+
+  // I/O thread.
+  size_t Read(char* dst, size_t n) {
+    size_t done = 0;
+    while (done < n && cur_ < segs_.size()) {
+      Seg& s = segs_[cur_];
+      size_t left = s.length() - off_;
+      size_t k = std::min(n - done, left);
+      if (s.kind == Seg::File) {
+        ssize_t r = ::pread(s.fd, dst + done, k, (off_t)off_);
+        if (r <= 0) return CURL_READFUNC_ABORT;  // file shrank or failed
+        k = (size_t)r;
+      } else {
+        std::memcpy(dst + done, s.data() + off_, k);
+      }
+      done += k; off_ += k;
+      if (off_ == s.length()) { ++cur_; off_ = 0; }
+    }
+    return done;
+  }
+
+  // I/O thread: rewinds for redirects and auth retries.
+  bool Seek(curl_off_t pos) {
+    if (pos < 0 || pos > total_) return false;
+    cur_ = 0;
+    uint64_t p = (uint64_t)pos;
+    while (cur_ < segs_.size() && p >= segs_[cur_].length()) { p -= segs_[cur_].length(); ++cur_; }
+    off_ = (size_t)p;
+    return true;
+  }
+
+private:
+  struct Seg {
+    enum Kind { Text, Memory, File } kind = Text;
+    std::string text;
+    const uint8_t* ptr = nullptr;
+    size_t len = 0;
+    int fd = -1;
+    bool ownsFd = false;
+    size_t length() const { return kind == Text ? text.size() : len; }
+    const uint8_t* data() const { return kind == Text ? reinterpret_cast<const uint8_t*>(text.data()) : ptr; }
+  };
+
+  void addFd(int fd, bool owns, const std::string& what) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      if (owns) ::close(fd);
+      throw std::runtime_error("upload source is not a regular file: " + what);
+    }
+    Seg s; s.kind = Seg::File; s.fd = fd; s.ownsFd = owns; s.len = (size_t)st.st_size;
+    segs_.push_back(std::move(s));
+    total_ += (curl_off_t)st.st_size;
+  }
+
+  std::vector<Seg> segs_;
+  std::vector<Napi::Reference<Napi::Buffer<uint8_t>>> pins_;
+  size_t cur_ = 0;
+  size_t off_ = 0;
+  curl_off_t total_ = 0;
+};
+
+// Destination for `saveTo`. Bytes are written with pwrite at their offset
+// in the file, so several range transfers can fill one file concurrently.
+// With `direct`, writes bypass the page cache through an aligned staging
+// buffer (O_DIRECT needs aligned offsets, lengths and memory); the unaligned
+// tail is written after O_DIRECT is switched off again.
+class FileSink {
+public:
+  struct Options {
+    bool resume = false;          // start at the current file size
+    bool direct = false;
+    int64_t start = 0;            // first byte offset (range transfers)
+    int64_t preallocate = 0;      // bytes to reserve from `start`
+  };
+
+  FileSink(const Napi::Value& target, const Options& o) {
+    if (target.IsNumber()) {
+      fd_ = target.ToNumber().Int32Value();
+      what_ = "fd " + std::to_string(fd_);
+    } else {
+      what_ = target.ToString().Utf8Value();
+      int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+#ifdef O_DIRECT
+      if (o.direct && o.start % kAlign == 0 && !o.resume) flags |= O_DIRECT;
+#endif
+      fd_ = ::open(what_.c_str(), flags, 0644);
+      if (fd_ < 0 && (flags & ~(O_WRONLY | O_CREAT | O_CLOEXEC))) {
+        flags = O_WRONLY | O_CREAT | O_CLOEXEC;   // filesystem without O_DIRECT
+        fd_ = ::open(what_.c_str(), flags, 0644);
+      }
+      if (fd_ < 0) throw std::runtime_error("cannot open saveTo file: " + what_ + ": " + std::strerror(errno));
+      owns_ = true;
+      direct_ = (flags & ~(O_WRONLY | O_CREAT | O_CLOEXEC)) != 0;
+    }
+    start_ = pos_ = o.start;
+    if (o.resume) {
+      struct stat st;
+      if (::fstat(fd_, &st) == 0) start_ = pos_ = (int64_t)st.st_size;
+    }
+#ifdef __linux__
+    if (o.preallocate > 0) ::posix_fallocate(fd_, (off_t)start_, (off_t)o.preallocate);
+#endif
+    if (direct_ && ::posix_memalign(reinterpret_cast<void**>(&buf_), kAlign, kStage) != 0) {
+      buf_ = nullptr;
+      dropDirect();
+    }
+  }
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+  ~FileSink(){
+    std::free(buf_);
+    if (owns_) ::close(fd_);
+  }
+
+  int64_t start() const { return start_; }
+  int64_t written() const { return pos_ + (int64_t)used_ - start_; }
+  const std::string& what() const { return what_; }
+  const std::string& error() const { return error_; }
+
+  // The server answered 200 to a resumed request: write from byte 0.
+  bool Restart() {
+    if (used_ || pos_ != start_) return false;
+    if (::ftruncate(fd_, 0) != 0) return fail("truncate");
+    start_ = pos_ = 0;
+    return true;
+  }
+
+  bool Write(const unsigned char* p, size_t n) {
+    if (!direct_) return writeAll(p, n);
+    while (n) {
+      size_t k = std::min(n, kStage - used_);
+      std::memcpy(buf_ + used_, p, k);
+      used_ += k; p += k; n -= k;
+      if (used_ == kStage && !flushStage(kStage)) return false;
+    }
+    return true;
+  }
+
+  // Writes what is still staged. Call once, after the last Write().
+  bool Finish() {
+    if (!direct_ || used_ == 0) return true;
+    size_t aligned = used_ / kAlign * kAlign;
+    if (aligned && !flushStage(aligned)) return false;
+    dropDirect();
+    size_t tail = used_;
+    used_ = 0;
+    return writeAll(buf_, tail);
+  }
+
+private:
+  static constexpr size_t kAlign = 4096;
+  static constexpr size_t kStage = 1024 * 1024;
+
+  bool writeAll(const unsigned char* p, size_t n) {
+    while (n) {
+      ssize_t r = ::pwrite(fd_, p, n, (off_t)pos_);
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        return fail("write");
+      }
+      p += r; n -= (size_t)r; pos_ += r;
+    }
+    return true;
+  }
+
+  // Writes the first `n` staged bytes (n is a multiple of kAlign) and moves
+  // the remainder to the front of the buffer.
+  bool flushStage(size_t n) {
+    size_t done = 0;
+    while (done < n) {
+      ssize_t r = ::pwrite(fd_, buf_ + done, n - done, (off_t)(pos_ + (int64_t)done));
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        return fail("write");
+      }
+      done += (size_t)r;
+    }
+    pos_ += (int64_t)n;
+    std::memmove(buf_, buf_ + n, used_ - n);
+    used_ -= n;
+    return true;
+  }
+
+  void dropDirect() {
+#ifdef O_DIRECT
+    int fl = ::fcntl(fd_, F_GETFL);
+    if (fl >= 0) ::fcntl(fd_, F_SETFL, fl & ~O_DIRECT);
+#endif
+    direct_ = false;
+  }
+
+  bool fail(const char* op) {
+    error_ = std::string(op) + " to " + what_ + " failed: " + std::strerror(errno);
+    return false;
+  }
+
+  int fd_ = -1;
+  bool owns_ = false;
+  bool direct_ = false;
+  std::string what_;
+  std::string error_;
+  int64_t start_ = 0;
+  int64_t pos_ = 0;
+  unsigned char* buf_ = nullptr;
+  size_t used_ = 0;
+};
+
 static std::string randomBoundary() {
   auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
   std::mt19937_64 rng((uint64_t)now ^ (uint64_t)std::random_device{}());
   std::uniform_int_distribution<uint64_t> dist;
-  std::ostringstream oss;
-  oss << "----LioraFormBoundary";
-  for (int i=0;i<3;i++) oss << std::hex << dist(rng);
-  return oss.str();
+  std::string out = "----LioraFormBoundary";
+  char hex[17];
+  for (int i=0;i<3;i++) {
+    std::snprintf(hex, sizeof hex, "%llx", (unsigned long long)dist(rng));
+    out += hex;
+  }
+  return out;
 }
 
+// Buffer-valued parts are pinned, not copied; `{ path }` and `{ fd }` parts
+// are streamed from disk.
 static void buildMultipartFromNapi(const Napi::Object& formObj,
-                                   std::vector<unsigned char>& outBody,
+                                   UploadBody& out,
                                    std::string& outBoundary) {
   outBoundary = randomBoundary();
   auto keys = formObj.GetPropertyNames();
   for (uint32_t i=0;i<keys.Length();++i) {
     std::string name = keys.Get(i).ToString().Utf8Value();
     Napi::Value v = formObj.Get(name);
-    vecAppend(outBody, "--" + outBoundary + "\r\n");
+    out.AddText("--" + outBoundary + "\r\n");
 
     std::string filename;
     std::string contentType;
-    const unsigned char* dataPtr = nullptr;
-    size_t dataLen = 0;
     std::string textVal;
 
-    auto flushDataPart = [&](bool isFile){
-      std::ostringstream head;
-      head << "Content-Disposition: form-data; name=\"" << name << "\"";
-      if (isFile) {
-        if (filename.empty()) filename = "blob";
-        head << "; filename=\"" << filename << "\"\r\n";
-        if (contentType.empty()) contentType = "application/octet-stream";
-        head << "Content-Type: " << contentType << "\r\n\r\n";
-        vecAppend(outBody, head.str());
-        if (dataPtr && dataLen) vecAppendRaw(outBody, dataPtr, dataLen);
-        vecAppend(outBody, "\r\n");
-      } else {
-        head << "\r\n\r\n";
-        vecAppend(outBody, head.str());
-        vecAppend(outBody, textVal);
-        vecAppend(outBody, "\r\n");
-      }
+    auto fileHead = [&](){
+      if (filename.empty()) filename = "blob";
+      if (contentType.empty()) contentType = "application/octet-stream";
+      out.AddText("Content-Disposition: form-data; name=\"" + name + "\"; filename=\"" + filename + "\"\r\n"
+                  "Content-Type: " + contentType + "\r\n\r\n");
+    };
+    auto textPart = [&](){
+      out.AddText("Content-Disposition: form-data; name=\"" + name + "\"\r\n\r\n");
+      out.AddText(textVal);
+      out.AddText("\r\n");
+    };
+    auto bufferOf = [](const Napi::Object& o) -> Napi::Value {
+      for (const char* k : { "value", "data", "buffer" })
+        if (o.Has(k) && o.Get(k).IsBuffer()) return o.Get(k);
+      return Napi::Value();
     };
 
     if (v.IsBuffer()) {
-      auto b = v.As<Napi::Buffer<uint8_t>>();
-      dataPtr = b.Data();
-      dataLen = b.Length();
-      flushDataPart(true);
+      fileHead();
+      out.AddBuffer(v.As<Napi::Buffer<uint8_t>>());
+      out.AddText("\r\n");
     } else if (v.IsObject()) {
       Napi::Object o = v.As<Napi::Object>();
-      if (o.Has("value") && o.Get("value").IsBuffer()) {
-        auto b = o.Get("value").As<Napi::Buffer<uint8_t>>();
-        dataPtr = b.Data(); dataLen = b.Length();
-      } else if (o.Has("data") && o.Get("data").IsBuffer()) {
-        auto b = o.Get("data").As<Napi::Buffer<uint8_t>>();
-        dataPtr = b.Data(); dataLen = b.Length();
-      } else if (o.Has("buffer") && o.Get("buffer").IsBuffer()) {
-        auto b = o.Get("buffer").As<Napi::Buffer<uint8_t>>();
-        dataPtr = b.Data(); dataLen = b.Length();
-      } else if (o.Has("value")) {
-        auto s = o.Get("value").ToString().Utf8Value();
-        textVal = s;
-      } else {
-        textVal = o.ToString().Utf8Value();
-      }
       if (o.Has("filename")) filename = o.Get("filename").ToString().Utf8Value();
       if (o.Has("contentType")) contentType = o.Get("contentType").ToString().Utf8Value();
 
-      if (dataPtr && dataLen) flushDataPart(true);
-      else flushDataPart(false);
+      Napi::Value buf = bufferOf(o);
+      if (!buf.IsEmpty() && buf.As<Napi::Buffer<uint8_t>>().Length() > 0) {
+        fileHead();
+        out.AddBuffer(buf.As<Napi::Buffer<uint8_t>>());
+        out.AddText("\r\n");
+      } else if (o.Has("path") && o.Get("path").IsString()) {
+        std::string path = o.Get("path").ToString().Utf8Value();
+        if (filename.empty()) {
+          size_t slash = path.find_last_of('/');
+          filename = slash == std::string::npos ? path : path.substr(slash + 1);
+        }
+        fileHead();
+        out.AddFile(path);
+        out.AddText("\r\n");
+      } else if (o.Has("fd") && o.Get("fd").IsNumber()) {
+        fileHead();
+        out.AddFd(o.Get("fd").ToNumber().Int32Value());
+        out.AddText("\r\n");
+      } else {
+        textVal = o.Has("value") ? o.Get("value").ToString().Utf8Value() : o.ToString().Utf8Value();
+        textPart();
+      }
     } else {
       textVal = v.ToString().Utf8Value();
-      flushDataPart(false);
+      textPart();
     }
   }
-  vecAppend(outBody, "--" + outBoundary + "--\r\n");
+  out.AddText("--" + outBoundary + "--\r\n");
 }
 
-class FetchWorker : public Napi::AsyncWorker {
+// Response headers as one native class: the methods live on the prototype
+// and JS strings are only created for what the caller actually reads. Names
+// are lower case; repeated headers are joined with ", " as in the Fetch
+// Headers class, and getSetCookie() returns Set-Cookie values separately.
+class HeadersWrap : public Napi::ObjectWrap<HeadersWrap> {
 public:
-  FetchWorker(Napi::Env env, std::string url, Napi::Object opts, Napi::Promise::Deferred def)
-  : Napi::AsyncWorker(env), deferred_(def), url_(std::move(url)) {
+  using Map = std::map<std::string, std::vector<std::string>>;
+
+  static void Init(Napi::Env env, Napi::FunctionReference& ctor) {
+    Napi::Function cls = DefineClass(env, "Headers", {
+      InstanceMethod("get", &HeadersWrap::Get),
+      InstanceMethod("has", &HeadersWrap::Has),
+      InstanceMethod("forEach", &HeadersWrap::ForEach),
+      InstanceMethod("entries", &HeadersWrap::Entries),
+      InstanceMethod("keys", &HeadersWrap::Keys),
+      InstanceMethod("values", &HeadersWrap::Values),
+      InstanceMethod("getSetCookie", &HeadersWrap::GetSetCookie),
+      InstanceMethod("toJSON", &HeadersWrap::ToJSON),
+      InstanceMethod(Napi::Symbol::WellKnown(env, "iterator"), &HeadersWrap::Entries),
+    });
+    ctor = Napi::Persistent(cls);
+  }
+
+  // JS thread. The map is taken over without converting anything.
+  static Napi::Object New(Napi::FunctionReference& ctor, Map&& m) {
+    pending_ = std::make_shared<const Map>(std::move(m));
+    Napi::Object o = ctor.New({});
+    pending_.reset();
+    return o;
+  }
+
+  explicit HeadersWrap(const Napi::CallbackInfo& info)
+  : Napi::ObjectWrap<HeadersWrap>(info),
+    map_(pending_ ? pending_ : std::make_shared<const Map>()) {}
+
+private:
+  static std::string joined(const std::vector<std::string>& v) {
+    std::string out;
+    for (size_t i = 0; i < v.size(); ++i) { if (i) out += ", "; out += v[i]; }
+    return out;
+  }
+
+  const std::vector<std::string>* find(const Napi::CallbackInfo& info) const {
+    if (info.Length() < 1) return nullptr;
+    auto it = map_->find(lower(info[0].ToString().Utf8Value()));
+    return it == map_->end() ? nullptr : &it->second;
+  }
+
+  // entries()/keys()/values() return iterators like the Fetch API
+  static Napi::Value iterate(Napi::Env env, Napi::Array a) {
+    Napi::Value it = a.Get(Napi::Symbol::WellKnown(env, "iterator"));
+    return it.As<Napi::Function>().Call(a, {});
+  }
+
+  Napi::Value Get(const Napi::CallbackInfo& info) {
+    const auto* v = find(info);
+    if (!v) return info.Env().Null();
+    return Napi::String::New(info.Env(), joined(*v));
+  }
+
+  Napi::Value Has(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), find(info) != nullptr);
+  }
+
+  Napi::Value ForEach(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsFunction()) {
+      Napi::TypeError::New(env, "forEach(callback) requires a function").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    Napi::Function cb = info[0].As<Napi::Function>();
+    Napi::Value self = info.This();
+    Napi::Value thisArg = info.Length() > 1 ? info[1] : env.Undefined();
+    for (const auto& kv : *map_)
+      cb.Call(thisArg, { Napi::String::New(env, joined(kv.second)), Napi::String::New(env, kv.first), self });
+    return env.Undefined();
+  }
+
+  Napi::Value Entries(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Array out = Napi::Array::New(env, map_->size());
+    uint32_t i = 0;
+    for (const auto& kv : *map_) {
+      Napi::Array e = Napi::Array::New(env, 2);
+      e.Set((uint32_t)0, Napi::String::New(env, kv.first));
+      e.Set((uint32_t)1, Napi::String::New(env, joined(kv.second)));
+      out.Set(i++, e);
+    }
+    return iterate(env, out);
+  }
+
+  Napi::Value Keys(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Array out = Napi::Array::New(env, map_->size());
+    uint32_t i = 0;
+    for (const auto& kv : *map_) out.Set(i++, Napi::String::New(env, kv.first));
+    return iterate(env, out);
+  }
+
+  Napi::Value Values(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Array out = Napi::Array::New(env, map_->size());
+    uint32_t i = 0;
+    for (const auto& kv : *map_) out.Set(i++, Napi::String::New(env, joined(kv.second)));
+    return iterate(env, out);
+  }
+
+  Napi::Value GetSetCookie(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    auto it = map_->find("set-cookie");
+    size_t n = it == map_->end() ? 0 : it->second.size();
+    Napi::Array out = Napi::Array::New(env, n);
+    for (size_t i = 0; i < n; ++i) out.Set((uint32_t)i, Napi::String::New(env, it->second[i]));
+    return out;
+  }
+
+  Napi::Value ToJSON(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Object out = Napi::Object::New(env);
+    for (const auto& kv : *map_) out.Set(kv.first, Napi::String::New(env, joined(kv.second)));
+    return out;
+  }
+
+  static thread_local std::shared_ptr<const Map> pending_;
+  std::shared_ptr<const Map> map_;
+};
+thread_local std::shared_ptr<const HeadersWrap::Map> HeadersWrap::pending_;
+
+// Per-environment state: constructors of the classes handed to JS.
+struct AddonData {
+  Napi::FunctionReference headers;
+};
+
+class FetchEngine;
+class FetchBatch;
+
+// One request. Built on the JS thread, driven by the engine's I/O thread
+// (Setup, the curl callbacks, Complete), then handed back to JS through its
+// own ThreadSafeFunction. Data chunks, progress events and the final
+// resolve/reject are all queued on that one TSFN, so JS sees them in order,
+// and the transfer deletes itself after the last one.
+class FetchTransfer {
+public:
+  // `batch` is set for fetchMany members, which report to the batch instead
+  // of settling a promise of their own and do not stream.
+  FetchTransfer(Napi::Env env, std::string url, Napi::Object opts,
+                std::optional<Napi::Promise::Deferred> def, FetchBatch* batch = nullptr, size_t index = 0)
+  : deferred_(def), batch_(batch), index_(index), url_(std::move(url)), host_(hostKey(url_)),
+    abort_(std::make_shared<std::atomic<bool>>(false)) {
     method_         = getString(opts, "method", "GET");
     timeoutMs_      = getInt(opts, "timeout", 300000);
     maxRedirects_   = getInt(opts, "maxRedirects", 20);
@@ -216,6 +1009,27 @@ public:
     cookieFile_     = getString(opts, "cookieFile", "");
     cookieString_   = getString(opts, "cookie", "");
     maxBodySize_    = getInt64(opts, "maxBodySize", -1);
+    trace_          = getBool(opts, "trace", false);
+
+    if (opts.Has("range") && opts.Get("range").IsArray()) {
+      Napi::Array r = opts.Get("range").As<Napi::Array>();
+      rangeStart_ = r.Length() > 0 ? r.Get((uint32_t)0).ToNumber().Int64Value() : 0;
+      rangeEnd_   = r.Length() > 1 ? r.Get((uint32_t)1).ToNumber().Int64Value() : -1;
+      if (rangeStart_ < 0 || (rangeEnd_ >= 0 && rangeEnd_ < rangeStart_))
+        throw std::runtime_error("range must be [start, end] with 0 <= start <= end");
+    }
+
+    if (opts.Has("saveTo") && !opts.Get("saveTo").IsUndefined()) {
+      FileSink::Options so;
+      so.resume = getBool(opts, "resume", false);
+      so.direct = getBool(opts, "direct", false);
+      so.preallocate = getInt64(opts, "preallocate", 0);
+      if (rangeStart_ >= 0) {
+        so.start = rangeStart_;
+        so.resume = false;
+      }
+      sink_ = std::make_unique<FileSink>(opts.Get("saveTo"), so);
+    }
 
     if (opts.Has("headers") && opts.Get("headers").IsObject()) {
       Napi::Object h = opts.Get("headers").As<Napi::Object>();
@@ -230,151 +1044,225 @@ public:
       haveConn_        = h.Has("Connection") || h.Has("connection");
       haveExpect_      = h.Has("Expect") || h.Has("expect");
       haveContentType_ = h.Has("Content-Type") || h.Has("content-type");
+      haveCredentials_ = h.Has("Authorization") || h.Has("authorization") || h.Has("Cookie") || h.Has("cookie");
     }
 
     if (opts.Has("body")) {
       auto v = opts.Get("body");
-      if (v.IsBuffer()) {
-        auto b = v.As<Napi::Buffer<uint8_t>>();
-        body_.assign(b.Data(), b.Data() + b.Length());
-      } else {
-        auto s = v.ToString().Utf8Value();
-        body_.assign(s.begin(), s.end());
-      }
+      upload_ = std::make_unique<UploadBody>();
+      if (v.IsBuffer()) upload_->AddBuffer(v.As<Napi::Buffer<uint8_t>>());
+      else upload_->AddText(v.ToString().Utf8Value());
     }
 
     if (opts.Has("formData") && opts.Get("formData").IsObject()) {
       Napi::Object form = opts.Get("formData").As<Napi::Object>();
-      multipartBoundary_.clear();
-      multipartBody_.clear();
-      buildMultipartFromNapi(form, multipartBody_, multipartBoundary_);
+      upload_ = std::make_unique<UploadBody>();
+      buildMultipartFromNapi(form, *upload_, multipartBoundary_);
       useMultipart_ = true;
-      body_.clear();
     }
 
-    if (opts.Has("onData") && opts.Get("onData").IsFunction()) {
-      tsfnData_ = Napi::ThreadSafeFunction::New(env,
-        opts.Get("onData").As<Napi::Function>(), "fetch:onData", 0, 1);
+    if (!batch_ && opts.Has("onData") && opts.Get("onData").IsFunction()) {
+      onData_ = Napi::Persistent(opts.Get("onData").As<Napi::Function>());
       streaming_ = true;
+      int64_t hwm = opts.Has("highWaterMark") ? opts.Get("highWaterMark").ToNumber().Int64Value() : 256 * 1024;
+      highWaterMark_ = (size_t)std::max<int64_t>(1024, hwm);
+      stream_ = std::make_shared<StreamCredit>();
     }
-    if (opts.Has("onProgress") && opts.Get("onProgress").IsFunction()) {
-      tsfnProg_ = Napi::ThreadSafeFunction::New(env,
-        opts.Get("onProgress").As<Napi::Function>(), "fetch:onProgress", 0, 1);
+    if (!batch_ && opts.Has("onProgress") && opts.Get("onProgress").IsFunction()) {
+      onProgress_ = Napi::Persistent(opts.Get("onProgress").As<Napi::Function>());
       wantProgress_ = true;
     }
 
-    abort_.store(false);
-  }
+    // "default" | "no-cache" (always revalidate) | "reload" (skip lookup,
+    // still store) | "no-store"; only plain, whole-body GETs without
+    // credentials qualify
+    cacheMode_ = getString(opts, "cache", "default");
+    if (cacheMode_ != "no-store" && lower(method_) == "get" && !upload_ && !sink_ && !streaming_ &&
+        rangeStart_ < 0 &&
+        !haveCredentials_ && cookieString_.empty() && cookieFile_.empty() && httpCache().Enabled()) {
+      // The stored bytes also depend on whether they were decoded and on
+      // any Accept* header the caller chose, so those join the URL.
+      std::vector<std::string> accept;
+      for (const auto& kv : headersKVs_) {
+        size_t colon = kv.find(':');
+        std::string name = lower(kv.substr(0, colon));
+        if (name.rfind("accept", 0) == 0)
+          accept.push_back(name + (colon == std::string::npos ? "" : kv.substr(colon)));
+      }
+      std::sort(accept.begin(), accept.end());
+      cacheKey_ = url_;
+      if (!decompress_) cacheKey_ += "\n!decompress";
+      for (const auto& a : accept) cacheKey_ += "\n" + a;
+    }
 
-  ~FetchWorker() override {
-    if (tsfnData_) tsfnData_.Release();
-    if (tsfnProg_) tsfnProg_.Release();
+    if (!batch_)
+      tsfn_ = Napi::ThreadSafeFunction::New(env,
+        Napi::Function::New(env, [](const Napi::CallbackInfo&){}), "fetch:transfer", 0, 1);
   }
 
-  void Execute() override {
-    ensureCurlGlobal();
-    initShare();
-
-    Easy easy(curl_easy_init());
-    if (!easy) throw std::runtime_error("curl_easy_init failed");
+  const std::string& host() const { return host_; }
+  const std::shared_ptr<std::atomic<bool>>& token() const { return abort_; }
+  bool aborted() const { return abort_->load(); }
+  bool ok() const { return error_.empty(); }
+
+  // I/O thread, before the request goes out: true when a fresh cached copy
+  // answers it. A stale copy with validators is kept for revalidation.
+  bool ServeFromCache() {
+    if (cacheKey_.empty() || cacheMode_ == "reload") return false;
+    ResultCache::Blob m = httpCache().Get("m:" + cacheKey_);
+    CachedMeta meta;
+    if (!m || !CachedMeta::Parse(m, meta)) return false;
+    ResultCache::Blob b = httpCache().Get("b:" + cacheKey_);
+    if (!b) return false;
+    if (cacheMode_ == "default" && !meta.noCache && nowMs() < meta.freshUntilMs) {
+      useCached(meta, b);
+      cacheState_ = "hit";
+      g_httpCache.hits.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    if (meta.header("etag") || meta.header("last-modified")) {
+      stale_ = std::make_unique<CachedMeta>(std::move(meta));
+      cachedBody_ = b;
+    }
+    return false;
+  }
 
-    if (g_share) curl_easy_setopt(easy.get(), CURLOPT_SHARE, g_share);
+  // I/O thread: configure a (possibly recycled) handle for this request.
+  void Setup(CURL* easy) {
+    if (g_share) curl_easy_setopt(easy, CURLOPT_SHARE, g_share);
 
-    curl_easy_setopt(easy.get(), CURLOPT_URL, url_.c_str());
+    curl_easy_setopt(easy, CURLOPT_URL, url_.c_str());
 
-    curl_easy_setopt(easy.get(), CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
 #ifdef CURLALPN_ENABLED
-    curl_easy_setopt(easy.get(), CURLOPT_SSL_ENABLE_ALPN, 1L);
+    curl_easy_setopt(easy, CURLOPT_SSL_ENABLE_ALPN, 1L);
 #endif
 
-    if (ipResolve_ == "v4") curl_easy_setopt(easy.get(), CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
-    else if (ipResolve_ == "v6") curl_easy_setopt(easy.get(), CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
-    else curl_easy_setopt(easy.get(), CURLOPT_IPRESOLVE, CURL_IPRESOLVE_WHATEVER);
+    if (ipResolve_ == "v4") curl_easy_setopt(easy, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
+    else if (ipResolve_ == "v6") curl_easy_setopt(easy, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
+    else curl_easy_setopt(easy, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_WHATEVER);
 
     std::string methodUp = method_;
     std::transform(methodUp.begin(), methodUp.end(), methodUp.begin(), ::toupper);
-    if      (methodUp == "GET")  curl_easy_setopt(easy.get(), CURLOPT_HTTPGET, 1L);
-    else if (methodUp == "POST") curl_easy_setopt(easy.get(), CURLOPT_POST, 1L);
-    else if (methodUp == "HEAD") curl_easy_setopt(easy.get(), CURLOPT_NOBODY, 1L);
-    else                         curl_easy_setopt(easy.get(), CURLOPT_CUSTOMREQUEST, method_.c_str());
+    if      (methodUp == "GET")  curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+    else if (methodUp == "POST") curl_easy_setopt(easy, CURLOPT_POST, 1L);
+    else if (methodUp == "HEAD") curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+    else                         curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, method_.c_str());
 
-    SList hdrs;
-    if (!haveUserUA_)    hdrs.append("User-Agent: undici/6 naruyaizumi");
+    if (!haveUserUA_)    hdrs_.append("User-Agent: undici/6 naruyaizumi");
     if (!haveAcceptEnc_ && decompress_) {
-      curl_easy_setopt(easy.get(), CURLOPT_ACCEPT_ENCODING, "");
-      hdrs.append("Accept-Encoding: br, gzip, deflate");
-    }
-    if (!haveConn_)      hdrs.append("Connection: keep-alive");
-    if (!haveExpect_)    hdrs.append("Expect:");
-
-    if (useMultipart_) {
-      curl_easy_setopt(easy.get(), CURLOPT_POSTFIELDS, reinterpret_cast<char*>(multipartBody_.data()));
-      curl_easy_setopt(easy.get(), CURLOPT_POSTFIELDSIZE, static_cast<long>(multipartBody_.size()));
-      if (!haveContentType_) {
-        std::string ct = "Content-Type: multipart/form-data; boundary=" + multipartBoundary_;
-        hdrs.append(ct.c_str());
-      }
-    } else if (!body_.empty()) {
-      curl_easy_setopt(easy.get(), CURLOPT_POSTFIELDS, reinterpret_cast<char*>(body_.data()));
-      curl_easy_setopt(easy.get(), CURLOPT_POSTFIELDSIZE, static_cast<long>(body_.size()));
+      curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+      hdrs_.append("Accept-Encoding: br, gzip, deflate");
+    }
+    if (!haveConn_)      hdrs_.append("Connection: keep-alive");
+    if (!haveExpect_)    hdrs_.append("Expect:");
+
+    if (upload_ && upload_->size() > 0) {
+      // POST semantics (CUSTOMREQUEST still names the method) with the
+      // body pulled through the read callback
+      curl_easy_setopt(easy, CURLOPT_POST, 1L);
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, upload_->size());
+      curl_easy_setopt(easy, CURLOPT_READDATA, upload_.get());
+      curl_easy_setopt(easy, CURLOPT_READFUNCTION, &FetchTransfer::readBodyTramp);
+      curl_easy_setopt(easy, CURLOPT_SEEKDATA, upload_.get());
+      curl_easy_setopt(easy, CURLOPT_SEEKFUNCTION, &FetchTransfer::seekBodyTramp);
+    }
+    if (rangeStart_ >= 0) {
+      std::string range = std::to_string(rangeStart_) + "-" + (rangeEnd_ >= 0 ? std::to_string(rangeEnd_) : "");
+      curl_easy_setopt(easy, CURLOPT_RANGE, range.c_str());   // copied by libcurl
+    } else if (sink_ && sink_->start() > 0) {
+      curl_easy_setopt(easy, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)sink_->start());
+    }
+
+    if (useMultipart_ && !haveContentType_) {
+      std::string ct = "Content-Type: multipart/form-data; boundary=" + multipartBoundary_;
+      hdrs_.append(ct.c_str());
+    }
+
+    if (stale_) {
+      if (const std::string* etag = stale_->header("etag"))
+        hdrs_.append(("If-None-Match: " + *etag).c_str());
+      if (const std::string* lm = stale_->header("last-modified"))
+        hdrs_.append(("If-Modified-Since: " + *lm).c_str());
     }
 
-    for (const auto& h : headersKVs_) hdrs.append(h.c_str());
-    if (hdrs.get()) curl_easy_setopt(easy.get(), CURLOPT_HTTPHEADER, hdrs.get());
+    for (const auto& h : headersKVs_) hdrs_.append(h.c_str());
+    if (hdrs_.get()) curl_easy_setopt(easy, CURLOPT_HTTPHEADER, hdrs_.get());
 
     if (!cookieFile_.empty()) {
-      curl_easy_setopt(easy.get(), CURLOPT_COOKIEFILE, cookieFile_.c_str());
-      curl_easy_setopt(easy.get(), CURLOPT_COOKIEJAR,  cookieFile_.c_str());
+      curl_easy_setopt(easy, CURLOPT_COOKIEFILE, cookieFile_.c_str());
+      curl_easy_setopt(easy, CURLOPT_COOKIEJAR,  cookieFile_.c_str());
     }
     if (!cookieString_.empty()) {
-      curl_easy_setopt(easy.get(), CURLOPT_COOKIE, cookieString_.c_str());
+      curl_easy_setopt(easy, CURLOPT_COOKIE, cookieString_.c_str());
     }
 
-    curl_easy_setopt(easy.get(), CURLOPT_SSL_VERIFYPEER, insecureTLS_ ? 0L : 1L);
-    curl_easy_setopt(easy.get(), CURLOPT_SSL_VERIFYHOST, insecureTLS_ ? 0L : 2L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, insecureTLS_ ? 0L : 1L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, insecureTLS_ ? 0L : 2L);
 #ifdef CURL_SSLVERSION_TLSv1_3
-    curl_easy_setopt(easy.get(), CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_3);
+    curl_easy_setopt(easy, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_3);
 #endif
 
-    curl_easy_setopt(easy.get(), CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(easy.get(), CURLOPT_MAXREDIRS, static_cast<long>(maxRedirects_));
-    curl_easy_setopt(easy.get(), CURLOPT_AUTOREFERER, 1L);
-    curl_easy_setopt(easy.get(), CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(timeoutMs_));
-    curl_easy_setopt(easy.get(), CURLOPT_TIMEOUT_MS,       static_cast<long>(timeoutMs_));
-    curl_easy_setopt(easy.get(), CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(easy.get(), CURLOPT_TCP_KEEPALIVE, 1L);
-    curl_easy_setopt(easy.get(), CURLOPT_TCP_KEEPIDLE, 30L);
-    curl_easy_setopt(easy.get(), CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_MAXREDIRS, static_cast<long>(maxRedirects_));
+    curl_easy_setopt(easy, CURLOPT_AUTOREFERER, 1L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(timeoutMs_));
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS,       static_cast<long>(timeoutMs_));
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPINTVL, 15L);
 #ifdef CURLOPT_TCP_NODELAY
-    curl_easy_setopt(easy.get(), CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
 #endif
 #ifdef CURLOPT_BUFFERSIZE
-    curl_easy_setopt(easy.get(), CURLOPT_BUFFERSIZE, 256 * 1024L);
+    curl_easy_setopt(easy, CURLOPT_BUFFERSIZE, 256 * 1024L);
 #endif
-    curl_easy_setopt(easy.get(), CURLOPT_DNS_CACHE_TIMEOUT, 120L);
+    curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, 120L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+    long idleSec = std::max(1L, connPool().GetOptions().idleTimeoutMs / 1000);
+    curl_easy_setopt(easy, CURLOPT_MAXAGE_CONN, idleSec);
+#endif
+
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &FetchTransfer::writeBodyTramp);
 
-    curl_easy_setopt(easy.get(), CURLOPT_WRITEDATA, this);
-    curl_easy_setopt(easy.get(), CURLOPT_WRITEFUNCTION, &FetchWorker::writeBodyTramp);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &FetchTransfer::writeHeaderTramp);
 
-    curl_easy_setopt(easy.get(), CURLOPT_HEADERDATA, this);
-    curl_easy_setopt(easy.get(), CURLOPT_HEADERFUNCTION, &FetchWorker::writeHeaderTramp);
+    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, this);
+    curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, &FetchTransfer::xferinfoTramp);
+    // always on: the progress callback is also where aborts are noticed
+    curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
+  }
 
-    curl_easy_setopt(easy.get(), CURLOPT_XFERINFODATA, this);
-    curl_easy_setopt(easy.get(), CURLOPT_XFERINFOFUNCTION, &FetchWorker::xferinfoTramp);
-    curl_easy_setopt(easy.get(), CURLOPT_NOPROGRESS, wantProgress_ ? 0L : 1L);
+  // I/O thread: the transfer left the multi handle with `rc`. Reads what is
+  // needed from the handle before it goes back to the pool.
+  void Complete(CURL* easy, CURLcode rc) {
+    finishTransfer(easy, rc);
+    if (easy) recordTimings(easy);
+    if (!error_.empty()) clock_.Count(kFailedTransfers, 1);
+    clock_.Commit();
+  }
 
-    CURLcode rc = curl_easy_perform(easy.get());
-    if (abort_.load()) throw std::runtime_error("request aborted");
+  void finishTransfer(CURL* easy, CURLcode rc) {
+    if (aborted()) { error_ = "request aborted"; return; }
+    if (sink_ && !sink_->error().empty()) { error_ = sink_->error(); return; }
+    if (!error_.empty()) return;
     if (rc != CURLE_OK) {
-      throw std::runtime_error(std::string("curl perform error: ") + curl_easy_strerror(rc));
+      error_ = std::string("curl perform error: ") + curl_easy_strerror(rc);
+      return;
     }
+    if (sink_ && toFile_ && !sink_->Finish()) { error_ = sink_->error(); return; }
 
     long httpStatus = 0;
-    curl_easy_getinfo(easy.get(), CURLINFO_RESPONSE_CODE, &httpStatus);
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &httpStatus);
     resp_.status = httpStatus;
 
     char* eff = nullptr;
-    if (curl_easy_getinfo(easy.get(), CURLINFO_EFFECTIVE_URL, &eff) == CURLE_OK && eff) {
+    if (curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &eff) == CURLE_OK && eff) {
       resp_.url.assign(eff);
     }
 
@@ -393,176 +1281,308 @@ public:
         default:  resp_.statusText = ""; break;
       }
     }
+
+    if (!cacheKey_.empty()) updateCache();
+  }
+
+  // I/O thread: queue the final resolve/reject behind any pending data or
+  // progress calls. The transfer is deleted on the JS thread afterwards.
+  void Deliver();
+
+  // JS thread: settle a standalone transfer.
+  void Settle(Napi::Env env) {
+    if (error_.empty()) deferred_->Resolve(BuildResponse(env));
+    else deferred_->Reject(Napi::Error::New(env, error_).Value());
+  }
+
+  void deliverSelf() {
+    Napi::ThreadSafeFunction tsfn = tsfn_;
+    napi_status st = tsfn.NonBlockingCall(this, [](Napi::Env env, Napi::Function, FetchTransfer* t){
+      Napi::HandleScope scope(env);
+      t->Settle(env);
+      delete t;
+    });
+    tsfn.Release();
+    if (st != napi_ok) delete this;  // environment is going away
+  }
+
+  void Fail(const std::string& msg) { error_ = msg; }
+
+  // Teardown only (JS thread, from the cleanup hook): drop without settling.
+  void Abandon() {
+    if (pipe_) pipe_->Close("fetch engine stopped");
+    if (tsfn_) tsfn_.Release();
+    delete this;
+  }
+
+  // JS thread: abort handle for the { promise, abort } contract. Captures
+  // only the token, so it stays safe to call after the transfer is gone.
+  Napi::Function makeAbort(Napi::Env env);
+
+  // JS thread, before Submit: the engine that will run this transfer.
+  void Bind(FetchEngine* engine) { engine_ = engine; }
+
+  // JS thread, after Bind: send a successful body into a PipeStream instead
+  // of memory. Other responses keep their body on the response as usual.
+  Napi::Value OpenPipe(Napi::Env env, size_t capacity);
+
+  // I/O thread: hand staged onData bytes to JS as one batch.
+  void FlushData() {
+    if (!streaming_ || staged_.size() == 0) return;
+    size_t n = staged_.size();
+    auto* msg = new DataMsg{ this, staged_.Take(), n };
+    stagedSince_ = {};
+    stream_->inflight.fetch_add(n);
+    napi_status st = tsfn_.NonBlockingCall(msg, [](Napi::Env env, Napi::Function, DataMsg* m){
+      Napi::HandleScope scope(env);
+      FetchTransfer* t = m->t;
+      Napi::Value r = t->onData_.Call({ m->buf.ToBuffer(env) });
+      AckWhenSettled(env, r, t->stream_, t->engine_, t->abort_, m->size);
+      delete m;
+    });
+    if (st != napi_ok) { stream_->inflight.fetch_sub(n); delete msg; }
   }
 
-  void OnOK() override {
-    Napi::Env env = Env();
+  bool HasStaged() const { return staged_.size() != 0; }
+  std::chrono::steady_clock::time_point StagedSince() const { return stagedSince_; }
 
+  const std::string& error() const { return error_; }
+  size_t index() const { return index_; }
+
+  // JS thread: the response object handed to JS.
+  Napi::Object BuildResponse(Napi::Env env) {
     Napi::Object res = Napi::Object::New(env);
     res.Set("status", Napi::Number::New(env, resp_.status));
     res.Set("statusText", Napi::String::New(env, resp_.statusText));
     res.Set("url", Napi::String::New(env, resp_.url));
     res.Set("ok", Napi::Boolean::New(env, resp_.status >= 200 && resp_.status < 300));
 
-    Napi::Object h = Napi::Object::New(env);
-    Napi::Object first = Napi::Object::New(env);
-    for (auto& kv : resp_.headers) {
-      Napi::Array arr = Napi::Array::New(env, kv.second.size());
-      for (size_t i=0;i<kv.second.size();++i)
-        arr.Set((uint32_t)i, Napi::String::New(env, kv.second[i]));
-      h.Set(kv.first, arr);
-      if (!kv.second.empty())
-        first.Set(kv.first, Napi::String::New(env, kv.second.front()));
-    }
-    h.Set("__first", first);
-    h.Set("get", Napi::Function::New(env, [](const Napi::CallbackInfo& info)->Napi::Value{
-      Napi::Env e = info.Env();
-      if (info.Length() < 1) return e.Undefined();
-      std::string key = info[0].ToString().Utf8Value();
-      std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c){ return std::tolower(c); });
-      Napi::Object self = info.This().As<Napi::Object>();
-      Napi::Value vf = self.Get("__first");
-      if (!vf.IsObject()) return e.Undefined();
-      Napi::Value v = vf.As<Napi::Object>().Get(key);
-      if (v.IsUndefined()) return e.Undefined();
-      return v;
-    }));
-    h.Set("forEach", Napi::Function::New(env, [](const Napi::CallbackInfo& info)->Napi::Value{
-      Napi::Env e = info.Env();
-      if (info.Length() < 1 || !info[0].IsFunction()) {
-        return e.Undefined();
-      }
-      Napi::Function callback = info[0].As<Napi::Function>();
-      Napi::Object self = info.This().As<Napi::Object>();
-      Napi::Value vf = self.Get("__first");
-      if (!vf.IsObject()) return e.Undefined();
-      Napi::Object firstObj = vf.As<Napi::Object>();
-      Napi::Array keys = firstObj.GetPropertyNames();
-      for (uint32_t i = 0; i < keys.Length(); ++i) {
-        Napi::Value keyVal = keys.Get(i);
-        std::string key = keyVal.ToString().Utf8Value();
-        Napi::Value value = firstObj.Get(key);
-        callback.Call({ value, keyVal, self });
-      }
-      return e.Undefined();
-    }));
-    h.Set("entries", Napi::Function::New(env, [](const Napi::CallbackInfo& info)->Napi::Value{
-      Napi::Env e = info.Env();
-      Napi::Object self = info.This().As<Napi::Object>();
-      Napi::Value vf = self.Get("__first");
-      if (!vf.IsObject()) return Napi::Array::New(e, 0);
-      Napi::Object firstObj = vf.As<Napi::Object>();
-      Napi::Array keys = firstObj.GetPropertyNames();
-      Napi::Array result = Napi::Array::New(e);
-      for (uint32_t i = 0; i < keys.Length(); ++i) {
-        Napi::Value keyVal = keys.Get(i);
-        Napi::Value value = firstObj.Get(keyVal.ToString());
-        Napi::Array entry = Napi::Array::New(e, 2);
-        entry.Set((uint32_t)0, keyVal);
-        entry.Set((uint32_t)1, value);
-        result.Set(i, entry);
-      }
-      return result;
-    }));
-    
-    res.Set("headers", h);
-
-    auto* holder = new BodyHolder(std::move(resp_.body));
-    auto ext = Napi::External<BodyHolder>::New(env, holder, [](Napi::Env, BodyHolder* p){ delete p; });
-    res.Set("_body", ext);
-
-    res.Set("body", Napi::Buffer<unsigned char>::Copy(env, holder->data.data(), holder->data.size()));
-
-    res.Set("text", Napi::Function::New(env, [](const Napi::CallbackInfo& info){
-      Napi::Env e = info.Env();
-      auto ext = info.This().As<Napi::Object>().Get("_body");
-      if (!ext.IsExternal()) return Napi::String::New(e, "");
-      auto* bh = ext.As<Napi::External<BodyHolder>>().Data();
-      std::string s(bh->data.begin(), bh->data.end());
-      return Napi::String::New(e, s);
-    }));
-
-    res.Set("arrayBuffer", Napi::Function::New(env, [](const Napi::CallbackInfo& info){
-      Napi::Env e = info.Env();
-      auto ext = info.This().As<Napi::Object>().Get("_body");
-      if (!ext.IsExternal()) return Napi::Buffer<unsigned char>::Copy(e, nullptr, 0);
-      auto* bh = ext.As<Napi::External<BodyHolder>>().Data();
-      return Napi::Buffer<unsigned char>::Copy(e, bh->data.data(), bh->data.size());
-    }));
-
-    res.Set("json", Napi::Function::New(env, [](const Napi::CallbackInfo& info){
-      Napi::Env e = info.Env();
-      auto ext = info.This().As<Napi::Object>().Get("_body");
-      if (!ext.IsExternal()) {
-        Napi::TypeError::New(e, "body unavailable").ThrowAsJavaScriptException();
-        return e.Undefined();
-      }
-      auto* bh = ext.As<Napi::External<BodyHolder>>().Data();
-      std::string s(bh->data.begin(), bh->data.end());
-      auto global = e.Global();
-      auto JSON = global.Get("JSON").As<Napi::Object>();
-      auto parse = JSON.Get("parse").As<Napi::Function>();
-      return parse.Call(JSON, { Napi::String::New(e, s) });
-    }));
+    AddonData* data = env.GetInstanceData<AddonData>();
+    res.Set("headers", HeadersWrap::New(data->headers, std::move(resp_.headers)));
+
+    // one external Buffer; the JS wrapper's text()/json()/arrayBuffer() read it in place.
+    // Hits and 304s are copied out of the cache; a stored miss keeps its own chunks.
+    if (cachedBody_) res.Set("body", BlobToBuffer(env, cachedBody_));
+    else res.Set("body", resp_.body.Take().ToBuffer(env));
+    if (!cacheState_.empty()) res.Set("cache", Napi::String::New(env, cacheState_));
+    if (trace_) res.Set("timings", clock_.ToJs(env));
+    if (sink_ && toFile_) {
+      Napi::Object saved = Napi::Object::New(env);
+      saved.Set("path",   Napi::String::New(env, sink_->what()));
+      saved.Set("offset", Napi::Number::New(env, (double)sink_->start()));
+      saved.Set("bytes",  Napi::Number::New(env, (double)sink_->written()));
+      res.Set("saved", saved);
+    }
+    return res;
+  }
 
-    deferred_.Resolve(res);
+private:
+
+  // curl's clocks all run from the start of the transfer; stages are the
+  // gaps between them.
+  void recordTimings(CURL* easy) {
+    curl_off_t dns = 0, conn = 0, tls = 0, pre = 0, first = 0, total = 0, down = 0, up = 0;
+    long connects = 0;
+    curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &conn);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(easy, CURLINFO_PRETRANSFER_TIME_T, &pre);
+    curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &first);
+    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &down);
+    curl_easy_getinfo(easy, CURLINFO_SIZE_UPLOAD_T, &up);
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    auto us = [](curl_off_t v){ return std::chrono::microseconds(std::max<curl_off_t>(0, v)); };
+    if (connects > 0) {
+      clock_.Add(kStageDns, us(dns));
+      clock_.Add(kStageConnect, us(conn - dns));
+      if (tls > 0) clock_.Add(kStageTls, us(tls - conn));   // 0 for plain http
+    }
+    if (first > 0) {
+      clock_.Add(kStageTtfb, us(first - pre));
+      clock_.Add(kStageTransfer, us(total - first));
+    }
+    clock_.Add(kStageTotal, us(total));
+    clock_.Count(kBytesIn, (uint64_t)std::max<curl_off_t>(0, down));
+    clock_.Count(kBytesOut, (uint64_t)std::max<curl_off_t>(0, up));
   }
 
-  void OnError(const Napi::Error& e) override {
-    deferred_.Reject(e.Value());
+  void useCached(const CachedMeta& m, const ResultCache::Blob& body) {
+    resp_.status = m.status;
+    resp_.statusText = m.statusText;
+    resp_.url = m.url;
+    resp_.headers = m.headers;
+    cachedBody_ = body;
   }
 
-  Napi::Function makeAbort(Napi::Env env) {
-    return Napi::Function::New(env, [this](const Napi::CallbackInfo& info){
-      (void)info;
-      abort_.store(true);
-      return info.Env().Undefined();
-    });
+  // I/O thread, after a cache-eligible transfer: serve a 304 from the
+  // stale copy (refreshing its metadata), or store a cacheable response.
+  void updateCache() {
+    int64_t now = nowMs();
+    int64_t freshUntil = 0;
+    bool noCache = false;
+    if (resp_.status == 304 && stale_) {
+      for (auto& kv : resp_.headers)
+        if (kv.first != "content-length" && kv.first != "content-encoding") stale_->headers[kv.first] = kv.second;
+      if (cacheFreshness(stale_->headers, now, freshUntil, noCache)) {
+        stale_->freshUntilMs = freshUntil;
+        stale_->noCache = noCache;
+        httpCache().Put("m:" + cacheKey_, stale_->Serialize(), true);
+      }
+      useCached(*stale_, cachedBody_);
+      cacheState_ = "revalidated";
+      g_httpCache.revalidated.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    cachedBody_.reset();
+    cacheState_ = "miss";
+    g_httpCache.misses.fetch_add(1, std::memory_order_relaxed);
+    if (resp_.status != 200 && resp_.status != 203) return;
+    if (!cacheFreshness(resp_.headers, now, freshUntil, noCache)) return;
+    bool validators = resp_.headers.count("etag") || resp_.headers.count("last-modified");
+    if (freshUntil <= now && !validators) return;   // could never be reused
+
+    CachedMeta m;
+    m.status = resp_.status;
+    m.freshUntilMs = freshUntil;
+    m.noCache = noCache;
+    m.statusText = resp_.statusText;
+    m.url = resp_.url;
+    m.headers = resp_.headers;
+    httpCache().Put("b:" + cacheKey_, resp_.body.CopyBlob(), true);
+    httpCache().Put("m:" + cacheKey_, m.Serialize(), true);
+    g_httpCache.stored.fetch_add(1, std::memory_order_relaxed);
   }
 
-private:
+  static size_t readBodyTramp(char* buffer, size_t size, size_t nitems, void* userdata) {
+    return static_cast<UploadBody*>(userdata)->Read(buffer, size * nitems);
+  }
+  static int seekBodyTramp(void* userdata, curl_off_t offset, int origin) {
+    if (origin != SEEK_SET) return CURL_SEEKFUNC_CANTSEEK;
+    return static_cast<UploadBody*>(userdata)->Seek(offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+  }
   static size_t writeBodyTramp(char* ptr, size_t size, size_t nmemb, void* userdata) {
-    return static_cast<FetchWorker*>(userdata)->writeBody(ptr, size, nmemb);
+    return static_cast<FetchTransfer*>(userdata)->writeBody(ptr, size, nmemb);
   }
   static size_t writeHeaderTramp(char* buffer, size_t size, size_t nitems, void* userdata) {
-    return static_cast<FetchWorker*>(userdata)->writeHeader(buffer, size, nitems);
+    return static_cast<FetchTransfer*>(userdata)->writeHeader(buffer, size, nitems);
   }
   static int xferinfoTramp(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
                            curl_off_t ultotal, curl_off_t ulnow) {
-    return static_cast<FetchWorker*>(clientp)->onProgress(dltotal, dlnow, ultotal, ulnow);
+    return static_cast<FetchTransfer*>(clientp)->onProgress(dltotal, dlnow, ultotal, ulnow);
+  }
+
+  struct DataMsg { FetchTransfer* t; OwnedBuffer buf; size_t size; };
+
+  // Shared with the ack callbacks handed to JS, which can outlive the
+  // transfer. `inflight` counts bytes delivered but not yet consumed.
+  struct StreamCredit {
+    std::atomic<size_t> inflight{0};
+    std::atomic<bool> paused{false};
+  };
+
+  // JS thread: give `n` bytes of credit back once onData's result settles
+  // (immediately unless it returned a thenable).
+  static void AckWhenSettled(Napi::Env env, Napi::Value r, std::shared_ptr<StreamCredit> credit,
+                             FetchEngine* engine, std::shared_ptr<std::atomic<bool>> token, size_t n);
+
+  void noteStaged();
+
+  // First body byte of a saveTo transfer: only a successful response goes
+  // to the file; error pages stay in memory as the usual body.
+  bool routeToFile() {
+    if (sinkChecked_) return toFile_;
+    sinkChecked_ = true;
+    if (resp_.status < 200 || resp_.status >= 300) return toFile_ = false;
+    bool partial = resp_.status == 206;
+    if (rangeStart_ >= 0 && !partial && (rangeStart_ > 0 || rangeEnd_ >= 0)) {
+      error_ = "server ignored the Range request";
+      return toFile_ = false;
+    }
+    if (rangeStart_ < 0 && !partial && sink_->start() > 0 && !sink_->Restart()) {
+      error_ = sink_->error();
+      return toFile_ = false;
+    }
+    return toFile_ = true;
+  }
+
+  // First body byte of a piped transfer, same idea as routeToFile.
+  bool routeToPipe() {
+    if (pipeChecked_) return toPipe_;
+    pipeChecked_ = true;
+    toPipe_ = resp_.status >= 200 && resp_.status < 300;
+    auto it = resp_.headers.find("content-length");
+    if (toPipe_ && it != resp_.headers.end() && !resp_.headers.count("content-encoding"))
+      pipe_->SetSize(std::strtoll(it->second.back().c_str(), nullptr, 10));
+    return toPipe_;
+  }
+
+  // I/O thread, before the result is delivered: end the piped stream.
+  void closePipe() {
+    if (!pipe_) return;
+    if (!error_.empty()) pipe_->Close(error_);
+    else if (resp_.status < 200 || resp_.status >= 300) pipe_->Close("HTTP " + std::to_string(resp_.status));
+    else pipe_->Close("");
   }
 
   size_t writeBody(char* ptr, size_t size, size_t nmemb) {
-    if (abort_.load()) return 0;
+    if (aborted()) return 0;
     size_t n = size * nmemb;
 
-    if (streaming_ && tsfnData_) {
-      auto* chunk = new std::vector<unsigned char>(
-        reinterpret_cast<unsigned char*>(ptr),
-        reinterpret_cast<unsigned char*>(ptr) + n
-      );
-      try {
-        tsfnData_.BlockingCall(chunk, [](Napi::Env env, Napi::Function cb, std::vector<unsigned char>* data){
-          auto buf = Napi::Buffer<unsigned char>::Copy(env, data->data(), data->size());
-          cb.Call({ buf });
-          delete data;
-        });
-      } catch (...) { return 0; }
+    if (pipe_ && routeToPipe()) {
+      switch (pipe_->Write(reinterpret_cast<unsigned char*>(ptr), n)) {
+        case PipeStream::Push::Ok:        downloaded_ += n; return n;
+        case PipeStream::Push::Full:      return CURL_WRITEFUNC_PAUSE;
+        case PipeStream::Push::Cancelled: return 0;
+      }
+    }
+
+    if (sink_) {
+      if (routeToFile()) {
+        if (!sink_->Write(reinterpret_cast<unsigned char*>(ptr), n)) return 0;
+        downloaded_ += n;
+        return n;
+      }
+      if (!error_.empty()) return 0;
+    }
+
+    if (streaming_) {
+      // two batches unconsumed: stop reading until JS catches up; curl
+      // keeps this chunk and hands it back after curl_easy_pause(CONT)
+      if (stream_->inflight.load() >= 2 * highWaterMark_) {
+        stream_->paused.store(true);
+        if (stream_->inflight.load() >= 2 * highWaterMark_) return CURL_WRITEFUNC_PAUSE;
+        stream_->paused.store(false);
+      }
+      if (staged_.size() == 0) staged_.Reserve(highWaterMark_);
+      if (!staged_.Append(reinterpret_cast<unsigned char*>(ptr), n)) return 0;
       downloaded_ += n;
+      if (staged_.size() >= highWaterMark_) FlushData();
+      else noteStaged();
       return n;
     }
 
     if (maxBodySize_ >= 0 && static_cast<long long>(resp_.body.size() + n) > maxBodySize_) {
       return 0;
     }
-    try {
-      auto begin = reinterpret_cast<unsigned char*>(ptr);
-      resp_.body.insert(resp_.body.end(), begin, begin + n);
-      downloaded_ += n;
-    } catch (...) { return 0; }
+    if (resp_.body.size() == 0) resp_.body.Reserve(contentLengthHint());
+    if (!resp_.body.Append(reinterpret_cast<unsigned char*>(ptr), n)) return 0;
+    downloaded_ += n;
     return n;
   }
 
+  // Content-Length of the final hop, capped by maxBodySize; 0 if unknown.
+  size_t contentLengthHint() const {
+    auto it = resp_.headers.find("content-length");
+    if (it == resp_.headers.end() || it->second.empty()) return 0;
+    char* end = nullptr;
+    unsigned long long n = std::strtoull(it->second.back().c_str(), &end, 10);
+    if (end == it->second.back().c_str()) return 0;
+    if (maxBodySize_ >= 0 && n > (unsigned long long)maxBodySize_) n = (unsigned long long)maxBodySize_;
+    return (size_t)std::min<unsigned long long>(n, 256ull << 20);  // chunks take the rest
+  }
+
   size_t writeHeader(char* buffer, size_t size, size_t nitems) {
     size_t n = size * nitems;
     resp_.addHeaderLine(buffer, n);
@@ -570,21 +1590,24 @@ private:
   }
 
   int onProgress(curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
-    if (abort_.load()) return 1;
-    if (wantProgress_ && tsfnProg_) {
-      struct Agg { double dn, dt, un, ut; };
-      auto* agg = new Agg{ (double)dlnow, (double)dltotal, (double)ulnow, (double)ultotal };
-      try {
-        tsfnProg_.NonBlockingCall(agg, [](Napi::Env env, Napi::Function cb, Agg* a){
-          Napi::Object o = Napi::Object::New(env);
-          o.Set("downloaded", Napi::Number::New(env, a->dn));
-          o.Set("total",      Napi::Number::New(env, a->dt));
-          o.Set("uploaded",   Napi::Number::New(env, a->un));
-          o.Set("utotal",     Napi::Number::New(env, a->ut));
-          cb.Call({ o });
-          delete a;
-        });
-      } catch (...) {}
+    if (aborted()) return 1;
+    if (wantProgress_) {
+      // curl calls this often even when nothing moved; only report changes
+      if (dlnow == lastDl_ && ulnow == lastUl_ && dltotal == lastDlTotal_ && ultotal == lastUlTotal_) return 0;
+      lastDl_ = dlnow; lastUl_ = ulnow; lastDlTotal_ = dltotal; lastUlTotal_ = ultotal;
+      struct Agg { FetchTransfer* t; double dn, dt, un, ut; };
+      auto* agg = new Agg{ this, (double)dlnow, (double)dltotal, (double)ulnow, (double)ultotal };
+      napi_status st = tsfn_.NonBlockingCall(agg, [](Napi::Env env, Napi::Function, Agg* a){
+        Napi::HandleScope scope(env);
+        Napi::Object o = Napi::Object::New(env);
+        o.Set("downloaded", Napi::Number::New(env, a->dn));
+        o.Set("total",      Napi::Number::New(env, a->dt));
+        o.Set("uploaded",   Napi::Number::New(env, a->un));
+        o.Set("utotal",     Napi::Number::New(env, a->ut));
+        a->t->onProgress_.Call({ o });
+        delete a;
+      });
+      if (st != napi_ok) delete agg;
     }
     return 0;
   }
@@ -607,8 +1630,11 @@ private:
   }
 
 private:
-  Napi::Promise::Deferred deferred_;
+  std::optional<Napi::Promise::Deferred> deferred_;
+  FetchBatch* batch_;
+  size_t index_;
   std::string url_;
+  std::string host_;
 
   std::string method_;
   int         timeoutMs_;
@@ -619,54 +1645,690 @@ private:
   std::string cookieFile_;
   std::string cookieString_;
   long long   maxBodySize_{-1};
+  bool        trace_ = false;
+  StageClock  clock_{ fetchMetrics() };
 
   bool haveUserUA_ = false, haveAcceptEnc_ = false, haveConn_ = false, haveExpect_ = false, haveContentType_ = false;
+  bool haveCredentials_ = false;
 
   bool streaming_ = false;
+  size_t highWaterMark_ = 0;
+  BodyBuffer staged_;
+  std::chrono::steady_clock::time_point stagedSince_{};
+  std::shared_ptr<StreamCredit> stream_;
+  FetchEngine* engine_ = nullptr;
   bool wantProgress_ = false;
 
   std::vector<std::string> headersKVs_;
-  std::vector<unsigned char> body_;
-
+  std::unique_ptr<UploadBody> upload_;
+  std::unique_ptr<FileSink> sink_;
+  std::unique_ptr<PipeStream, PipeStream::Unref> pipe_;
+  bool pipeChecked_ = false, toPipe_ = false;
+  int64_t rangeStart_ = -1, rangeEnd_ = -1;
+  std::string cacheMode_;
+  std::string cacheKey_;      // empty = cache not used
+  std::string cacheState_;    // "hit" | "revalidated" | "miss"
+  std::unique_ptr<CachedMeta> stale_;
+  ResultCache::Blob cachedBody_;
+  bool sinkChecked_ = false, toFile_ = false;
   bool useMultipart_ = false;
-  std::vector<unsigned char> multipartBody_;
   std::string multipartBoundary_;
 
+  SList hdrs_;
   ResponseData resp_;
-  std::atomic<bool> abort_{false};
+  std::shared_ptr<std::atomic<bool>> abort_;
+  std::string error_;
   size_t downloaded_ = 0;
+  curl_off_t lastDl_ = -1, lastUl_ = -1, lastDlTotal_ = -1, lastUlTotal_ = -1;
 
-  Napi::ThreadSafeFunction tsfnData_;
-  Napi::ThreadSafeFunction tsfnProg_;
+  Napi::ThreadSafeFunction tsfn_;
+  Napi::FunctionReference onData_;
+  Napi::FunctionReference onProgress_;
 };
 
-Napi::Value StartFetch(const Napi::CallbackInfo& info) {
-  Napi::Env env = info.Env();
-  if (info.Length() < 1 || !info[0].IsString()) {
-    Napi::TypeError::New(env, "startFetch(url, [options]) requires url string").ThrowAsJavaScriptException();
-    return env.Null();
+// One curl_multi handle driven by a dedicated I/O thread. Transfers run on
+// it, so concurrency is bounded by sockets rather than by the libuv
+// threadpool, and requests to one host share the multi handle's connection
+// cache (multiplexed over one HTTP/2 connection where the server allows).
+// JS only talks to it through Submit/Abort/Reconfigure, which queue work and
+// wake the thread.
+class FetchEngine {
+public:
+  struct Stats { size_t running, queued; uint64_t submitted, completed, aborted; };
+
+  void Submit(FetchTransfer* t) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      pending_.push_back(t);
+      ++submitted_;
+      startLocked();
+    }
+    wake();
+  }
+
+  void Abort(const std::shared_ptr<std::atomic<bool>>& token) {
+    token->store(true);
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (!multi_) return;
+      aborts_.push_back(token);
+    }
+    wake();
+  }
+
+  // Any thread: a paused streaming transfer got credit back.
+  void Resume(const std::shared_ptr<std::atomic<bool>>& token) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (!multi_) return;
+      resumes_.push_back(token);
+    }
+    wake();
+  }
+
+  // I/O thread: `t` has onData bytes staged below the high-water mark.
+  void MarkDirty(FetchTransfer* t) {
+    if (std::find(dirty_.begin(), dirty_.end(), t) == dirty_.end()) dirty_.push_back(t);
+  }
+
+  // Re-read ConnPool options on the I/O thread.
+  void Reconfigure() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      reconfigure_ = true;
+    }
+    wake();
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return Stats{ running_, pending_.size(), submitted_, completed_, aborted_ };
+  }
+
+  // Environment teardown: stop the thread and drop whatever is in flight.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (!thread_.joinable()) return;
+      stop_ = true;
+    }
+    wake();
+    thread_.join();
+
+    // the loop has exited, so nothing else touches multi_ or live_; JS can no
+    // longer be called, so in-flight transfers are dropped without settling
+    for (auto& kv : live_) {
+      curl_multi_remove_handle(multi_, kv.second.easy);
+      connPool().Release(kv.second.t->host(), kv.second.easy, false);
+      kv.second.t->Abandon();
+    }
+    live_.clear();
+    std::lock_guard<std::mutex> lk(mu_);
+    for (FetchTransfer* t : pending_) t->Abandon();
+    pending_.clear();
+    aborts_.clear();
+    resumes_.clear();
+    dirty_.clear();
+    running_ = 0;
+    curl_multi_cleanup(multi_);
+    multi_ = nullptr;
   }
 
+private:
+  void startLocked() {
+    if (thread_.joinable()) return;
+    ensureCurlGlobal();
+    initShare();
+    multi_ = curl_multi_init();
+    if (!multi_) throw std::runtime_error("curl_multi_init failed");
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    applyOptions();
+    stop_ = false;
+    thread_ = std::thread([this]{ loop(); });
+  }
+
+  void wake() {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (multi_) curl_multi_wakeup(multi_);
+  }
+
+  void applyOptions() {
+    ConnPool::Options o = connPool().GetOptions();
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, o.maxPerHost);
+  }
+
+  void loop() {
+    std::vector<FetchTransfer*> adds;
+    std::vector<std::shared_ptr<std::atomic<bool>>> aborts, resumes;
+    while (true) {
+      bool reconf = false;
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (stop_) break;
+        adds.assign(pending_.begin(), pending_.end());
+        pending_.clear();
+        aborts.swap(aborts_);
+        resumes.swap(resumes_);
+        reconf = reconfigure_;
+        reconfigure_ = false;
+      }
+      if (reconf) applyOptions();
+
+      for (FetchTransfer* t : adds) add(t);
+      adds.clear();
+      for (auto& tok : aborts) {
+        auto it = live_.find(tok.get());
+        if (it != live_.end()) finish(it->second.t, CURLE_ABORTED_BY_CALLBACK);
+      }
+      aborts.clear();
+      for (auto& tok : resumes) {
+        auto it = live_.find(tok.get());
+        if (it != live_.end()) curl_easy_pause(it->second.easy, CURLPAUSE_CONT);
+      }
+      resumes.clear();
+
+      int running = 0;
+      curl_multi_perform(multi_, &running);
+      int left = 0;
+      while (CURLMsg* m = curl_multi_info_read(multi_, &left)) {
+        if (m->msg != CURLMSG_DONE) continue;
+        void* priv = nullptr;
+        curl_easy_getinfo(m->easy_handle, CURLINFO_PRIVATE, &priv);
+        if (priv) finish(static_cast<FetchTransfer*>(priv), m->data.result);
+      }
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        running_ = live_.size();
+      }
+      // small onData batches go out once the sockets go quiet, or after
+      // kFlushMs at the latest, so slow streams are not held back
+      int nfds = 0;
+      curl_multi_poll(multi_, nullptr, 0, dirty_.empty() ? 1000 : kFlushMs, &nfds);
+      if (!dirty_.empty()) flushDirty(nfds == 0);
+    }
+  }
+
+  void flushDirty(bool idle) {
+    auto now = std::chrono::steady_clock::now();
+    size_t keep = 0;
+    for (FetchTransfer* t : dirty_) {
+      if (!t->HasStaged()) continue;
+      if (idle || now - t->StagedSince() >= std::chrono::milliseconds(kFlushMs)) t->FlushData();
+      else dirty_[keep++] = t;
+    }
+    dirty_.resize(keep);
+  }
+
+  void add(FetchTransfer* t) {
+    if (t->aborted()) {
+      t->Complete(nullptr, CURLE_ABORTED_BY_CALLBACK);
+      t->Deliver();
+      return;
+    }
+    if (t->ServeFromCache()) {
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        ++completed_;
+      }
+      t->Deliver();
+      return;
+    }
+    CURL* easy = nullptr;
+    try {
+      easy = connPool().Acquire(t->host());
+      t->Setup(easy);
+    } catch (const std::exception& e) {
+      if (easy) connPool().Release(t->host(), easy, false);
+      t->Fail(e.what());
+      t->Deliver();
+      return;
+    }
+    live_[t->token().get()] = Live{ t, easy };
+    CURLMcode mc = curl_multi_add_handle(multi_, easy);
+    if (mc != CURLM_OK) {
+      live_.erase(t->token().get());
+      connPool().Release(t->host(), easy, false);
+      t->Fail(std::string("curl_multi_add_handle failed: ") + curl_multi_strerror(mc));
+      t->Deliver();
+    }
+  }
+
+  void finish(FetchTransfer* t, CURLcode rc) {
+    auto it = live_.find(t->token().get());
+    if (it == live_.end()) return;
+    CURL* easy = it->second.easy;
+    live_.erase(it);
+    curl_multi_remove_handle(multi_, easy);
+    dirty_.erase(std::remove(dirty_.begin(), dirty_.end(), t), dirty_.end());
+    t->Complete(easy, rc);
+    if (t->ok()) t->FlushData();
+    bool aborted = t->aborted();
+    connPool().Release(t->host(), easy, !aborted);
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      ++completed_;
+      if (aborted) ++aborted_;
+    }
+    t->Deliver();
+  }
+
+  struct Live { FetchTransfer* t; CURL* easy; };
+  static constexpr int kFlushMs = 10;
+
+  std::mutex mu_;
+  std::thread thread_;
+  CURLM* multi_ = nullptr;
+  bool stop_ = false;
+  bool reconfigure_ = false;
+  std::deque<FetchTransfer*> pending_;
+  std::vector<std::shared_ptr<std::atomic<bool>>> aborts_;
+  std::vector<std::shared_ptr<std::atomic<bool>>> resumes_;
+  std::vector<FetchTransfer*> dirty_;                    // I/O thread only
+  std::unordered_map<std::atomic<bool>*, Live> live_;   // I/O thread only
+  size_t running_ = 0;
+  uint64_t submitted_ = 0, completed_ = 0, aborted_ = 0;
+};
+
+// `ioThreads` engines. A host always maps to the same engine so its
+// connections stay in one multi handle; the curl share (DNS, cookies, TLS
+// sessions) is common to all of them. Shrinking the count only stops
+// routing to the extra engines, which finish what they have and idle.
+class EngineSet {
+public:
+  static constexpr size_t kMax = 16;
+
+  FetchEngine& For(const std::string& host) {
+    size_t n = threads_.load(std::memory_order_relaxed);
+    return engines_[n > 1 ? std::hash<std::string>()(host) % n : 0];
+  }
+
+  void SetThreads(size_t n) { threads_.store(std::min(kMax, std::max<size_t>(1, n))); }
+  size_t Threads() const { return threads_.load(); }
+
+  void Reconfigure() { for (auto& e : engines_) e.Reconfigure(); }
+
+  FetchEngine::Stats GetStats() {
+    FetchEngine::Stats t{0, 0, 0, 0, 0};
+    for (auto& e : engines_) {
+      FetchEngine::Stats s = e.GetStats();
+      t.running += s.running; t.queued += s.queued;
+      t.submitted += s.submitted; t.completed += s.completed; t.aborted += s.aborted;
+    }
+    return t;
+  }
+
+  void Stop() { for (auto& e : engines_) e.Stop(); }
+
+private:
+  FetchEngine engines_[kMax];
+  std::atomic<size_t> threads_{1};
+};
+
+static EngineSet& engines() {
+  static EngineSet* e = new EngineSet();
+  return *e;
+}
+
+Napi::Function FetchTransfer::makeAbort(Napi::Env env) {
+  auto token = abort_;
+  FetchEngine* engine = engine_;
+  return Napi::Function::New(env, [token, engine](const Napi::CallbackInfo& info){
+    engine->Abort(token);
+    return info.Env().Undefined();
+  });
+}
+
+Napi::Value FetchTransfer::OpenPipe(Napi::Env env, size_t capacity) {
+  if (sink_ || streaming_ || batch_) throw std::runtime_error("fetchSource cannot be combined with saveTo or onData");
+  pipe_.reset(new PipeStream(capacity));
+  cacheKey_.clear();
+  FetchEngine* engine = engine_;
+  auto token = abort_;
+  pipe_->onDrain  = [engine, token](){ engine->Resume(token); };
+  pipe_->onCancel = [engine, token](){ engine->Abort(token); };
+  return WrapByteStream(env, pipe_.get());
+}
+
+void FetchTransfer::noteStaged() {
+  if (stagedSince_ == std::chrono::steady_clock::time_point{}) stagedSince_ = std::chrono::steady_clock::now();
+  engine_->MarkDirty(this);
+}
+
+void FetchTransfer::AckWhenSettled(Napi::Env env, Napi::Value r, std::shared_ptr<StreamCredit> credit,
+                                   FetchEngine* engine, std::shared_ptr<std::atomic<bool>> token, size_t n) {
+  auto ack = [credit, engine, token, n](){
+    credit->inflight.fetch_sub(n);
+    if (credit->paused.exchange(false)) engine->Resume(token);
+  };
+  if (r.IsObject()) {
+    Napi::Value then = r.As<Napi::Object>().Get("then");
+    if (then.IsFunction()) {
+      auto settle = Napi::Function::New(env, [ack](const Napi::CallbackInfo& info){
+        ack();
+        return info.Env().Undefined();
+      });
+      then.As<Napi::Function>().Call(r, { settle, settle });
+      return;
+    }
+  }
+  ack();
+}
+
+// fetchMany: many transfers behind one promise and one ThreadSafeFunction.
+// Members are fed to the engines `concurrency` at a time (at most
+// `perHostLimit` per host) and finished ones are queued; the JS thread
+// picks up whatever has accumulated in a single call, so a burst of
+// completions costs one trip instead of one per request.
+class FetchBatch {
+public:
+  struct Options { size_t concurrency = 64; size_t perHostLimit = 0; };  // 0 = unlimited
+
+  FetchBatch(Napi::Env env, Napi::Promise::Deferred def, Options o, Napi::Value onResult)
+  : deferred_(def), opts_(o) {
+    if (onResult.IsFunction()) onResult_ = Napi::Persistent(onResult.As<Napi::Function>());
+    else results_ = Napi::Persistent(Napi::Array::New(env));
+    tsfn_ = Napi::ThreadSafeFunction::New(env,
+      Napi::Function::New(env, [](const Napi::CallbackInfo&){}), "fetch:batch", 0, 1);
+  }
+
+  // JS thread, before Start().
+  void Add(FetchTransfer* t, FetchEngine* e) {
+    Host& h = hosts_[bucket(t)];
+    h.queued.push_back(Member{ t, e });
+    markReady(h);
+    ++total_;
+  }
+
+  // JS thread: construction of a member failed; nothing was submitted.
+  void Discard() {
+    for (auto& h : hosts_) for (auto& m : h.second.queued) delete m.t;
+    tsfn_.Release();
+    delete this;
+  }
+
+  void Start() {
+    if (total_ == 0) {
+      tsfn_.Release();
+      deferred_.Resolve(results_.IsEmpty() ? Napi::Array::New(deferred_.Env()) : results_.Value());
+      delete this;
+      return;
+    }
+    pump();
+  }
+
+  // JS thread: abort every member, running or not.
+  Napi::Function MakeAbort(Napi::Env env) {
+    std::vector<std::pair<std::shared_ptr<std::atomic<bool>>, FetchEngine*>> all;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      for (auto& h : hosts_) for (auto& m : h.second.queued) all.emplace_back(m.t->token(), m.engine);
+      for (auto& r : running_) all.emplace_back(r.first, r.second);
+    }
+    auto tokens = std::make_shared<decltype(all)>(std::move(all));
+    return Napi::Function::New(env, [tokens](const Napi::CallbackInfo& info){
+      for (auto& p : *tokens) p.second->Abort(p.first);
+      return info.Env().Undefined();
+    });
+  }
+
+  // I/O thread: a member finished (its response is built on the JS thread).
+  // Its slot is refilled before it is published: once it is in done_, a
+  // flush already queued may finish the batch and delete it, so `this` is
+  // only touched again by the thread that queues the next flush.
+  void Done(FetchTransfer* t) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      running_.erase(t->token());
+      auto h = hosts_.find(bucket(t));
+      if (h != hosts_.end()) {
+        --h->second.active;
+        markReady(h->second);
+      }
+    }
+    pump();
+    bool schedule = false;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      done_.push_back(t);
+      if (!flushQueued_) { flushQueued_ = true; schedule = true; }
+    }
+    if (schedule) {
+      napi_status st = tsfn_.NonBlockingCall(this, [](Napi::Env env, Napi::Function, FetchBatch* b){
+        b->flush(env);
+      });
+      (void)st;
+    }
+  }
+
+private:
+  struct Member { FetchTransfer* t; FetchEngine* engine; };
+
+  // Members waiting for a slot, per host (one bucket without perHostLimit).
+  struct Host {
+    std::deque<Member> queued;
+    size_t active = 0;
+    bool ready = false;   // listed in ready_
+  };
+
+  const std::string& bucket(FetchTransfer* t) const {
+    static const std::string all;
+    return opts_.perHostLimit ? t->host() : all;
+  }
+
+  bool canStart(const Host& h) const {
+    return !h.queued.empty() && (!opts_.perHostLimit || h.active < opts_.perHostLimit);
+  }
+
+  // Under mu_ (or before Start): list `h` once it can take another member.
+  void markReady(Host& h) {
+    if (h.ready || !canStart(h)) return;
+    h.ready = true;
+    ready_.push_back(&h);
+  }
+
+  // Any thread: submit queued members while there is room. Only hosts
+  // that can start a member are visited, so a refill costs O(1) however
+  // many members wait on saturated hosts.
+  void pump() {
+    std::vector<Member> go;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      while (!ready_.empty() && !(opts_.concurrency && running_.size() >= opts_.concurrency)) {
+        Host& h = *ready_.front();
+        Member m = h.queued.front();
+        h.queued.pop_front();
+        ++h.active;
+        running_[m.t->token()] = m.engine;
+        go.push_back(m);
+        if (!canStart(h)) { h.ready = false; ready_.pop_front(); }
+      }
+    }
+    for (auto& m : go) m.engine->Submit(m.t);
+  }
+
+  // JS thread.
+  void flush(Napi::Env env) {
+    Napi::HandleScope scope(env);
+    std::vector<FetchTransfer*> done;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      done.swap(done_);
+      flushQueued_ = false;
+    }
+    Napi::Array group = Napi::Array::New(env, done.size());
+    uint32_t gi = 0;
+    for (FetchTransfer* t : done) {
+      Napi::Value v = t->error().empty()
+        ? (Napi::Value)t->BuildResponse(env)
+        : Napi::Error::New(env, t->error()).Value();
+      if (onResult_.IsEmpty()) {
+        results_.Value().Set((uint32_t)t->index(), v);
+      } else {
+        Napi::Object item = Napi::Object::New(env);
+        item.Set("index", Napi::Number::New(env, (double)t->index()));
+        item.Set(t->error().empty() ? "response" : "error", v);
+        group.Set(gi++, item);
+      }
+      delete t;
+    }
+    finished_ += done.size();
+    if (!onResult_.IsEmpty() && gi) onResult_.Call({ group });
+    if (finished_ == total_) {
+      if (onResult_.IsEmpty()) deferred_.Resolve(results_.Value());
+      else deferred_.Resolve(Napi::Number::New(env, (double)total_));
+      tsfn_.Release();
+      delete this;
+    }
+  }
+
+  Napi::Promise::Deferred deferred_;
+  Options opts_;
+  Napi::ThreadSafeFunction tsfn_;
+  Napi::FunctionReference onResult_;
+  Napi::Reference<Napi::Array> results_;
+
+  std::mutex mu_;
+  std::unordered_map<std::string, Host> hosts_;   // nodes are stable, so ready_ can point into it
+  std::deque<Host*> ready_;
+  std::map<std::shared_ptr<std::atomic<bool>>, FetchEngine*> running_;
+  std::vector<FetchTransfer*> done_;
+  bool flushQueued_ = false;
+  size_t total_ = 0;
+  size_t finished_ = 0;   // JS thread only
+};
+
+void FetchTransfer::Deliver() {
+  closePipe();
+  if (batch_) batch_->Done(this);
+  else deliverSelf();
+}
+
+static void ensureCleanupHook(Napi::Env env) {
   ensureCurlGlobal();
   static std::once_flag onceCleanup;
   std::call_once(onceCleanup, [&](){
     env.AddCleanupHook([](){
+      engines().Stop();
+      connPool().Clear();
       cleanupShare();
       curl_global_cleanup();
     });
   });
+}
+
+Napi::Value FetchMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::TypeError::New(env, "fetchMany(requests, [options]) requires an array").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  ensureCleanupHook(env);
+
+  Napi::Array reqs = info[0].As<Napi::Array>();
+  Napi::Object o = (info.Length() >= 2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+  FetchBatch::Options bo;
+  if (o.Has("concurrency"))  bo.concurrency  = (size_t)std::max<int64_t>(0, o.Get("concurrency").ToNumber().Int64Value());
+  if (o.Has("perHostLimit")) bo.perHostLimit = (size_t)std::max<int64_t>(0, o.Get("perHostLimit").ToNumber().Int64Value());
+
+  // Validate everything before anything is allocated.
+  std::vector<std::pair<std::string, Napi::Object>> items;
+  items.reserve(reqs.Length());
+  Napi::Object empty = Napi::Object::New(env);
+  for (uint32_t i = 0; i < reqs.Length(); ++i) {
+    Napi::Value r = reqs.Get(i);
+    if (r.IsString()) {
+      items.emplace_back(r.As<Napi::String>().Utf8Value(), empty);
+    } else if (r.IsObject() && r.As<Napi::Object>().Get("url").IsString()) {
+      Napi::Object ro = r.As<Napi::Object>();
+      items.emplace_back(ro.Get("url").As<Napi::String>().Utf8Value(), ro);
+    } else {
+      Napi::TypeError::New(env, "fetchMany: each request must be a URL or { url, ...options }").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+
+  auto deferred = Napi::Promise::Deferred::New(env);
+  auto* batch = new FetchBatch(env, deferred, bo, o.Get("onResult"));
+  try {
+    for (size_t i = 0; i < items.size(); ++i) {
+      auto* t = new FetchTransfer(env, std::move(items[i].first), items[i].second, std::nullopt, batch, i);
+      FetchEngine& eng = engines().For(t->host());
+      t->Bind(&eng);
+      batch->Add(t, &eng);
+    }
+  } catch (...) {
+    batch->Discard();
+    throw;
+  }
+  Napi::Function abortFn = batch->MakeAbort(env);
+  batch->Start();
+
+  Napi::Object ret = Napi::Object::New(env);
+  ret.Set("promise", deferred.Promise());
+  ret.Set("abort", abortFn);
+  return ret;
+}
+
+Napi::Value StartFetch(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "startFetch(url, [options]) requires url string").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  ensureCleanupHook(env);
+
+  std::string url = info[0].As<Napi::String>().Utf8Value();
+  Napi::Object opts = (info.Length() >= 2 && info[1].IsObject())
+                        ? info[1].As<Napi::Object>()
+                        : Napi::Object::New(env);
+
+  auto deferred = Napi::Promise::Deferred::New(env);
+  auto* transfer = new FetchTransfer(env, std::move(url), opts, deferred);
+  FetchEngine& eng = engines().For(transfer->host());
+  transfer->Bind(&eng);
+  Napi::Function abortFn = transfer->makeAbort(env);
+  eng.Submit(transfer);
+
+  Napi::Object ret = Napi::Object::New(env);
+  ret.Set("promise", deferred.Promise());
+  ret.Set("abort", abortFn);
+  return ret;
+}
+
+// The body as a ByteStream for sticker()/convert(), which decode it while
+// it downloads; JS only ever holds the opaque handle.
+Napi::Value FetchSource(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "fetchSource(url, [options]) requires url string").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  ensureCleanupHook(env);
 
   std::string url = info[0].As<Napi::String>().Utf8Value();
   Napi::Object opts = (info.Length() >= 2 && info[1].IsObject())
                         ? info[1].As<Napi::Object>()
                         : Napi::Object::New(env);
+  int64_t hwm = opts.Has("highWaterMark") ? opts.Get("highWaterMark").ToNumber().Int64Value() : 1024 * 1024;
 
   auto deferred = Napi::Promise::Deferred::New(env);
-  auto* worker = new FetchWorker(env, std::move(url), opts, deferred);
-  Napi::Function abortFn = worker->makeAbort(env);
-  worker->Queue();
+  auto* transfer = new FetchTransfer(env, std::move(url), opts, deferred);
+  FetchEngine& eng = engines().For(transfer->host());
+  transfer->Bind(&eng);
+  Napi::Value source;
+  try {
+    source = transfer->OpenPipe(env, (size_t)std::max<int64_t>(64 * 1024, hwm));
+  } catch (...) {
+    transfer->Abandon();
+    throw;
+  }
+  Napi::Function abortFn = transfer->makeAbort(env);
+  eng.Submit(transfer);
 
   Napi::Object ret = Napi::Object::New(env);
+  ret.Set("source", source);
   ret.Set("promise", deferred.Promise());
   ret.Set("abort", abortFn);
   return ret;
@@ -677,16 +2339,102 @@ Napi::Value Fetch(const Napi::CallbackInfo& info) {
   return o.Get("promise");
 }
 
+Napi::Value Configure(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  ConnPool::Options o = connPool().GetOptions();
+  if (info.Length() >= 1 && info[0].IsObject()) {
+    Napi::Object opts = info[0].As<Napi::Object>();
+    if (opts.Has("maxPerHost"))  o.maxPerHost    = std::max<long>(0, (long)opts.Get("maxPerHost").ToNumber().Int64Value());
+    if (opts.Has("idleTimeout")) o.idleTimeoutMs = std::max<long>(0, (long)opts.Get("idleTimeout").ToNumber().Int64Value());
+    if (opts.Has("ioThreads"))   engines().SetThreads((size_t)std::max<int64_t>(1, opts.Get("ioThreads").ToNumber().Int64Value()));
+    if (opts.Has("cache") && opts.Get("cache").IsObject())
+      httpCache().Configure(ParseCacheOptions(opts.Get("cache").As<Napi::Object>(), httpCache().GetOptions()));
+    connPool().Configure(o);
+    engines().Reconfigure();
+  }
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("maxPerHost",  Napi::Number::New(env, (double)o.maxPerHost));
+  r.Set("idleTimeout", Napi::Number::New(env, (double)o.idleTimeoutMs));
+  r.Set("ioThreads",   Napi::Number::New(env, (double)engines().Threads()));
+  r.Set("cache",       CacheOptionsToJs(env, httpCache().GetOptions()));
+  return r;
+}
+
+static Napi::Object ShareStatsToJs(Napi::Env env) {
+  static const struct { curl_lock_data data; const char* name; } kinds[] = {
+    { CURL_LOCK_DATA_DNS, "dns" },
+    { CURL_LOCK_DATA_COOKIE, "cookie" },
+    { CURL_LOCK_DATA_SSL_SESSION, "sslSession" },
+    { CURL_LOCK_DATA_SHARE, "share" },
+  };
+  Napi::Object r = Napi::Object::New(env);
+  for (const auto& k : kinds) {
+    Napi::Object o = Napi::Object::New(env);
+    o.Set("locks",     Napi::Number::New(env, (double)g_shareLocks.locks[k.data].load()));
+    o.Set("contended", Napi::Number::New(env, (double)g_shareLocks.contended[k.data].load()));
+    r.Set(k.name, o);
+  }
+  return r;
+}
+
+Napi::Value Stats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  ConnPool::Stats s = connPool().GetStats();
+  uint64_t finished = s.reusedConnections + s.newConnections;
+  Napi::Object c = Napi::Object::New(env);
+  c.Set("requests",          Napi::Number::New(env, (double)s.requests));
+  c.Set("reusedConnections", Napi::Number::New(env, (double)s.reusedConnections));
+  c.Set("newConnections",    Napi::Number::New(env, (double)s.newConnections));
+  c.Set("reuseRate",         Napi::Number::New(env, finished ? (double)s.reusedConnections / (double)finished : 0.0));
+  c.Set("handleReuses",      Napi::Number::New(env, (double)s.handleReuses));
+  c.Set("idleHandles",       Napi::Number::New(env, (double)s.idleHandles));
+  c.Set("active",            Napi::Number::New(env, (double)s.active));
+  c.Set("hosts",             Napi::Number::New(env, (double)s.hosts));
+  FetchEngine::Stats es = engines().GetStats();
+  Napi::Object t = Napi::Object::New(env);
+  t.Set("running",   Napi::Number::New(env, (double)es.running));
+  t.Set("queued",    Napi::Number::New(env, (double)es.queued));
+  t.Set("submitted", Napi::Number::New(env, (double)es.submitted));
+  t.Set("completed", Napi::Number::New(env, (double)es.completed));
+  t.Set("aborted",   Napi::Number::New(env, (double)es.aborted));
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("connections", c);
+  r.Set("transfers", t);
+  r.Set("share", ShareStatsToJs(env));
+  Napi::Object hc = Napi::Object::New(env);
+  hc.Set("hits",        Napi::Number::New(env, (double)g_httpCache.hits.load()));
+  hc.Set("revalidated", Napi::Number::New(env, (double)g_httpCache.revalidated.load()));
+  hc.Set("misses",      Napi::Number::New(env, (double)g_httpCache.misses.load()));
+  hc.Set("stored",      Napi::Number::New(env, (double)g_httpCache.stored.load()));
+  hc.Set("storage",     CacheStatsToJs(env, httpCache().GetStats()));
+  r.Set("cache", hc);
+  Napi::Object mem = Napi::Object::New(env);
+  mem.Set("peakRss", Napi::Number::New(env, PeakRssBytes()));
+  r.Set("memory", mem);
+  r.Set("stages", fetchMetrics().StagesToJs(env));
+  r.Set("counters", fetchMetrics().CountersToJs(env));
+  return r;
+}
+
 } // jawa jawa jawa
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
   ensureCurlGlobal();
+  auto* data = new AddonData();
+  HeadersWrap::Init(env, data->headers);
+  env.SetInstanceData(data);
   env.AddCleanupHook([](){
+    engines().Stop();
+    connPool().Clear();
     cleanupShare();
     curl_global_cleanup();
   });
   exports.Set("startFetch", Napi::Function::New(env, StartFetch));
   exports.Set("fetch",      Napi::Function::New(env, Fetch));
+  exports.Set("fetchMany",  Napi::Function::New(env, FetchMany));
+  exports.Set("fetchSource",Napi::Function::New(env, FetchSource));
+  exports.Set("configure",  Napi::Function::New(env, Configure));
+  exports.Set("stats",      Napi::Function::New(env, Stats));
   return exports;
 }
 
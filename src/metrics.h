@@ -0,0 +1,220 @@
+#pragma once
+#include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+// Per-stage latency histograms and plain counters behind stats(). A writer
+// only touches a block owned by its own thread, with relaxed loads and
+// stores (no locked instructions, no shared cache lines), so recording is a
+// handful of plain adds and costs nothing more when nobody reads it.
+// stats() sums the live blocks under a lock that writers never take; a
+// thread's block is folded into a retired total when the thread exits.
+//
+// Histograms are log2 buckets of microseconds, so percentiles are reported
+// as the upper edge of their bucket (within 2x), capped at the maximum.
+// Instances must outlive every thread that records into them; the addons
+// keep theirs for the life of the process.
+class Metrics {
+public:
+  static constexpr size_t kMaxStages = 8, kMaxCounters = 8, kBuckets = 32;
+
+  Metrics(std::vector<const char*> stages, std::vector<const char*> counters)
+  : stages_(std::move(stages)), counters_(std::move(counters)) {
+    if (stages_.size() > kMaxStages) stages_.resize(kMaxStages);
+    if (counters_.size() > kMaxCounters) counters_.resize(kMaxCounters);
+  }
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  size_t StageCount() const { return stages_.size(); }
+  const char* StageName(size_t i) const { return stages_[i]; }
+
+  void Record(size_t stage, uint64_t us) {
+    if (stage >= stages_.size()) return;
+    Block& b = local();
+    bump(b.count[stage], 1);
+    bump(b.sumUs[stage], us);
+    bump(b.hist[stage][bucket(us)], 1);
+    if (us > b.maxUs[stage].load(std::memory_order_relaxed)) b.maxUs[stage].store(us, std::memory_order_relaxed);
+  }
+
+  void Add(size_t counter, uint64_t n) {
+    if (counter >= counters_.size()) return;
+    bump(local().counters[counter], n);
+  }
+
+  // { <stage>: { count, totalMs, meanMs, p50Ms, p90Ms, p99Ms, maxMs } }
+  Napi::Object StagesToJs(Napi::Env env) {
+    auto sum = std::make_unique<Block>();
+    snapshot(*sum);
+    Napi::Object r = Napi::Object::New(env);
+    for (size_t s = 0; s < stages_.size(); ++s) {
+      uint64_t n = sum->count[s].load(), total = sum->sumUs[s].load(), mx = sum->maxUs[s].load();
+      Napi::Object o = Napi::Object::New(env);
+      o.Set("count",   Napi::Number::New(env, (double)n));
+      o.Set("totalMs", Napi::Number::New(env, total / 1000.0));
+      o.Set("meanMs",  Napi::Number::New(env, n ? total / 1000.0 / (double)n : 0.0));
+      o.Set("p50Ms",   Napi::Number::New(env, percentile(*sum, s, n, 0.50, mx) / 1000.0));
+      o.Set("p90Ms",   Napi::Number::New(env, percentile(*sum, s, n, 0.90, mx) / 1000.0));
+      o.Set("p99Ms",   Napi::Number::New(env, percentile(*sum, s, n, 0.99, mx) / 1000.0));
+      o.Set("maxMs",   Napi::Number::New(env, mx / 1000.0));
+      r.Set(stages_[s], o);
+    }
+    return r;
+  }
+
+  Napi::Object CountersToJs(Napi::Env env) {
+    auto sum = std::make_unique<Block>();
+    snapshot(*sum);
+    Napi::Object r = Napi::Object::New(env);
+    for (size_t c = 0; c < counters_.size(); ++c)
+      r.Set(counters_[c], Napi::Number::New(env, (double)sum->counters[c].load()));
+    return r;
+  }
+
+private:
+  struct Block {
+    std::atomic<uint64_t> count[kMaxStages] = {}, sumUs[kMaxStages] = {}, maxUs[kMaxStages] = {};
+    std::atomic<uint64_t> hist[kMaxStages][kBuckets] = {};
+    std::atomic<uint64_t> counters[kMaxCounters] = {};
+  };
+
+  // This thread's blocks, one per instance it has recorded into.
+  struct Slot {
+    std::vector<std::pair<Metrics*, Block*>> blocks;
+    ~Slot() { for (auto& b : blocks) b.first->retire(b.second); }
+  };
+
+  Block& local() {
+    thread_local Slot slot;
+    for (auto& b : slot.blocks) if (b.first == this) return *b.second;
+    Block* block = new Block();
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      live_.push_back(block);
+    }
+    slot.blocks.emplace_back(this, block);
+    return *block;
+  }
+
+  // Single writer per block, so load+store is enough.
+  void bump(std::atomic<uint64_t>& a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  static size_t bucket(uint64_t us) {
+    size_t b = us ? (size_t)(64 - __builtin_clzll(us)) : 0;
+    return b < kBuckets ? b : kBuckets - 1;
+  }
+
+  static double percentile(const Block& sum, size_t s, uint64_t n, double q, uint64_t mx) {
+    if (!n) return 0;
+    uint64_t want = (uint64_t)(q * (double)n + 0.5), seen = 0;
+    if (want == 0) want = 1;
+    for (size_t b = 0; b < kBuckets; ++b) {
+      seen += sum.hist[s][b].load();
+      if (seen >= want) return (double)std::min<uint64_t>(b ? (1ull << b) : 1, mx);
+    }
+    return (double)mx;
+  }
+
+  static void merge(Block& into, const Block& from) {
+    for (size_t s = 0; s < kMaxStages; ++s) {
+      into.count[s].store(into.count[s].load() + from.count[s].load(std::memory_order_relaxed));
+      into.sumUs[s].store(into.sumUs[s].load() + from.sumUs[s].load(std::memory_order_relaxed));
+      uint64_t m = from.maxUs[s].load(std::memory_order_relaxed);
+      if (m > into.maxUs[s].load()) into.maxUs[s].store(m);
+      for (size_t b = 0; b < kBuckets; ++b)
+        into.hist[s][b].store(into.hist[s][b].load() + from.hist[s][b].load(std::memory_order_relaxed));
+    }
+    for (size_t c = 0; c < kMaxCounters; ++c)
+      into.counters[c].store(into.counters[c].load() + from.counters[c].load(std::memory_order_relaxed));
+  }
+
+  void snapshot(Block& sum) {
+    std::lock_guard<std::mutex> lk(mu_);
+    merge(sum, retired_);
+    for (Block* b : live_) merge(sum, *b);
+  }
+
+  void retire(Block* b) {
+    std::lock_guard<std::mutex> lk(mu_);
+    merge(retired_, *b);
+    for (auto it = live_.begin(); it != live_.end(); ++it)
+      if (*it == b) { live_.erase(it); break; }
+    delete b;
+  }
+
+  std::vector<const char*> stages_, counters_;
+  std::mutex mu_;
+  std::vector<Block*> live_;
+  Block retired_;
+};
+
+// What one call spent in each stage. Spans add to it as the job runs;
+// Commit() files each stage the job went through as one histogram sample,
+// and ToJs() is the `trace` handed back to calls that ask for one.
+class StageClock {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  class Span {
+  public:
+    Span(StageClock* c, size_t stage) : c_(c), stage_(stage), t0_(Clock::now()) {}
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+    ~Span() { if (c_) c_->Add(stage_, Clock::now() - t0_); }
+  private:
+    StageClock* c_;
+    size_t stage_;
+    Clock::time_point t0_;
+  };
+
+  explicit StageClock(Metrics& m) : m_(m) {}
+
+  Span Time(size_t stage) { return Span(this, stage); }
+
+  void Add(size_t stage, Clock::duration d) {
+    if (stage >= Metrics::kMaxStages) return;
+    ns_[stage] += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    used_[stage] = true;
+  }
+
+  void Count(size_t counter, uint64_t n) { m_.Add(counter, n); }
+
+  // Once per call, when it is done.
+  void Commit() {
+    if (committed_) return;
+    committed_ = true;
+    for (size_t s = 0; s < m_.StageCount(); ++s)
+      if (used_[s]) m_.Record(s, ns_[s] / 1000);
+  }
+
+  // { <stage>: ms } for the stages this call went through.
+  Napi::Object ToJs(Napi::Env env) const {
+    Napi::Object r = Napi::Object::New(env);
+    for (size_t s = 0; s < m_.StageCount(); ++s)
+      if (used_[s]) r.Set(m_.StageName(s), Napi::Number::New(env, ns_[s] / 1e6));
+    return r;
+  }
+
+private:
+  Metrics& m_;
+  uint64_t ns_[Metrics::kMaxStages] = {};
+  bool used_[Metrics::kMaxStages] = {};
+  bool committed_ = false;
+};
+
+static inline double PeakRssBytes() {
+  struct rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  return (double)ru.ru_maxrss * 1024.0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Kernels over the 512x512 sticker canvas. The canvas holds libwebp's own
+// ARGB words (0xAARRGGBB in host byte order), so a WebPPicture can point
+// straight at it instead of importing a repacked copy.
+//
+// ClearTransparent zeroes the colour of pixels with alpha 0. Nobody sees
+// it, and left alone the encoder spends bits on whatever the scaler put
+// there. The AVX2 variant is picked at runtime; NEON is baseline wherever
+// it is compiled in.
+namespace pixels {
+
+inline void ClearTransparentScalar(uint32_t* px, size_t n){
+  for (size_t i = 0; i < n; ++i)
+    if ((px[i] >> 24) == 0) px[i] = 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+inline void ClearTransparentAVX2(uint32_t* px, size_t n){
+  const __m256i amask = _mm256_set1_epi32((int)0xff000000u);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(px + i));
+    __m256i clear = _mm256_cmpeq_epi32(_mm256_and_si256(v, amask), zero);
+    _mm256_storeu_si256((__m256i*)(px + i), _mm256_andnot_si256(clear, v));
+  }
+  ClearTransparentScalar(px + i, n - i);
+}
+#endif
+
+#if defined(__ARM_NEON)
+inline void ClearTransparentNEON(uint32_t* px, size_t n){
+  const uint32x4_t amask = vdupq_n_u32(0xff000000u);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4){
+    uint32x4_t v = vld1q_u32(px + i);
+    vst1q_u32(px + i, vandq_u32(v, vtstq_u32(v, amask)));
+  }
+  ClearTransparentScalar(px + i, n - i);
+}
+#endif
+
+using ClearFn = void (*)(uint32_t*, size_t);
+
+struct ClearKernel { ClearFn fn; const char* isa; };
+
+inline ClearKernel PickClearTransparent(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return { &ClearTransparentAVX2, "avx2" };
+#elif defined(__ARM_NEON)
+  return { &ClearTransparentNEON, "neon" };
+#endif
+  return { &ClearTransparentScalar, "scalar" };
+}
+
+inline const ClearKernel& ClearTransparentKernel(){
+  static const ClearKernel k = PickClearTransparent();
+  return k;
+}
+
+inline void ClearTransparent(uint32_t* px, size_t n){ ClearTransparentKernel().fn(px, n); }
+
+} // namespace pixels
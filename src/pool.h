@@ -0,0 +1,228 @@
+#pragma once
+#include <napi.h>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+// PoolTask follows the Napi::AsyncWorker shape (Execute / OnOK / OnError) but
+// runs on a TaskPool owned by the addon instead of the libuv threadpool, so
+// long transcodes never starve fs/dns/fetch work. Completion is marshalled
+// back to the JS thread through a per-task ThreadSafeFunction, which also
+// keeps the event loop alive while the task is pending.
+//
+// Cancellation is cooperative: Cancel() flips a shared flag that Execute()
+// polls between units of work. The flag outlives the task so abort handles
+// handed to JS stay valid after the task has been deleted.
+class PoolTask {
+public:
+  explicit PoolTask(Napi::Env env, const char* name = "liora:pool")
+  : env_(env), cancel_(std::make_shared<std::atomic<bool>>(false)) {
+    tsfn_ = Napi::ThreadSafeFunction::New(env,
+      Napi::Function::New(env, [](const Napi::CallbackInfo&){}), name, 0, 1);
+  }
+  virtual ~PoolTask() = default;
+
+  virtual void Execute() = 0;
+  virtual void OnOK() = 0;
+  virtual void OnError(const Napi::Error& e) = 0;
+
+  Napi::Env Env() const { return env_; }
+  void SetError(const std::string& msg) { error_ = msg; }
+
+  std::shared_ptr<std::atomic<bool>> CancelToken() const { return cancel_; }
+  bool IsCancelled() const { return cancel_->load(std::memory_order_relaxed); }
+  void Cancel() { cancel_->store(true); }
+
+  // JS function that requests cancellation of this task.
+  Napi::Function MakeAbort(Napi::Env env) const {
+    auto token = cancel_;
+    return Napi::Function::New(env, [token](const Napi::CallbackInfo& info){
+      token->store(true);
+      return info.Env().Undefined();
+    });
+  }
+
+  // Pool thread: run the job, then hand the task over to the JS thread,
+  // which finalizes and deletes it.
+  void Run() {
+    try { Execute(); }
+    catch (const std::exception& e) { error_ = e.what(); }
+    catch (...) { error_ = "unknown native error"; }
+    Complete();
+  }
+
+  // Any thread: skip Execute() and only deliver the current error_.
+  void Complete() {
+    Napi::ThreadSafeFunction tsfn = tsfn_;
+    tsfn.BlockingCall(this, [](Napi::Env env, Napi::Function, PoolTask* t){
+      t->Finish(env);
+    });
+    tsfn.Release();
+  }
+
+private:
+  void Finish(Napi::Env env) {
+    Napi::HandleScope scope(env);
+    if (error_.empty()) OnOK();
+    else OnError(Napi::Error::New(env, error_));
+    delete this;
+  }
+
+  Napi::Env env_;
+  Napi::ThreadSafeFunction tsfn_;
+  std::shared_ptr<std::atomic<bool>> cancel_;
+  std::string error_;
+};
+
+// Bounded FIFO pool of detached worker threads. Threads are spawned lazily up
+// to `threads`; when `maxQueue` pending tasks are already waiting, Submit()
+// either refuses the task (Reject) or parks it until a slot frees up (Wait).
+// Parking is bounded too: past `maxWaiting` parked tasks, Wait rejects as
+// well, so a burst cannot pin an unbounded number of inputs.
+class TaskPool {
+public:
+  enum class Overflow { Reject, Wait };
+  struct Options {
+    size_t threads = 1;
+    size_t maxQueue = 0;        // 0 = unbounded
+    Overflow overflow = Overflow::Wait;
+    size_t maxWaiting = 256;    // parked tasks under Wait; 0 = unbounded
+  };
+  struct Stats {
+    size_t threads, running, queued, waiting;
+    uint64_t completed, rejected;
+  };
+
+  explicit TaskPool(Options o) : opts_(sanitize(o)) {}
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // JS thread. Returns false when the task was rejected; ownership stays
+  // with the caller in that case.
+  bool Submit(PoolTask* t) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (opts_.maxQueue && queue_.size() >= opts_.maxQueue) {
+      if (opts_.overflow == Overflow::Reject || (opts_.maxWaiting && waiting_.size() >= opts_.maxWaiting)) {
+        ++rejected_;
+        return false;
+      }
+      waiting_.push_back(t);
+    } else {
+      queue_.push_back(t);
+    }
+    spawnLocked();
+    cv_.notify_one();
+    return true;
+  }
+
+  void Configure(const Options& o) {
+    std::lock_guard<std::mutex> lk(mu_);
+    opts_ = sanitize(o);
+    refillLocked();
+    spawnLocked();
+    cv_.notify_all();
+  }
+
+  Options GetOptions() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return opts_;
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return Stats{ alive_, running_, queue_.size(), waiting_.size(), completed_, rejected_ };
+  }
+
+  static size_t DefaultThreads() {
+    unsigned hc = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, hc / 2);
+  }
+
+private:
+  static Options sanitize(Options o) {
+    if (o.threads == 0) o.threads = DefaultThreads();
+    return o;
+  }
+
+  void refillLocked() {
+    while (!waiting_.empty() && (!opts_.maxQueue || queue_.size() < opts_.maxQueue)) {
+      queue_.push_back(waiting_.front());
+      waiting_.pop_front();
+    }
+  }
+
+  void spawnLocked() {
+    size_t pending = queue_.size();
+    while (alive_ < opts_.threads && alive_ < running_ + pending) {
+      ++alive_;
+      std::thread([this]{ loop(); }).detach();
+    }
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      cv_.wait(lk, [&]{ return !queue_.empty() || alive_ > opts_.threads; });
+      if (alive_ > opts_.threads) { --alive_; return; }
+      PoolTask* t = queue_.front();
+      queue_.pop_front();
+      refillLocked();
+      ++running_;
+      lk.unlock();
+      t->Run();
+      lk.lock();
+      --running_;
+      ++completed_;
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<PoolTask*> queue_;
+  std::deque<PoolTask*> waiting_;
+  Options opts_;
+  size_t alive_ = 0;
+  size_t running_ = 0;
+  uint64_t completed_ = 0;
+  uint64_t rejected_ = 0;
+};
+
+static inline TaskPool::Options ParsePoolOptions(const Napi::Object& o, TaskPool::Options cur) {
+  if (o.Has("threads"))  cur.threads  = (size_t)std::max<int64_t>(0, o.Get("threads").ToNumber().Int64Value());
+  if (o.Has("maxQueue")) cur.maxQueue = (size_t)std::max<int64_t>(0, o.Get("maxQueue").ToNumber().Int64Value());
+  if (o.Has("maxWaiting")) cur.maxWaiting = (size_t)std::max<int64_t>(0, o.Get("maxWaiting").ToNumber().Int64Value());
+  if (o.Has("onFull")) {
+    std::string m = o.Get("onFull").ToString().Utf8Value();
+    if (m == "reject") cur.overflow = TaskPool::Overflow::Reject;
+    else if (m == "wait") cur.overflow = TaskPool::Overflow::Wait;
+    else throw std::runtime_error("onFull must be \"reject\" or \"wait\"");
+  }
+  return cur;
+}
+
+static inline Napi::Object PoolOptionsToJs(Napi::Env env, const TaskPool::Options& o) {
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("threads",  Napi::Number::New(env, (double)o.threads));
+  r.Set("maxQueue", Napi::Number::New(env, (double)o.maxQueue));
+  r.Set("onFull",   Napi::String::New(env, o.overflow == TaskPool::Overflow::Reject ? "reject" : "wait"));
+  r.Set("maxWaiting", Napi::Number::New(env, (double)o.maxWaiting));
+  return r;
+}
+
+static inline Napi::Object PoolStatsToJs(Napi::Env env, const TaskPool::Stats& s) {
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("threads",   Napi::Number::New(env, (double)s.threads));
+  r.Set("running",   Napi::Number::New(env, (double)s.running));
+  r.Set("queued",    Napi::Number::New(env, (double)s.queued));
+  r.Set("waiting",   Napi::Number::New(env, (double)s.waiting));
+  r.Set("completed", Napi::Number::New(env, (double)s.completed));
+  r.Set("rejected",  Napi::Number::New(env, (double)s.rejected));
+  return r;
+}
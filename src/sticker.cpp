@@ -1,12 +1,26 @@
 #include <napi.h>
+#include "pool.h"
+#include "buffer.h"
+#include "cache.h"
+#include "stream.h"
+#include "pixels.h"
+#include "metrics.h"
 #include <vector>
 #include <string>
 #include <cstring>
 #include <stdexcept>
-#include <sstream>
+#include <cstdlib>
+#include <cstdio>
 #include <random>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <deque>
+#include <thread>
+#include <sys/resource.h>
 #include <webp/encode.h>
 #include <webp/mux.h>
 #include <webp/mux_types.h>
@@ -17,6 +31,8 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/avutil.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 }
@@ -27,16 +43,27 @@ static inline void ensure(bool ok, const char* msg) {
 static inline void ensure_ptr(const void* p, const char* msg) {
   if (!p) throw std::runtime_error(msg);
 }
+static inline void check_cancel(const std::atomic<bool>* cancel) {
+  if (cancel && cancel->load(std::memory_order_relaxed)) throw std::runtime_error("sticker aborted");
+}
 
 struct AvFmtGuard { AVFormatContext* p=nullptr; ~AvFmtGuard(){ if(p) avformat_close_input(&p);} };
 struct AvIOGuard  { AVIOContext*     p=nullptr; ~AvIOGuard(){ if(p){ av_free(p->buffer); avio_context_free(&p);} } };
 struct AvCodecCtxG{ AVCodecContext*  p=nullptr; ~AvCodecCtxG(){ if(p) avcodec_free_context(&p);} };
 struct AvFrameGuard{ AVFrame*        p=nullptr; ~AvFrameGuard(){ if(p) av_frame_free(&p);} };
 struct SwsGuard   { SwsContext*      p=nullptr; ~SwsGuard(){ if(p) sws_freeContext(p);} };
+struct AnimEncGuard{ WebPAnimEncoder* p=nullptr; ~AnimEncGuard(){ if(p) WebPAnimEncoderDelete(p);} };
+struct MuxGuard   { WebPMux*         p=nullptr; ~MuxGuard(){ if(p) WebPMuxDelete(p);} };
 
 static inline void write_le32(uint8_t* d, uint32_t x){
   d[0]=x&0xff; d[1]=(x>>8)&0xff; d[2]=(x>>16)&0xff; d[3]=(x>>24)&0xff;
 }
+static inline void write_le24(uint8_t* d, uint32_t x){
+  d[0]=x&0xff; d[1]=(x>>8)&0xff; d[2]=(x>>16)&0xff;
+}
+static inline uint32_t read_le32(const uint8_t* d){
+  return (uint32_t)d[0] | ((uint32_t)d[1]<<8) | ((uint32_t)d[2]<<16) | ((uint32_t)d[3]<<24);
+}
 static std::string random_hex(size_t nbytes) {
   static const char* k="0123456789abcdef";
   std::string out; out.resize(nbytes*2);
@@ -48,41 +75,140 @@ static std::vector<uint8_t> BuildWhatsAppExif(
   const std::string& authorName,
   const std::vector<std::string>& emojis
 ){
-  std::ostringstream ss;
-  ss << "{"
-     << "\"sticker-pack-id\":\"" << random_hex(16) << "\","
-     << "\"sticker-pack-name\":\"" << packName << "\","
-     << "\"sticker-pack-publisher\":\"" << authorName << "\","
-     << "\"emojis\":[";
-  for(size_t i=0;i<emojis.size();++i){ if(i) ss<<","; ss<<"\""<<emojis[i]<<"\""; }
-  ss << "]}";
-  const std::string json = ss.str();
-
   static const uint8_t tiff_hdr[] = {
     0x49,0x49,0x2A,0x00,0x08,0x00,0x00,0x00,0x01,0x00,0x41,0x57,0x07,0x00,
     0x00,0x00,0x00,0x00,0x16,0x00,0x00,0x00
   };
-  std::vector<uint8_t> exif;
-  exif.reserve(sizeof(tiff_hdr)+json.size());
-  exif.insert(exif.end(), tiff_hdr, tiff_hdr+sizeof(tiff_hdr));
-  write_le32(&exif[14], (uint32_t)json.size());
-  exif.insert(exif.end(), json.begin(), json.end());
+  static const char k1[] = "{\"sticker-pack-id\":\"";
+  static const char k2[] = "\",\"sticker-pack-name\":\"";
+  static const char k3[] = "\",\"sticker-pack-publisher\":\"";
+  static const char k4[] = "\",\"emojis\":[";
+  static const char k5[] = "]}";
+
+  const std::string id = random_hex(16);
+  size_t jsonLen = (sizeof(k1)-1) + id.size() + (sizeof(k2)-1) + packName.size()
+                 + (sizeof(k3)-1) + authorName.size() + (sizeof(k4)-1) + (sizeof(k5)-1);
+  for (size_t i=0;i<emojis.size();++i) jsonLen += emojis[i].size() + 2 + (i ? 1 : 0);
+
+  std::vector<uint8_t> exif(sizeof(tiff_hdr) + jsonLen);
+  std::memcpy(exif.data(), tiff_hdr, sizeof(tiff_hdr));
+  write_le32(&exif[14], (uint32_t)jsonLen);
+
+  uint8_t* w = exif.data() + sizeof(tiff_hdr);
+  auto put = [&](const char* s, size_t n){ std::memcpy(w, s, n); w += n; };
+  put(k1, sizeof(k1)-1); put(id.data(), id.size());
+  put(k2, sizeof(k2)-1); put(packName.data(), packName.size());
+  put(k3, sizeof(k3)-1); put(authorName.data(), authorName.size());
+  put(k4, sizeof(k4)-1);
+  for (size_t i=0;i<emojis.size();++i){
+    if (i) put(",", 1);
+    put("\"", 1); put(emojis[i].data(), emojis[i].size()); put("\"", 1);
+  }
+  put(k5, sizeof(k5)-1);
   return exif;
 }
 
-static std::vector<uint8_t> AttachExifToWebP(const std::vector<uint8_t>& webp,
-                                             const std::vector<uint8_t>& exif){
-  WebPData in; in.bytes = webp.data(); in.size = webp.size();
-  WebPMux* mux = WebPMuxCreate(&in, 1); ensure_ptr(mux, "WebPMuxCreate failed");
+// Muxes straight from `webp` and `exif` without copying them; both must stay
+// alive until this returns.
+static OwnedBuffer AttachExifToWebPMux(const uint8_t* webp, size_t len,
+                                       const std::vector<uint8_t>& exif){
+  WebPData in; in.bytes = webp; in.size = len;
+  MuxGuard mux; mux.p = WebPMuxCreate(&in, 0); ensure_ptr(mux.p, "WebPMuxCreate failed");
   WebPData ex; ex.bytes = exif.data(); ex.size = exif.size();
-  ensure(WebPMuxSetChunk(mux, "EXIF", &ex, 1) == WEBP_MUX_OK, "WebPMuxSetChunk(EXIF) failed");
+  ensure(WebPMuxSetChunk(mux.p, "EXIF", &ex, 0) == WEBP_MUX_OK, "WebPMuxSetChunk(EXIF) failed");
   WebPData out; WebPDataInit(&out);
-  ensure(WebPMuxAssemble(mux, &out) == WEBP_MUX_OK, "WebPMuxAssemble failed");
-  WebPMuxDelete(mux);
-  std::vector<uint8_t> res(out.size);
-  std::memcpy(res.data(), out.bytes, out.size);
-  WebPDataClear(&out);
-  return res;
+  ensure(WebPMuxAssemble(mux.p, &out) == WEBP_MUX_OK, "WebPMuxAssemble failed");
+  return OwnedBuffer((uint8_t*)out.bytes, out.size, WebPFree);
+}
+
+// RIFF-level EXIF injection: walks the chunk list once and writes the result
+// into a single allocation. Any existing EXIF chunk is replaced, the new one
+// goes before XMP (or last), and a simple VP8/VP8L file gets a VP8X header.
+// Returns false for layouts it does not recognise so the caller can fall
+// back to WebPMux.
+static bool AttachExifFast(const uint8_t* d, size_t n, const std::vector<uint8_t>& exif, OwnedBuffer& out){
+  if (n < 20 || std::memcmp(d, "RIFF", 4) != 0 || std::memcmp(d+8, "WEBP", 4) != 0) return false;
+  size_t end = (size_t)read_le32(d+4) + 8;
+  if (end > n || end < 20) return false;
+
+  struct Span { size_t off, len; };
+  Span spans[64]; size_t nspans = 0;
+  size_t keptBytes = 0, xmpAt = SIZE_MAX;
+  for (size_t off = 12; off < end; ){
+    if (end - off < 8 || nspans == 64) return false;
+    size_t payload = read_le32(d+off+4);
+    size_t len = 8 + payload + (payload & 1);
+    if (len > end - off) return false;
+    if (std::memcmp(d+off, "EXIF", 4) != 0){
+      if (xmpAt == SIZE_MAX && std::memcmp(d+off, "XMP ", 4) == 0) xmpAt = nspans;
+      spans[nspans++] = Span{off, len};
+      keptBytes += len;
+    }
+    off += len;
+  }
+  if (nspans == 0) return false;
+
+  const uint8_t* first = d + spans[0].off;
+  const bool extended = std::memcmp(first, "VP8X", 4) == 0;
+  uint8_t vp8x[18];
+  if (extended){
+    if (read_le32(first+4) < 10) return false;
+  } else {
+    // simple file: exactly one VP8 or VP8L chunk; synthesise VP8X from its header
+    if (nspans != 1) return false;
+    const uint8_t* p = first + 8;
+    size_t plen = read_le32(first+4);
+    uint32_t w, h; uint8_t flags = 0x08;
+    if (std::memcmp(first, "VP8 ", 4) == 0){
+      if (plen < 10 || p[3] != 0x9d || p[4] != 0x01 || p[5] != 0x2a) return false;
+      w = (p[6] | (p[7] << 8)) & 0x3fff;
+      h = (p[8] | (p[9] << 8)) & 0x3fff;
+    } else if (std::memcmp(first, "VP8L", 4) == 0){
+      if (plen < 5 || p[0] != 0x2f) return false;
+      w = 1 + (p[1] | ((p[2] & 0x3f) << 8));
+      h = 1 + ((p[2] >> 6) | (p[3] << 2) | ((p[4] & 0x0f) << 10));
+      if ((p[4] >> 4) & 1) flags |= 0x10;
+    } else {
+      return false;
+    }
+    if (w == 0 || h == 0) return false;
+    std::memcpy(vp8x, "VP8X", 4); write_le32(vp8x+4, 10);
+    vp8x[8] = flags; vp8x[9] = vp8x[10] = vp8x[11] = 0;
+    write_le24(vp8x+12, w - 1); write_le24(vp8x+15, h - 1);
+  }
+
+  const size_t exifLen = 8 + exif.size() + (exif.size() & 1);
+  const size_t total = 12 + (extended ? 0 : sizeof(vp8x)) + keptBytes + exifLen;
+  if (total - 8 > 0xffffffffu) return false;
+  uint8_t* o = (uint8_t*)std::malloc(total);
+  ensure_ptr(o, "malloc failed");
+
+  uint8_t* w = o;
+  std::memcpy(w, "RIFF", 4); write_le32(w+4, (uint32_t)(total - 8)); std::memcpy(w+8, "WEBP", 4); w += 12;
+  if (!extended){ std::memcpy(w, vp8x, sizeof(vp8x)); w += sizeof(vp8x); }
+  auto putExif = [&]{
+    std::memcpy(w, "EXIF", 4); write_le32(w+4, (uint32_t)exif.size());
+    std::memcpy(w+8, exif.data(), exif.size());
+    if (exif.size() & 1) w[8 + exif.size()] = 0;
+    w += exifLen;
+  };
+  for (size_t i=0;i<nspans;++i){
+    if (i == xmpAt) putExif();
+    std::memcpy(w, d + spans[i].off, spans[i].len);
+    if (i == 0 && extended) w[8] |= 0x08;
+    w += spans[i].len;
+  }
+  if (xmpAt == SIZE_MAX) putExif();
+
+  out = OwnedBuffer(o, total, std::free);
+  return true;
+}
+
+static OwnedBuffer AttachExifToWebP(const uint8_t* webp, size_t len,
+                                    const std::vector<uint8_t>& exif){
+  OwnedBuffer out;
+  if (AttachExifFast(webp, len, exif, out)) return out;
+  return AttachExifToWebPMux(webp, len, exif);
 }
 
 static bool IsWebP(const uint8_t* d, size_t n){
@@ -100,6 +226,21 @@ static int readPacket(void* opaque, uint8_t* buf, int buf_size){
   c->pos += tocpy;
   return tocpy;
 }
+static int64_t seekPacket(void* opaque, int64_t offset, int whence){
+  BufferCtx* c = (BufferCtx*)opaque;
+  if (whence == AVSEEK_SIZE) return (int64_t)c->size;
+  int64_t base;
+  switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET: base = 0; break;
+    case SEEK_CUR: base = (int64_t)c->pos; break;
+    case SEEK_END: base = (int64_t)c->size; break;
+    default: return -1;
+  }
+  int64_t np = base + offset;
+  if (np < 0 || np > (int64_t)c->size) return -1;
+  c->pos = (size_t)np;
+  return np;
+}
 struct OpenResult {
   AvFmtGuard fmt;
   AvIOGuard  io;
@@ -109,19 +250,39 @@ struct OpenResult {
 };
 static void FreeBufferCtx(OpenResult& R){ if(R.ctx){ delete R.ctx; R.ctx=nullptr; } }
 
-static OpenResult OpenFromBuffer(const uint8_t* buf, size_t len){
-  OpenResult R;
+// Forward-only AVIO over a ByteStream: no seek callback, so startTime is
+// reached by decoding up to it.
+static int readStream(void* opaque, uint8_t* buf, int buf_size){
+  int64_t r = ((ByteStreamRef*)opaque)->Read(buf, (size_t)buf_size);
+  if (r == 0) return AVERROR_EOF;
+  return r < 0 ? AVERROR(EIO) : (int)r;
+}
+
+// Opens the demuxer over `buf` and reads its header, nothing more. With
+// `fast`, format detection and any later stream analysis are capped to the
+// first few hundred KB and half a second of media.
+static void OpenBufferInput(OpenResult& R, const uint8_t* buf, size_t len, bool fast){
   unsigned char* iobuf = (unsigned char*)av_malloc(1<<15);
   ensure_ptr(iobuf, "av_malloc failed");
   R.ctx = new BufferCtx{buf,len,0};
-  R.io.p = avio_alloc_context(iobuf, 1<<15, 0, R.ctx, &readPacket, nullptr, nullptr);
+  R.io.p = avio_alloc_context(iobuf, 1<<15, 0, R.ctx, &readPacket, nullptr, &seekPacket);
   ensure_ptr(R.io.p, "avio_alloc_context failed");
   R.fmt.p = avformat_alloc_context();
   ensure_ptr(R.fmt.p, "avformat_alloc_context failed");
   R.fmt.p->pb = R.io.p;
   R.fmt.p->flags |= AVFMT_FLAG_CUSTOM_IO;
+  if (fast) {
+    R.fmt.p->format_probesize = 32 * 1024;
+    R.fmt.p->probesize = 256 * 1024;
+    R.fmt.p->max_analyze_duration = AV_TIME_BASE / 2;
+  }
 
   ensure(avformat_open_input(&R.fmt.p, "", nullptr, nullptr)==0, "avformat_open_input failed");
+}
+
+static OpenResult OpenFromBuffer(const uint8_t* buf, size_t len){
+  OpenResult R;
+  OpenBufferInput(R, buf, len, false);
   ensure(avformat_find_stream_info(R.fmt.p, nullptr)>=0, "avformat_find_stream_info failed");
   R.stream_index = av_find_best_stream(R.fmt.p, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
   ensure(R.stream_index>=0, "no video/image stream found");
@@ -129,200 +290,1013 @@ static OpenResult OpenFromBuffer(const uint8_t* buf, size_t len){
   return R;
 }
 
-struct RGBAFrame { std::vector<uint8_t> data; int w,h; int64_t pts_ms; };
+static OpenResult OpenFromStream(ByteStreamRef& in){
+  OpenResult R;
+  unsigned char* iobuf = (unsigned char*)av_malloc(1<<15);
+  ensure_ptr(iobuf, "av_malloc failed");
+  R.io.p = avio_alloc_context(iobuf, 1<<15, 0, &in, &readStream, nullptr, nullptr);
+  ensure_ptr(R.io.p, "avio_alloc_context failed");
+  R.fmt.p = avformat_alloc_context();
+  ensure_ptr(R.fmt.p, "avformat_alloc_context failed");
+  R.fmt.p->pb = R.io.p;
+  R.fmt.p->flags |= AVFMT_FLAG_CUSTOM_IO;
 
-static SwsContext* MakeSws(int sw, int sh, AVPixelFormat sfmt, int dw, int dh){
-  return sws_getContext(sw, sh, sfmt, dw, dh, AV_PIX_FMT_RGBA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+  bool opened = avformat_open_input(&R.fmt.p, "", nullptr, nullptr)==0;
+  if (!opened && in.Failed()) throw std::runtime_error(in.Error());
+  ensure(opened, "avformat_open_input failed (input must be readable without seeking)");
+  ensure(avformat_find_stream_info(R.fmt.p, nullptr)>=0, "avformat_find_stream_info failed");
+  R.stream_index = av_find_best_stream(R.fmt.p, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  ensure(R.stream_index>=0, "no video/image stream found");
+  R.st = R.fmt.p->streams[R.stream_index];
+  return R;
 }
 
-static std::vector<uint8_t> RGBAResize512(const uint8_t* rgba, int w, int h, bool crop){
-  const int TW=512, TH=512;
-  int srcX=0, srcY=0, srcW=w, srcH=h;
+// What probe() reports. Durations are in milliseconds, 0 when unknown.
+struct ProbeInfo {
+  std::string format;
+  int64_t durationMs = 0;
+  int64_t bitrate = 0;
+  bool hasVideo = false, hasAudio = false, animated = false;
+  std::string videoCodec, audioCodec;
+  int width = 0, height = 0, frames = 0;
+  double fps = 0;
+  int sampleRate = 0, channels = 0;
+};
 
-  if (crop){
-    int side = std::min(w,h);
-    srcX = (w - side)/2; srcY = (h - side)/2; srcW = side; srcH = side;
-  } else {
-    double rw = (double)TW / w, rh = (double)TH / h;
-    double s = std::min(rw, rh);
-    int dstW = std::max(1, (int)(w*s));
-    int dstH = std::max(1, (int)(h*s));
-
-    SwsGuard sw; sw.p = MakeSws(w, h, AV_PIX_FMT_RGBA, dstW, dstH);
-    ensure_ptr(sw.p, "sws_getContext pad scale failed");
-
-    std::vector<uint8_t> scaled(dstW*dstH*4);
-    uint8_t* dstData[4]; int dstLS[4];
-    av_image_fill_arrays(dstData, dstLS, scaled.data(), AV_PIX_FMT_RGBA, dstW, dstH, 1);
-    const uint8_t* srcData[4]; int srcLS[4];
-    av_image_fill_arrays((uint8_t**)srcData, (int*)srcLS, const_cast<uint8_t*>(rgba), AV_PIX_FMT_RGBA, w, h, 1);
-    sws_scale(sw.p, (const uint8_t* const*)srcData, srcLS, 0, h, dstData, dstLS);
-
-    std::vector<uint8_t> canvas(TW*TH*4, 0);
-    int offX = (TW - dstW)/2, offY = (TH - dstH)/2;
-    for (int y=0;y<dstH;++y){
-      std::memcpy(&canvas[((offY+y)*TW + offX)*4], &scaled[y*dstW*4], dstW*4);
-    }
-    return canvas;
+// WebP only needs its chunk headers: WebPDemux walks them without decoding
+// a single frame.
+static ProbeInfo ProbeWebP(const uint8_t* d, size_t n){
+  WebPData wd{ d, n };
+  WebPDemuxer* dmx = WebPDemux(&wd);
+  ensure_ptr(dmx, "invalid WebP");
+  ProbeInfo P;
+  P.format = "webp";
+  P.hasVideo = true;
+  P.videoCodec = "webp";
+  P.width  = (int)WebPDemuxGetI(dmx, WEBP_FF_CANVAS_WIDTH);
+  P.height = (int)WebPDemuxGetI(dmx, WEBP_FF_CANVAS_HEIGHT);
+  P.frames = (int)WebPDemuxGetI(dmx, WEBP_FF_FRAME_COUNT);
+  P.animated = (WebPDemuxGetI(dmx, WEBP_FF_FORMAT_FLAGS) & ANIMATION_FLAG) != 0;
+  WebPIterator it;
+  if (P.animated && WebPDemuxGetFrame(dmx, 1, &it)) {
+    do { P.durationMs += it.duration; } while (WebPDemuxNextFrame(&it));
+    WebPDemuxReleaseIterator(&it);
   }
+  if (P.durationMs > 0) P.fps = P.frames * 1000.0 / (double)P.durationMs;
+  WebPDemuxDelete(dmx);
+  return P;
+}
 
-  SwsGuard sw; sw.p = MakeSws(srcW, srcH, AV_PIX_FMT_RGBA, TW, TH);
-  ensure_ptr(sw.p, "sws_getContext crop scale failed");
+static bool IsStillImageCodec(AVCodecID id){
+  return id == AV_CODEC_ID_PNG || id == AV_CODEC_ID_MJPEG || id == AV_CODEC_ID_BMP ||
+         id == AV_CODEC_ID_TIFF || id == AV_CODEC_ID_WEBP;
+}
 
-  const uint8_t* srcData[4]; int srcLS[4];
-  av_image_fill_arrays((uint8_t**)srcData, (int*)srcLS, const_cast<uint8_t*>(rgba), AV_PIX_FMT_RGBA, w, h, 1);
+// Container-level facts for routing a job before it is run. Nothing is
+// decoded in `fast` mode: stream info comes from the header, and the
+// limited avformat_find_stream_info only runs for streams the header left
+// incomplete.
+static ProbeInfo ProbeCore(const uint8_t* d, size_t n, bool fast){
+  if (IsWebP(d, n)) return ProbeWebP(d, n);
 
-  const uint8_t* src0 = const_cast<uint8_t*>(rgba) + (srcY*w + srcX)*4;
-  const uint8_t* srcDataAdj[4] = { src0, nullptr, nullptr, nullptr };
-  int srcLSAdj[4] = { w*4, 0,0,0 };
+  OpenResult R;
+  OpenBufferInput(R, d, n, fast);
+  AVFormatContext* fc = R.fmt.p;
+  bool complete = fc->nb_streams > 0;
+  for (unsigned i = 0; i < fc->nb_streams; ++i) {
+    const AVCodecParameters* cp = fc->streams[i]->codecpar;
+    if (cp->codec_type == AVMEDIA_TYPE_VIDEO && (cp->width <= 0 || cp->height <= 0)) complete = false;
+    if (cp->codec_type == AVMEDIA_TYPE_AUDIO && (cp->sample_rate <= 0 || cp->ch_layout.nb_channels <= 0)) complete = false;
+  }
+  if (!fast || !complete)
+    ensure(avformat_find_stream_info(fc, nullptr)>=0, "avformat_find_stream_info failed");
 
-  std::vector<uint8_t> out(TW*TH*4);
-  uint8_t* dstData[4]; int dstLS[4];
-  av_image_fill_arrays(dstData, dstLS, out.data(), AV_PIX_FMT_RGBA, TW, TH, 1);
-  sws_scale(sw.p, (const uint8_t* const*)srcDataAdj, srcLSAdj, 0, srcH, dstData, dstLS);
-  return out;
+  ProbeInfo P;
+  P.format = fc->iformat && fc->iformat->name ? fc->iformat->name : "";
+  if (fc->duration > 0 && fc->duration != AV_NOPTS_VALUE) P.durationMs = fc->duration / 1000;
+  P.bitrate = fc->bit_rate > 0 ? fc->bit_rate : 0;
+
+  int vi = av_find_best_stream(fc, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  int ai = av_find_best_stream(fc, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  if (vi >= 0) {
+    AVStream* st = fc->streams[vi];
+    P.hasVideo = true;
+    P.videoCodec = avcodec_get_name(st->codecpar->codec_id);
+    P.width = st->codecpar->width;
+    P.height = st->codecpar->height;
+    AVRational fr = st->avg_frame_rate.num > 0 ? st->avg_frame_rate : st->r_frame_rate;
+    if (fr.num > 0 && fr.den > 0) P.fps = av_q2d(fr);
+    int64_t stDur = (st->duration > 0 && st->duration != AV_NOPTS_VALUE)
+      ? av_rescale_q(st->duration, st->time_base, AVRational{1, 1000}) : P.durationMs;
+    if (st->nb_frames > 0) P.frames = (int)st->nb_frames;
+    else if (st->codecpar->codec_id == AV_CODEC_ID_GIF) {
+      // GIF headers carry no frame count; its packets are frames, and
+      // reading them does not decode anything
+      AVPacket* pkt = av_packet_alloc();
+      ensure_ptr(pkt, "av_packet_alloc failed");
+      while (av_read_frame(fc, pkt) >= 0) {
+        if (pkt->stream_index == vi) ++P.frames;
+        av_packet_unref(pkt);
+      }
+      av_packet_free(&pkt);
+    }
+    else if (IsStillImageCodec(st->codecpar->codec_id)) P.frames = 1;
+    else if (P.fps > 0 && stDur > 0) P.frames = (int)std::lround(P.fps * (double)stDur / 1000.0);
+    P.animated = P.frames > 1 || (!IsStillImageCodec(st->codecpar->codec_id) &&
+                                  st->codecpar->codec_id != AV_CODEC_ID_GIF && stDur > 0);
+  }
+  if (ai >= 0) {
+    const AVCodecParameters* cp = fc->streams[ai]->codecpar;
+    P.hasAudio = true;
+    P.audioCodec = avcodec_get_name(cp->codec_id);
+    P.sampleRate = cp->sample_rate;
+    P.channels = cp->ch_layout.nb_channels;
+  }
+  FreeBufferCtx(R);
+  return P;
 }
 
-static std::vector<uint8_t> EncodeWebPStaticRGBA512(const uint8_t* rgba512, int quality){
-  WebPConfig cfg; ensure(WebPConfigPreset(&cfg, WEBP_PRESET_PICTURE, (float)quality), "WebPConfigPreset failed");
+// Pixel bytes held by one sticker job. The peak of the last job and the
+// all-time peak are published for stats().
+static std::atomic<size_t> g_lastPeakWorkingSet{0};
+static std::atomic<size_t> g_peakWorkingSet{0};
+
+struct WorkingSet {
+  size_t cur = 0, peak = 0;
+  void add(size_t n){ cur += n; if (cur > peak) peak = cur; }
+  void sub(size_t n){ cur -= std::min(cur, n); }
+  ~WorkingSet(){
+    g_lastPeakWorkingSet.store(peak);
+    size_t prev = g_peakWorkingSet.load();
+    while (peak > prev && !g_peakWorkingSet.compare_exchange_weak(prev, peak)) {}
+  }
+};
+
+// Scales decoded frames from their native pixel format straight into a
+// reused 512x512 canvas of ARGB words, the layout WebPPicture encodes from.
+// The SwsContext is kept across frames and only rebuilt when the source
+// geometry or format changes; in letterbox mode the scaler writes into the
+// canvas at the pad offset, so the border is cleared once per geometry and
+// never copied. Sources with alpha get one extra pass over the scaled rows
+// that clears the colour under fully transparent pixels.
+class Scaler512 {
+public:
+  Scaler512(bool crop, WorkingSet& ws) : crop_(crop), ws_(ws), canvas_(512*512*4, 0) {
+    ws_.add(canvas_.size());
+  }
+  ~Scaler512(){ ws_.sub(canvas_.size()); }
+
+  // Returns the canvas; valid until the next call.
+  const uint8_t* Scale(AVFrame* f){
+    const int TW=512, TH=512;
+    int w = f->width, h = f->height;
+
+    if (crop_){
+      int side = std::min(w,h);
+      f->crop_left = (size_t)(w - side)/2; f->crop_right  = (size_t)(w - side - (w - side)/2);
+      f->crop_top  = (size_t)(h - side)/2; f->crop_bottom = (size_t)(h - side - (h - side)/2);
+      ensure(av_frame_apply_cropping(f, AV_FRAME_CROP_UNALIGNED)==0, "av_frame_apply_cropping failed");
+    }
+
+    if (w != srcW_ || h != srcH_ || f->format != srcFmt_){
+      srcW_ = w; srcH_ = h; srcFmt_ = f->format;
+      dstW_ = TW; dstH_ = TH; offX_ = 0; offY_ = 0;
+      if (!crop_){
+        double s = std::min((double)TW / w, (double)TH / h);
+        dstW_ = std::max(1, std::min(TW, (int)(w*s)));
+        dstH_ = std::max(1, std::min(TH, (int)(h*s)));
+        offX_ = (TW - dstW_)/2;
+        offY_ = (TH - dstH_)/2;
+      }
+      std::fill(canvas_.begin(), canvas_.end(), 0);
+      const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)f->format);
+      hasAlpha_ = desc && (desc->flags & (AV_PIX_FMT_FLAG_ALPHA | AV_PIX_FMT_FLAG_PAL));
+    }
+
+    sws_.p = sws_getCachedContext(sws_.p, f->width, f->height, (AVPixelFormat)f->format,
+                                  dstW_, dstH_, AV_PIX_FMT_RGB32,
+                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+    ensure_ptr(sws_.p, "sws_getContext 512 scale failed");
+
+    uint8_t* dstData[4] = { canvas_.data() + ((size_t)offY_*TW + offX_)*4, nullptr, nullptr, nullptr };
+    int dstLS[4] = { TW*4, 0, 0, 0 };
+    sws_scale(sws_.p, f->data, f->linesize, 0, f->height, dstData, dstLS);
+    if (hasAlpha_){
+      for (int y = offY_; y < offY_ + dstH_; ++y)
+        pixels::ClearTransparent((uint32_t*)(canvas_.data() + ((size_t)y*TW + offX_)*4), (size_t)dstW_);
+    }
+    return canvas_.data();
+  }
+
+private:
+  bool crop_;
+  WorkingSet& ws_;
+  std::vector<uint8_t> canvas_;
+  SwsGuard sws_;
+  int srcW_ = 0, srcH_ = 0, srcFmt_ = -1;
+  bool hasAlpha_ = false;
+  int dstW_ = 512, dstH_ = 512, offX_ = 0, offY_ = 0;
+};
+
+struct EncodeParams {
+  int quality = 80;
+  int fps = 15;
+  int method = 4;
+  int kmin = -1, kmax = -1;   // -1 keeps the libwebp default
+  int threads = 1;
+  size_t chunkFrames = 0;     // frames per chunk when threads > 1
+};
+
+static WebPConfig MakeWebPConfig(const EncodeParams& p){
+  WebPConfig cfg; ensure(WebPConfigPreset(&cfg, WEBP_PRESET_PICTURE, (float)p.quality), "WebPConfigPreset failed");
+  cfg.method = std::clamp(p.method, 0, 6);
   ensure(WebPValidateConfig(&cfg), "Invalid WebP config");
-  WebPPicture pic; ensure(WebPPictureInit(&pic), "WebPPictureInit failed");
+  return cfg;
+}
+
+static WebPAnimEncoderOptions MakeAnimOptions(const EncodeParams& p){
+  WebPAnimEncoderOptions aopt; WebPAnimEncoderOptionsInit(&aopt);
+  if (p.kmax >= 0) aopt.kmax = p.kmax;
+  if (p.kmin >= 0) aopt.kmin = p.kmin;
+  return aopt;
+}
+
+// Points `pic` at a canvas instead of importing a copy. Lossy encodes only
+// read the ARGB plane (the YUV they convert it to is theirs), and
+// WebPPictureFree leaves memory it did not allocate alone.
+static void WrapArgb512(WebPPicture& pic, const uint8_t* argb512){
+  ensure(WebPPictureInit(&pic), "WebPPictureInit failed");
   pic.use_argb = 1; pic.width = 512; pic.height = 512;
-  ensure(WebPPictureImportRGBA(&pic, rgba512, 512*4), "WebPPictureImportRGBA failed");
+  pic.argb = (uint32_t*)const_cast<uint8_t*>(argb512);
+  pic.argb_stride = 512;
+}
+
+static OwnedBuffer EncodeWebPStaticARGB512(const uint8_t* argb512, const WebPConfig& cfg){
+  WebPPicture pic; WrapArgb512(pic, argb512);
 
   WebPMemoryWriter mw; WebPMemoryWriterInit(&mw);
   pic.writer = WebPMemoryWrite; pic.custom_ptr = &mw;
-  ensure(WebPEncode(&cfg, &pic), "WebPEncode failed");
-  std::vector<uint8_t> out(mw.size);
-  std::memcpy(out.data(), mw.mem, mw.size);
-  WebPFree(mw.mem); WebPPictureFree(&pic);
-  return out;
+  int ok = WebPEncode(&cfg, &pic);
+  WebPPictureFree(&pic);
+  if (!ok){ WebPMemoryWriterClear(&mw); ensure(false, "WebPEncode failed"); }
+  return OwnedBuffer(mw.mem, mw.size, WebPFree);
 }
 
-static std::vector<uint8_t> EncodeWebPAnimRGBA512(const std::vector<RGBAFrame>& frames, int quality, int fps, bool crop){
-  ensure(!frames.empty(), "no frames");
-  WebPAnimEncoderOptions aopt; WebPAnimEncoderOptionsInit(&aopt);
-  WebPAnimEncoder* enc = WebPAnimEncoderNew(512, 512, &aopt);
-  ensure_ptr(enc, "WebPAnimEncoderNew failed");
+static void AnimAddARGB512(WebPAnimEncoder* enc, const uint8_t* argb512, int t_ms, const WebPConfig& cfg){
+  WebPPicture pic; WrapArgb512(pic, argb512);
+  int ok = WebPAnimEncoderAdd(enc, &pic, t_ms, &cfg);
+  WebPPictureFree(&pic);
+  ensure(ok == 1, "WebPAnimEncoderAdd failed");
+}
 
-  WebPConfig cfg; ensure(WebPConfigPreset(&cfg, WEBP_PRESET_PICTURE, (float)quality), "WebPConfigPreset failed");
-  ensure(WebPValidateConfig(&cfg), "Invalid WebP config");
+static OwnedBuffer AnimAssemble(WebPAnimEncoder* enc, int end_ms){
+  ensure(WebPAnimEncoderAdd(enc, nullptr, end_ms, nullptr) == 1, "WebPAnimEncoderAdd flush failed");
+  WebPData out; WebPDataInit(&out);
+  ensure(WebPAnimEncoderAssemble(enc, &out) == 1, "WebPAnimEncoderAssemble failed");
+  return OwnedBuffer((uint8_t*)out.bytes, out.size, WebPFree);
+}
+
+// A run of consecutive frames encoded as its own animation. Every chunk but
+// the first also gets a standalone full-canvas encode of its first frame,
+// which replaces that frame at merge time so the chunk no longer depends on
+// whatever the previous chunk left on the canvas.
+struct AnimChunk {
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<int64_t> pts;
+};
+struct EncodedChunk {
+  OwnedBuffer anim;
+  OwnedBuffer key;
+  int duration = 0;
+};
+
+static EncodedChunk EncodeAnimChunk(const AnimChunk& c, int64_t end_ms, bool needKey,
+                                    const WebPConfig& cfg, const WebPAnimEncoderOptions& aopt,
+                                    const std::atomic<bool>* cancel){
+  EncodedChunk r;
+  AnimEncGuard enc; enc.p = WebPAnimEncoderNew(512, 512, &aopt);
+  ensure_ptr(enc.p, "WebPAnimEncoderNew failed");
+  const int64_t t0 = c.pts.front();
+  for (size_t i=0;i<c.frames.size();++i){
+    check_cancel(cancel);
+    AnimAddARGB512(enc.p, c.frames[i].data(), (int)std::max<int64_t>(0, c.pts[i] - t0), cfg);
+  }
+  r.duration = (int)std::max<int64_t>(1, end_ms - t0);
+  r.anim = AnimAssemble(enc.p, r.duration);
+  if (needKey) r.key = EncodeWebPStaticARGB512(c.frames.front().data(), cfg);
+  return r;
+}
 
-  int64_t t0 = frames.front().pts_ms;
-  for (const auto& fr : frames){
-    auto rgba512 = RGBAResize512(fr.data.data(), fr.w, fr.h, crop);
+static OwnedBuffer MergeAnimChunks(const std::vector<EncodedChunk>& chunks){
+  MuxGuard out; out.p = WebPMuxNew(); ensure_ptr(out.p, "WebPMuxNew failed");
+  WebPMuxAnimParams params{0xFFFFFFFFu, 0};
 
-    WebPPicture pic; ensure(WebPPictureInit(&pic), "WebPPictureInit failed");
-    pic.use_argb = 1; pic.width = 512; pic.height = 512;
-    ensure(WebPPictureImportRGBA(&pic, rgba512.data(), 512*4), "WebPPictureImportRGBA failed");
+  for (size_t ci=0; ci<chunks.size(); ++ci){
+    WebPData in; in.bytes = chunks[ci].anim.data(); in.size = chunks[ci].anim.size();
+    MuxGuard src; src.p = WebPMuxCreate(&in, 0); ensure_ptr(src.p, "WebPMuxCreate chunk failed");
+    if (ci == 0) WebPMuxGetAnimationParams(src.p, &params);
 
-    int t_ms = (int)std::max<int64_t>(0, fr.pts_ms - t0);
-    ensure(WebPAnimEncoderAdd(enc, &pic, t_ms, &cfg) == 1, "WebPAnimEncoderAdd failed");
-    WebPPictureFree(&pic);
+    // the encoder emits a still image when a chunk collapses to one frame
+    int n = 0;
+    ensure(WebPMuxNumChunks(src.p, WEBP_CHUNK_ANMF, &n) == WEBP_MUX_OK, "WebPMuxNumChunks failed");
+    const bool still = (n == 0);
+    if (still) n = 1;
+    for (int fi=1; fi<=n; ++fi){
+      WebPMuxFrameInfo f;
+      ensure(WebPMuxGetFrame(src.p, (uint32_t)fi, &f) == WEBP_MUX_OK, "WebPMuxGetFrame failed");
+      f.id = WEBP_CHUNK_ANMF;
+      if (still){
+        f.x_offset = 0; f.y_offset = 0;
+        f.duration = chunks[ci].duration;
+        f.dispose_method = WEBP_MUX_DISPOSE_NONE;
+        f.blend_method = WEBP_MUX_NO_BLEND;
+      }
+      if (ci > 0 && fi == 1){
+        WebPDataClear(&f.bitstream);
+        f.bitstream.bytes = chunks[ci].key.data(); f.bitstream.size = chunks[ci].key.size();
+        f.x_offset = 0; f.y_offset = 0;
+        f.blend_method = WEBP_MUX_NO_BLEND;
+        WebPMuxError e = WebPMuxPushFrame(out.p, &f, 1);
+        ensure(e == WEBP_MUX_OK, "WebPMuxPushFrame failed");
+        continue;
+      }
+      WebPMuxError e = WebPMuxPushFrame(out.p, &f, 1);
+      WebPDataClear(&f.bitstream);
+      ensure(e == WEBP_MUX_OK, "WebPMuxPushFrame failed");
+    }
   }
-  int last_ts = (int)std::max<int64_t>(0, frames.back().pts_ms - t0 + (1000 / std::max(1, fps)));
-  ensure(WebPAnimEncoderAdd(enc, nullptr, last_ts, nullptr) == 1, "WebPAnimEncoderAdd flush failed");
 
-  WebPData out; WebPDataInit(&out);
-  ensure(WebPAnimEncoderAssemble(enc, &out) == 1, "WebPAnimEncoderAssemble failed");
-  WebPAnimEncoderDelete(enc);
+  ensure(WebPMuxSetAnimationParams(out.p, &params) == WEBP_MUX_OK, "WebPMuxSetAnimationParams failed");
+  ensure(WebPMuxSetCanvasSize(out.p, 512, 512) == WEBP_MUX_OK, "WebPMuxSetCanvasSize failed");
+  WebPData res; WebPDataInit(&res);
+  ensure(WebPMuxAssemble(out.p, &res) == WEBP_MUX_OK, "WebPMuxAssemble failed");
+  return OwnedBuffer((uint8_t*)res.bytes, res.size, WebPFree);
+}
+
+// Takes 512x512 ARGB frames as they are produced. The first frame is kept
+// until a second one shows up (it may be a still image).
+//
+// With threads <= 1 every later frame goes straight into one WebPAnimEncoder,
+// so the pipeline never holds more than one canvas regardless of clip length.
+// Otherwise frames are grouped into chunks of `chunkFrames`, each chunk is
+// encoded on its own thread (at most `threads` in flight) and the results are
+// spliced together with WebPMux. That trades up to threads * chunkFrames
+// canvases of memory, and a keyframe per chunk, for wall-clock time.
+class StickerEncoder {
+public:
+  StickerEncoder(const EncodeParams& p, WorkingSet& ws, const std::atomic<bool>* cancel)
+  : p_(p), ws_(ws), cancel_(cancel), cfg_(MakeWebPConfig(p)), aopt_(MakeAnimOptions(p)) {
+    if (p_.threads > 1) p_.chunkFrames = std::max<size_t>(2, p_.chunkFrames);
+  }
+  ~StickerEncoder(){
+    for (auto& f : inflight_) if (f.first.valid()) f.first.wait();
+    ws_.sub(first_.size());
+  }
+
+  void Add(const uint8_t* argb512, int64_t pts_ms){
+    if (p_.threads > 1) addChunked(argb512, pts_ms);
+    else addSerial(argb512, pts_ms);
+    last_ = pts_ms;
+    ++count_;
+  }
+
+  size_t Count() const { return count_; }
+
+  OwnedBuffer Finish(){
+    ensure(count_ > 0, "no frames");
+    int64_t end_ms = last_ + (1000 / std::max(1, p_.fps));
+
+    if (p_.threads <= 1){
+      if (count_ == 1) return EncodeWebPStaticARGB512(first_.data(), cfg_);
+      return AnimAssemble(enc_.p, (int)std::max<int64_t>(1, end_ms - t0_));
+    }
+
+    if (count_ == 1) return EncodeWebPStaticARGB512(cur_.frames.front().data(), cfg_);
+    if (nextChunk_ == 0) return EncodeAnimChunk(cur_, end_ms, false, cfg_, aopt_, cancel_).anim;
+
+    launch(end_ms);
+    while (!inflight_.empty()) collect();
+    return MergeAnimChunks(done_);
+  }
+
+private:
+  void addSerial(const uint8_t* argb512, int64_t pts_ms){
+    if (count_ == 0){
+      first_.assign(argb512, argb512 + 512*512*4);
+      ws_.add(first_.size());
+      t0_ = pts_ms;
+      return;
+    }
+    if (count_ == 1){
+      enc_.p = WebPAnimEncoderNew(512, 512, &aopt_);
+      ensure_ptr(enc_.p, "WebPAnimEncoderNew failed");
+      AnimAddARGB512(enc_.p, first_.data(), 0, cfg_);
+      ws_.sub(first_.size());
+      std::vector<uint8_t>().swap(first_);
+    }
+    AnimAddARGB512(enc_.p, argb512, (int)std::max<int64_t>(0, pts_ms - t0_), cfg_);
+  }
+
+  void addChunked(const uint8_t* argb512, int64_t pts_ms){
+    // a chunk is only sealed once the next frame arrives, because that
+    // frame's timestamp is the end of the chunk's last frame
+    if (cur_.frames.size() >= p_.chunkFrames) launch(pts_ms);
+    cur_.frames.emplace_back(argb512, argb512 + 512*512*4);
+    cur_.pts.push_back(pts_ms);
+    curBytes_ += 512*512*4;
+    ws_.add(512*512*4);
+  }
+
+  void launch(int64_t end_ms){
+    while (inflight_.size() >= (size_t)p_.threads) collect();
+    bool needKey = nextChunk_++ > 0;
+    auto fut = std::async(std::launch::async,
+      [c = std::move(cur_), end_ms, needKey, cfg = cfg_, aopt = aopt_, cancel = cancel_]{
+        return EncodeAnimChunk(c, end_ms, needKey, cfg, aopt, cancel);
+      });
+    inflight_.emplace_back(std::move(fut), curBytes_);
+    cur_ = AnimChunk{};
+    curBytes_ = 0;
+  }
+
+  void collect(){
+    auto f = std::move(inflight_.front());
+    inflight_.pop_front();
+    ws_.sub(f.second);
+    done_.push_back(f.first.get());
+  }
+
+  EncodeParams p_;
+  WorkingSet& ws_;
+  const std::atomic<bool>* cancel_;
+  WebPConfig cfg_;
+  WebPAnimEncoderOptions aopt_;
+  int64_t last_ = 0;
+  size_t count_ = 0;
+
+  // serial
+  AnimEncGuard enc_;
+  std::vector<uint8_t> first_;
+  int64_t t0_ = 0;
+
+  // chunked
+  AnimChunk cur_;
+  size_t curBytes_ = 0;
+  size_t nextChunk_ = 0;
+  std::deque<std::pair<std::future<EncodedChunk>, size_t>> inflight_;
+  std::vector<EncodedChunk> done_;
+};
+
+// Hardware decode devices, opened on first use and shared by every job for
+// the life of the process. A device that fails to open is remembered, so
+// later jobs go straight to software.
+class HwDevices {
+public:
+  // Borrowed; null when the device is unavailable.
+  AVBufferRef* Get(AVHWDeviceType type){
+    std::lock_guard<std::mutex> lk(mu_);
+    for (auto& d : devs_) if (d.first == type) return d.second;
+    AVBufferRef* ref = nullptr;
+    if (av_hwdevice_ctx_create(&ref, type, nullptr, nullptr, 0) < 0) ref = nullptr;
+    devs_.emplace_back(type, ref);
+    return ref;
+  }
+
+private:
+  std::mutex mu_;
+  std::vector<std::pair<AVHWDeviceType, AVBufferRef*>> devs_;
+};
+
+static HwDevices& SharedHwDevices(){
+  static HwDevices* devices = new HwDevices();
+  return *devices;
+}
+
+static std::atomic<uint64_t> g_hwDecodes{0}, g_hwFallbacks{0};
 
-  std::vector<uint8_t> webp(out.size);
-  std::memcpy(webp.data(), out.bytes, out.size);
-  WebPDataClear(&out);
-  return webp;
+// "auto" tries each supported device in turn.
+static std::vector<AVHWDeviceType> HwDeviceTypes(const std::string& name){
+  if (name.empty()) return {};
+  if (name == "auto") return { AV_HWDEVICE_TYPE_VAAPI, AV_HWDEVICE_TYPE_CUDA, AV_HWDEVICE_TYPE_QSV };
+  if (name == "nvdec") return { AV_HWDEVICE_TYPE_CUDA };
+  AVHWDeviceType t = av_hwdevice_find_type_by_name(name.c_str());
+  if (t == AV_HWDEVICE_TYPE_NONE) return {};
+  return { t };
 }
 
-static AvCodecCtxG OpenDecoder(AVStream* st){
+// Takes the hardware format stashed in `opaque` when the decoder offers it;
+// otherwise (an unsupported profile or size) the first software format, so
+// the stream still decodes on the CPU.
+static AVPixelFormat PickHwFormat(AVCodecContext* c, const AVPixelFormat* fmts){
+  AVPixelFormat want = (AVPixelFormat)(intptr_t)c->opaque;
+  for (const AVPixelFormat* p = fmts; *p != AV_PIX_FMT_NONE; ++p)
+    if (*p == want) return want;
+  for (const AVPixelFormat* p = fmts; *p != AV_PIX_FMT_NONE; ++p){
+    const AVPixFmtDescriptor* d = av_pix_fmt_desc_get(*p);
+    if (d && !(d->flags & AV_PIX_FMT_FLAG_HWACCEL)) return *p;
+  }
+  return AV_PIX_FMT_NONE;
+}
+
+// A decoder bound to the first usable device in `types`, or null. QSV has
+// its own decoders (h264_qsv, ...); the others hang off the regular one.
+static AvCodecCtxG OpenHwDecoder(AVStream* st, const std::vector<AVHWDeviceType>& types){
+  AvCodecCtxG DC;
+  for (AVHWDeviceType type : types){
+    const AVCodec* codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (type == AV_HWDEVICE_TYPE_QSV && codec)
+      codec = avcodec_find_decoder_by_name((std::string(codec->name) + "_qsv").c_str());
+    if (!codec) continue;
+
+    AVPixelFormat hwFmt = AV_PIX_FMT_NONE;
+    for (int i = 0; const AVCodecHWConfig* cfg = avcodec_get_hw_config(codec, i); ++i){
+      if ((cfg->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && cfg->device_type == type){
+        hwFmt = cfg->pix_fmt;
+        break;
+      }
+    }
+    if (hwFmt == AV_PIX_FMT_NONE) continue;
+    AVBufferRef* dev = SharedHwDevices().Get(type);
+    if (!dev) continue;
+
+    DC.p = avcodec_alloc_context3(codec);
+    if (!DC.p) continue;
+    if (avcodec_parameters_to_context(DC.p, st->codecpar) == 0 &&
+        (DC.p->hw_device_ctx = av_buffer_ref(dev)) != nullptr){
+      DC.p->opaque = (void*)(intptr_t)hwFmt;
+      DC.p->get_format = &PickHwFormat;
+      if (avcodec_open2(DC.p, codec, nullptr) == 0 && DC.p->width > 0 && DC.p->height > 0) return DC;
+    }
+    avcodec_free_context(&DC.p);
+  }
+  return DC;
+}
+
+// `hwaccel` names a device (or "auto"); if none can decode this stream the
+// usual software decoder is opened instead, without an error.
+static AvCodecCtxG OpenDecoder(AVStream* st, const std::string& hwaccel = std::string()){
+  auto types = HwDeviceTypes(hwaccel);
+  if (!types.empty()){
+    AvCodecCtxG HW = OpenHwDecoder(st, types);
+    if (HW.p){ g_hwDecodes.fetch_add(1, std::memory_order_relaxed); return HW; }
+    g_hwFallbacks.fetch_add(1, std::memory_order_relaxed);
+  }
   AvCodecCtxG DC;
   const AVCodec* codec = avcodec_find_decoder(st->codecpar->codec_id);
   ensure_ptr(codec, "decoder not found");
   DC.p = avcodec_alloc_context3(codec); ensure_ptr(DC.p, "avcodec_alloc_context3 failed");
   ensure(avcodec_parameters_to_context(DC.p, st->codecpar)==0, "parameters_to_context failed");
+  // several jobs already share the sticker pool, so a few threads each
+  DC.p->thread_count = (int)std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+  DC.p->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
   ensure(avcodec_open2(DC.p, codec, nullptr)==0, "avcodec_open2 failed");
   ensure(DC.p->width>0 && DC.p->height>0, "invalid source dimensions");
   return DC;
 }
 
-static std::vector<RGBAFrame> DecodeAll(AVFormatContext* fmt, int si, AVCodecContext* dec,
-                                        int maxDurationSec, int targetFps){
-  std::vector<RGBAFrame> out;
+// Where a sticker job's time goes, for stats() and `trace`.
+enum : size_t { kStageDemux, kStageDecode, kStageScale, kStageEncode, kStageExif };
+enum : size_t { kBytesIn, kBytesOut, kFramesOut, kFailedJobs };
+
+static Metrics& StickerMetrics(){
+  static Metrics* m = new Metrics({ "demux", "decode", "scale", "encode", "exif" },
+                                  { "bytesIn", "bytesOut", "frames", "failed" });
+  return *m;
+}
+
+using FrameSink = std::function<void(AVFrame* frame, int64_t pts_ms)>;
+
+// Decodes the selected stream from `startSec` for `maxDurationSec` and
+// hands every kept frame, still in the decoder's pixel format, to `sink`,
+// with timestamps relative to the start. The frame is reused after the call
+// returns. Returns the number of frames delivered.
+//
+// Seekable input jumps to the keyframe before the start instead of decoding
+// its way there. Reading stops at the first packet past the end, and when
+// the source runs at well over the target rate, non-reference frames (which
+// the sampler would mostly drop) are not decoded at all.
+static size_t DecodeFrames(AVFormatContext* fmt, int si, AVCodecContext* dec,
+                           double startSec, int maxDurationSec, int targetFps,
+                           const std::atomic<bool>* cancel, StageClock& clock, const FrameSink& sink){
   AvFrameGuard frame; frame.p = av_frame_alloc(); ensure_ptr(frame.p, "av_frame_alloc failed");
-  SwsGuard sws;
+  size_t kept = 0;
 
+  int64_t start_pts = 0, start_ms = 0;
   int64_t max_pts = std::numeric_limits<int64_t>::max();
   AVRational tb = fmt->streams[si]->time_base;
   if (tb.den>0){
-    max_pts = av_rescale_q((int64_t)maxDurationSec*1000, AVRational{1,1000}, tb);
+    start_ms = (int64_t)(std::max(0.0, startSec) * 1000.0);
+    start_pts = av_rescale_q(start_ms, AVRational{1,1000}, tb);
+    max_pts = start_pts + av_rescale_q((int64_t)maxDurationSec*1000, AVRational{1,1000}, tb);
   }
+  if (start_pts > 0 && fmt->pb && (fmt->pb->seekable & AVIO_SEEKABLE_NORMAL)){
+    if (av_seek_frame(fmt, si, start_pts, AVSEEK_FLAG_BACKWARD) >= 0) avcodec_flush_buffers(dec);
+  }
+
+  AVRational srcRate = fmt->streams[si]->avg_frame_rate;
+  if (targetFps>0 && srcRate.num>0 && srcRate.den>0 && av_q2d(srcRate) >= 2.0*targetFps)
+    dec->skip_frame = AVDISCARD_NONREF;
 
   int64_t step_pts = 0, next_keep = 0;
   if (targetFps>0 && tb.den>0){
     step_pts = av_rescale_q((int64_t)1000/targetFps, AVRational{1,1000}, tb);
   }
 
+  // hardware frames are downloaded only once they are known to be kept
+  AvFrameGuard swFrame;
+
+  // false once the frame is past maxDuration and decoding can stop
+  auto emit = [&]()->bool {
+    if (frame.p->width<=0 || frame.p->height<=0) return true;
+
+    if (max_pts != std::numeric_limits<int64_t>::max() && frame.p->pts!=AV_NOPTS_VALUE && frame.p->pts > max_pts){
+      return false;
+    }
+    if (start_pts > 0 && frame.p->pts!=AV_NOPTS_VALUE && frame.p->pts < start_pts) return true;
+    if (step_pts>0 && frame.p->pts!=AV_NOPTS_VALUE){
+      if (frame.p->pts < next_keep) return true;
+      next_keep = frame.p->pts + step_pts;
+    }
+
+    int64_t ms = (frame.p->pts!=AV_NOPTS_VALUE) ? av_rescale_q(frame.p->pts, tb, AVRational{1,1000}) : 0;
+    ms = std::max<int64_t>(0, ms - start_ms);
+    AVFrame* out = frame.p;
+    if (frame.p->hw_frames_ctx){
+      auto t = clock.Time(kStageDecode);
+      if (!swFrame.p){ swFrame.p = av_frame_alloc(); ensure_ptr(swFrame.p, "av_frame_alloc failed"); }
+      av_frame_unref(swFrame.p);
+      ensure(av_hwframe_transfer_data(swFrame.p, frame.p, 0)==0, "hardware frame download failed");
+      av_frame_copy_props(swFrame.p, frame.p);
+      out = swFrame.p;
+    }
+    sink(out, ms);
+    ++kept;
+    return true;
+  };
+
   AVPacket pkt; av_init_packet(&pkt);
-  while (av_read_frame(fmt, &pkt) >= 0){
+  // timed call by call, since emit() runs scale and encode in between
+  auto nextPacket = [&]{ auto t = clock.Time(kStageDemux); return av_read_frame(fmt, &pkt) >= 0; };
+  auto sendPacket = [&](const AVPacket* p){ auto t = clock.Time(kStageDecode); return avcodec_send_packet(dec, p); };
+  auto receiveFrame = [&]{ auto t = clock.Time(kStageDecode); return avcodec_receive_frame(dec, frame.p); };
+
+  bool more = true;
+  while (more && nextPacket()){
     if (pkt.stream_index != si){ av_packet_unref(&pkt); continue; }
-    ensure(avcodec_send_packet(dec, &pkt)==0, "send_packet failed");
+    // dts never exceeds pts, so nothing from here on is inside the window
+    if (pkt.dts != AV_NOPTS_VALUE && pkt.dts > max_pts){ av_packet_unref(&pkt); break; }
+    if (cancel && cancel->load(std::memory_order_relaxed)){ av_packet_unref(&pkt); check_cancel(cancel); }
+    ensure(sendPacket(&pkt)==0, "send_packet failed");
     av_packet_unref(&pkt);
 
-    while (true){
-      int r = avcodec_receive_frame(dec, frame.p);
+    while (more){
+      int r = receiveFrame();
       if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) break;
       ensure(r==0, "receive_frame failed");
+      more = emit();
+    }
+  }
+  if (more){
+    ensure(sendPacket(nullptr)==0, "send_packet(NULL) failed");
+    while (more && receiveFrame()==0){
+      more = emit();
+    }
+  }
+  return kept;
+}
 
-      if (frame.p->width<=0 || frame.p->height<=0) continue;
-      if (!sws.p){
-        sws.p = sws_getContext(frame.p->width, frame.p->height, (AVPixelFormat)frame.p->format,
-                               frame.p->width, frame.p->height, AV_PIX_FMT_RGBA,
-                               SWS_BILINEAR, nullptr, nullptr, nullptr);
-        ensure_ptr(sws.p, "sws_getContext decode RGBA failed");
-      }
+struct StickerMeta {
+  std::string pack;
+  std::string author;
+  std::vector<std::string> emojis;
+};
 
-      if (max_pts != std::numeric_limits<int64_t>::max() && frame.p->pts!=AV_NOPTS_VALUE && frame.p->pts > max_pts){
-        return out;
-      }
+struct StickerOptions {
+  bool crop = false;
+  int quality = 80;
+  int fps = 15;
+  int maxDuration = 15;
+  double startTime = 0;       // seconds into the input
+  int threads = 1;
+  int kmin = -1, kmax = -1;
+  int method = 4;
+  size_t maxBytes = 0;        // 0 = no size target
+  std::string hwaccel;        // empty = software decode
+  bool trace = false;         // attach per-stage timings to the result
+  StickerMeta meta;
+};
 
-      if (step_pts>0 && frame.p->pts!=AV_NOPTS_VALUE){
-        if (frame.p->pts < next_keep) continue;
-        next_keep = frame.p->pts + step_pts;
-      }
+static StickerMeta ParseStickerMeta(const Napi::Object& o){
+  StickerMeta m;
+  m.pack = o.Has("packName") ? o.Get("packName").ToString().Utf8Value() : "";
+  m.author = o.Has("authorName") ? o.Get("authorName").ToString().Utf8Value() : "";
+  if (o.Has("emojis") && o.Get("emojis").IsArray()){
+    Napi::Array arr = o.Get("emojis").As<Napi::Array>();
+    for (uint32_t i=0;i<arr.Length();++i)
+      if (arr.Get(i).IsString()) m.emojis.emplace_back(arr.Get(i).ToString().Utf8Value());
+  }
+  return m;
+}
+
+static StickerOptions ParseStickerOptions(const Napi::Object& opt){
+  StickerOptions o;
+  o.crop = opt.Has("crop") ? (bool)opt.Get("crop").ToBoolean() : false;
+  o.quality = opt.Has("quality") ? (int)opt.Get("quality").ToNumber().Int32Value() : 80;
+  o.fps = opt.Has("fps") ? (int)opt.Get("fps").ToNumber().Int32Value() : 15;
+  o.maxDuration = opt.Has("maxDuration") ? (int)opt.Get("maxDuration").ToNumber().Int32Value() : 15;
+  if (opt.Has("startTime") && opt.Get("startTime").IsNumber())
+    o.startTime = std::max(0.0, opt.Get("startTime").ToNumber().DoubleValue());
+  if (opt.Has("threads") && opt.Get("threads").IsNumber()){
+    o.threads = opt.Get("threads").ToNumber().Int32Value();
+    if (o.threads <= 0) o.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (opt.Has("kmin") && opt.Get("kmin").IsNumber()) o.kmin = std::max(0, opt.Get("kmin").ToNumber().Int32Value());
+  if (opt.Has("kmax") && opt.Get("kmax").IsNumber()) o.kmax = std::max(0, opt.Get("kmax").ToNumber().Int32Value());
+  if (opt.Has("method") && opt.Get("method").IsNumber()) o.method = std::clamp(opt.Get("method").ToNumber().Int32Value(), 0, 6);
+  if (opt.Has("maxBytes") && opt.Get("maxBytes").IsNumber())
+    o.maxBytes = (size_t)std::max<int64_t>(0, opt.Get("maxBytes").ToNumber().Int64Value());
+  o.trace = opt.Has("trace") && opt.Get("trace").ToBoolean().Value();
+  if (opt.Has("hwaccel")){
+    Napi::Value hw = opt.Get("hwaccel");
+    if (hw.IsString()) o.hwaccel = hw.As<Napi::String>().Utf8Value();
+    else if (hw.IsBoolean() && hw.As<Napi::Boolean>().Value()) o.hwaccel = "auto";
+  }
+  o.meta = ParseStickerMeta(opt);
+  return o;
+}
 
-      int dstW = frame.p->width, dstH = frame.p->height;
-      int num = av_image_get_buffer_size(AV_PIX_FMT_RGBA, dstW, dstH, 1);
-      std::vector<uint8_t> rgba(num);
-      uint8_t* dstData[4]; int dstLS[4];
-      av_image_fill_arrays(dstData, dstLS, rgba.data(), AV_PIX_FMT_RGBA, dstW, dstH, 1);
-      sws_scale(sws.p, frame.p->data, frame.p->linesize, 0, dstH, dstData, dstLS);
+// Finds the best-looking encode that fits in `budget` bytes. Quality is
+// searched first, starting from a guess scaled from the size of the
+// requested-quality pass; if even the lowest quality is too big the search
+// is repeated with method 6, then with every other frame dropped.
+//
+// `encode(stride, ep)` runs one pass over every `stride`-th frame and
+// returns the WebP; `frames()` is the clip's frame count, known once the
+// first pass has run.
+template <typename Encode, typename Frames>
+static OwnedBuffer EncodeToFit(Encode&& encode, Frames&& frames, EncodeParams ep, size_t budget){
+  const int qMax = std::clamp(ep.quality, 1, 100);
+  size_t stride = 1;
+  auto pass = [&]{
+    EncodeParams p = ep;
+    p.fps = std::max(1, ep.fps / (int)stride);
+    if (p.threads > 1 && frames() > 0){
+      size_t kept = (frames() + stride - 1) / stride;
+      p.chunkFrames = std::max<size_t>(4, (kept + p.threads - 1) / p.threads);
+    }
+    return encode(stride, p);
+  };
 
-      int64_t ms = 0;
-      if (frame.p->pts!=AV_NOPTS_VALUE) {
-        ms = av_rescale_q(frame.p->pts, tb, AVRational{1,1000});
-      }
-      out.push_back({ std::move(rgba), dstW, dstH, ms });
+  while (true){
+    ep.quality = qMax;
+    auto out = pass();
+    if (out.size() <= budget) return out;
+
+    OwnedBuffer best;
+    int lo = 1, hi = qMax - 1;
+    int q = std::clamp((int)(qMax * (double)budget / (double)out.size()), lo, std::max(lo, hi));
+    for (int it=0; lo<=hi && it<7; ++it){
+      ep.quality = q;
+      auto cand = pass();
+      if (cand.size() <= budget){ best.swap(cand); lo = q + 1; }
+      else hi = q - 1;
+      q = lo + (hi - lo) / 2;
     }
+    if (!best.empty()) return best;
+
+    if (ep.method < 6){ ep.method = 6; continue; }
+    if (frames() / stride < 2 || ep.fps / (int)(stride*2) < 1) break;
+    stride *= 2;
   }
-  ensure(avcodec_send_packet(dec, nullptr)==0, "send_packet(NULL) failed");
-  while (avcodec_receive_frame(dec, frame.p)==0){
-    if (!sws.p){
-      sws.p = sws_getContext(frame.p->width, frame.p->height, (AVPixelFormat)frame.p->format,
-                             frame.p->width, frame.p->height, AV_PIX_FMT_RGBA,
-                             SWS_BILINEAR, nullptr, nullptr, nullptr);
-      ensure_ptr(sws.p, "sws_getContext flush RGBA failed");
+  throw std::runtime_error("sticker does not fit in maxBytes");
+}
+
+// Where the pixels come from: a buffer, or a stream that is still arriving.
+struct StickerInput {
+  const uint8_t* data = nullptr;
+  size_t len = 0;
+  ByteStreamRef* stream = nullptr;
+};
+
+// Decodes, resizes and encodes the input; the result carries no EXIF.
+// `exifOverhead` is what attaching the metadata will add, so maxBytes can
+// account for it.
+static OwnedBuffer EncodeStickerPixels(const StickerInput& in, const StickerOptions& o,
+                                       size_t exifOverhead, const std::atomic<bool>* cancel,
+                                       StageClock& clock){
+  check_cancel(cancel);
+  if (o.maxBytes > 0) ensure(o.maxBytes > exifOverhead, "maxBytes is smaller than the sticker metadata");
+  auto open = [&]{
+    auto t = clock.Time(kStageDemux);
+    return in.stream ? OpenFromStream(*in.stream) : OpenFromBuffer(in.data, in.len);
+  };
+  OpenResult R = open();
+  // decoding stops at maxDuration, so only a failed read is an error here
+  auto checkStream = [&](){
+    if (in.stream && in.stream->Failed()) throw std::runtime_error(in.stream->Error());
+  };
+
+  EncodeParams ep;
+  ep.quality = o.quality; ep.fps = o.fps; ep.method = o.method;
+  ep.kmin = o.kmin; ep.kmax = o.kmax; ep.threads = o.threads;
+  if (o.threads > 1){
+    // spread the expected frame count evenly over the encoder threads
+    double secs = o.maxDuration;
+    if (R.fmt.p->duration != AV_NOPTS_VALUE && R.fmt.p->duration > 0)
+      secs = std::min(secs, std::max(0.0, (double)R.fmt.p->duration / AV_TIME_BASE - o.startTime));
+    size_t expected = (size_t)std::max(1.0, secs * std::max(1, o.fps));
+    ep.chunkFrames = std::max<size_t>(4, (expected + o.threads - 1) / o.threads);
+  }
+
+  WorkingSet ws;
+  Scaler512 scaler(o.crop, ws);
+  auto openDecoder = [&]{ auto t = clock.Time(kStageDecode); return OpenDecoder(R.st, o.hwaccel); };
+  auto DC = openDecoder();
+  auto scale = [&](AVFrame* f){ auto t = clock.Time(kStageScale); return scaler.Scale(f); };
+
+  // One decode of `src` into `enc`, keeping every `stride`-th frame.
+  auto decodeInto = [&](OpenResult& src, StickerEncoder& enc, size_t stride){
+    size_t i = 0;
+    size_t n = DecodeFrames(src.fmt.p, src.stream_index, DC.p, o.startTime, o.maxDuration, o.fps, cancel, clock,
+      [&](AVFrame* f, int64_t pts_ms){
+        if (i++ % stride) return;
+        const uint8_t* px = scale(f);
+        auto t = clock.Time(kStageEncode);
+        enc.Add(px, pts_ms);
+      });
+    FreeBufferCtx(src);
+    checkStream();
+    ensure(n > 0, "No frame decoded (unsupported codec / corrupt input)");
+    check_cancel(cancel);
+    return n;
+  };
+
+  if (o.maxBytes > 0){
+    // Every search pass decodes the input again into the one canvas rather
+    // than keeping the clip's canvases around (15 s at 15 fps would be
+    // ~225 MiB per job). Stream input was read in full before it got here
+    // (see MakeStickerFromStream), so it can be opened again.
+    ensure(!in.stream, "maxBytes needs buffered input");
+    size_t frames = 0;
+    auto encodePass = [&](size_t stride, const EncodeParams& p){
+      StickerEncoder enc(p, ws, cancel);
+      if (frames == 0){
+        frames = decodeInto(R, enc, stride);
+        clock.Count(kFramesOut, frames);
+      } else {
+        OpenResult again = open();
+        avcodec_flush_buffers(DC.p);
+        decodeInto(again, enc, stride);
+      }
+      auto t = clock.Time(kStageEncode);
+      return enc.Finish();
+    };
+    return EncodeToFit(encodePass, [&]{ return frames; }, ep, o.maxBytes - exifOverhead);
+  }
+
+  StickerEncoder enc(ep, ws, cancel);
+  clock.Count(kFramesOut, decodeInto(R, enc, 1));
+  auto t = clock.Time(kStageEncode);
+  return enc.Finish();
+}
+
+static ResultCache& StickerCache(){
+  static ResultCache* cache = new ResultCache();
+  return *cache;
+}
+
+// Every option that changes the encoded pixels; metadata is left out so
+// stickers that only differ in pack/author share one cache entry. hwaccel
+// is part of the key: a hardware decoder hands swscale NV12/P010 rather
+// than the software decoder's planar output, so the pixels can differ.
+static std::string StickerCacheKey(const uint8_t* data, size_t len, const StickerOptions& o){
+  char opts[160];
+  std::snprintf(opts, sizeof(opts), "c%d q%d f%d s%.3f d%d t%d k%d-%d m%d b%zu h",
+                (int)o.crop, o.quality, o.fps, o.startTime, o.maxDuration, o.threads, o.kmin, o.kmax, o.method, o.maxBytes);
+  return ResultCache::MakeKey(data, len, opts + o.hwaccel);
+}
+
+// EXIF chunk header + payload (+pad), plus the VP8X header a simple lossy
+// file grows when the chunk is attached.
+static size_t ExifOverhead(const std::vector<uint8_t>& exif){
+  return 8 + exif.size() + (exif.size() & 1) + 18;
+}
+
+// EXIF attached under the clock's "exif" stage.
+static OwnedBuffer AttachExifTimed(const uint8_t* webp, size_t len, const std::vector<uint8_t>& exif,
+                                   StageClock& clock){
+  auto t = clock.Time(kStageExif);
+  return AttachExifToWebP(webp, len, exif);
+}
+
+static OwnedBuffer MakeStickerCore(const uint8_t* data, size_t len, const StickerOptions& o,
+                                   const std::atomic<bool>* cancel, StageClock& clock){
+  const StickerMeta& m = o.meta;
+  auto exif = BuildWhatsAppExif(m.pack, m.author, m.emojis);
+  if (IsWebP(data, len)) return AttachExifTimed(data, len, exif, clock);
+
+  size_t overhead = ExifOverhead(exif);
+
+  ResultCache& cache = StickerCache();
+  std::string key;
+  if (cache.Enabled()){
+    key = StickerCacheKey(data, len, o);
+    if (auto hit = cache.Get(key)){
+      // a hit encoded against shorter metadata may no longer fit
+      if (!o.maxBytes || hit->size() + overhead <= o.maxBytes)
+        return AttachExifTimed(hit->data(), hit->size(), exif, clock);
     }
-    int dstW = frame.p->width, dstH = frame.p->height;
-    int num = av_image_get_buffer_size(AV_PIX_FMT_RGBA, dstW, dstH, 1);
-    std::vector<uint8_t> rgba(num);
-    uint8_t* dstData[4]; int dstLS[4];
-    av_image_fill_arrays(dstData, dstLS, rgba.data(), AV_PIX_FMT_RGBA, dstW, dstH, 1);
-    sws_scale(sws.p, frame.p->data, frame.p->linesize, 0, dstH, dstData, dstLS);
-    int64_t ms = (frame.p->pts!=AV_NOPTS_VALUE) ? av_rescale_q(frame.p->pts, tb, AVRational{1,1000}) : 0;
-    out.push_back({ std::move(rgba), dstW, dstH, ms });
   }
-  return out;
+
+  auto webp = EncodeStickerPixels(StickerInput{ data, len, nullptr }, o, overhead, cancel, clock);
+  if (!key.empty()) cache.Put(key, webp.data(), webp.size());
+  return AttachExifTimed(webp.data(), webp.size(), exif, clock);
 }
 
+// Decodes while the input is still arriving. WebP input only needs its
+// metadata swapped, which takes the whole file; a maxBytes search decodes
+// the input once per pass; and MP4/MOV with the index at the end cannot be
+// demuxed front to back. All three are read in full and go the buffer
+// route. Other stream results are not cached.
+static OwnedBuffer MakeStickerFromStream(ByteStreamRef& in, const StickerOptions& o,
+                                         const std::atomic<bool>* cancel, StageClock& clock){
+  const uint8_t* head = nullptr;
+  int64_t n = in.Peek(12, &head);
+  if (n < 0) throw std::runtime_error(in.Error());
+  if (IsWebP(head, (size_t)n) || o.maxBytes > 0 || IsoIndexAfterMedia(in)){
+    auto all = in.ReadAll();
+    clock.Count(kBytesIn, all.size());
+    return MakeStickerCore(all.data(), all.size(), o, cancel, clock);
+  }
+  const StickerMeta& m = o.meta;
+  auto exif = BuildWhatsAppExif(m.pack, m.author, m.emojis);
+  auto webp = EncodeStickerPixels(StickerInput{ nullptr, 0, &in }, o, ExifOverhead(exif), cancel, clock);
+  if (in.Size() > 0) clock.Count(kBytesIn, (uint64_t)in.Size());
+  return AttachExifTimed(webp.data(), webp.size(), exif, clock);
+}
+
+static TaskPool& StickerPool(){
+  static TaskPool* pool = new TaskPool(TaskPool::Options{ TaskPool::DefaultThreads(), 32, TaskPool::Overflow::Wait });
+  return *pool;
+}
+
+class StickerWorker : public PoolTask {
+public:
+  StickerWorker(Napi::Env env, Napi::Buffer<uint8_t> input, StickerOptions opts)
+  : PoolTask(env, "sticker:sticker"), deferred_(Napi::Promise::Deferred::New(env)),
+    data_(input.Data()), len_(input.Length()), opts_(std::move(opts)) {
+    inputRef_ = Napi::Reference<Napi::Buffer<uint8_t>>::New(input, 1);
+  }
+
+  StickerWorker(Napi::Env env, ByteStream* input, StickerOptions opts)
+  : PoolTask(env, "sticker:sticker"), deferred_(Napi::Promise::Deferred::New(env)),
+    data_(nullptr), len_(0), opts_(std::move(opts)), stream_(input) {}
+
+  Napi::Promise Promise() const { return deferred_.Promise(); }
+
+  void Execute() override {
+    auto token = CancelToken();
+    check_cancel(token.get());
+    try {
+      if (stream_) {
+        out_ = MakeStickerFromStream(stream_, opts_, token.get(), clock_);
+        stream_ = ByteStreamRef();   // let the transfer go as soon as decoding is done
+      } else {
+        clock_.Count(kBytesIn, len_);
+        out_ = MakeStickerCore(data_, len_, opts_, token.get(), clock_);
+      }
+    } catch (...) {
+      clock_.Count(kFailedJobs, 1);
+      throw;
+    }
+    clock_.Count(kBytesOut, out_.size());
+    clock_.Commit();
+  }
+
+  void OnOK() override {
+    Napi::Env env = Env();
+    inputRef_.Reset();
+    Napi::Buffer<uint8_t> buf = out_.ToBuffer(env);
+    if (opts_.trace) buf.Set("trace", clock_.ToJs(env));
+    deferred_.Resolve(buf);
+  }
+
+  void OnError(const Napi::Error& e) override {
+    inputRef_.Reset();
+    deferred_.Reject(e.Value());
+  }
+
+private:
+  Napi::Promise::Deferred deferred_;
+  Napi::Reference<Napi::Buffer<uint8_t>> inputRef_;
+  const uint8_t* data_;
+  size_t len_;
+  StickerOptions opts_;
+  ByteStreamRef stream_;
+  OwnedBuffer out_;
+  StageClock clock_{ StickerMetrics() };
+};
+
 Napi::Value AddExif(const Napi::CallbackInfo& info){
   Napi::Env env = info.Env();
   if (info.Length()<2 || !info[0].IsBuffer() || !info[1].IsObject()){
@@ -330,20 +1304,44 @@ Napi::Value AddExif(const Napi::CallbackInfo& info){
     return env.Null();
   }
   auto webp = info[0].As<Napi::Buffer<uint8_t>>();
-  Napi::Object meta = info[1].As<Napi::Object>();
-  std::string pack = meta.Has("packName") ? meta.Get("packName").ToString().Utf8Value() : "";
-  std::string author = meta.Has("authorName") ? meta.Get("authorName").ToString().Utf8Value() : "";
-  std::vector<std::string> emojis;
-  if (meta.Has("emojis") && meta.Get("emojis").IsArray()){
-    Napi::Array arr = meta.Get("emojis").As<Napi::Array>();
-    for (uint32_t i=0;i<arr.Length();++i)
-      if (arr.Get(i).IsString()) emojis.emplace_back(arr.Get(i).ToString().Utf8Value());
+  StickerMeta m = ParseStickerMeta(info[1].As<Napi::Object>());
+
+  try {
+    auto ex = BuildWhatsAppExif(m.pack, m.author, m.emojis);
+    return AttachExifToWebP(webp.Data(), webp.Length(), ex).ToBuffer(env);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Null();
   }
+}
+
+// One EXIF payload (and one sticker-pack-id) shared by every buffer.
+Napi::Value AddExifBatch(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length()<2 || !info[0].IsArray() || !info[1].IsObject()){
+    Napi::TypeError::New(env, "addExifBatch(webpBuffers[], {packName, authorName, emojis?})").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Array in = info[0].As<Napi::Array>();
+  StickerMeta m = ParseStickerMeta(info[1].As<Napi::Object>());
 
-  std::vector<uint8_t> in(webp.Data(), webp.Data()+webp.Length());
-  auto ex = BuildWhatsAppExif(pack, author, emojis);
-  auto out = AttachExifToWebP(in, ex);
-  return Napi::Buffer<uint8_t>::Copy(env, out.data(), out.size());
+  try {
+    auto ex = BuildWhatsAppExif(m.pack, m.author, m.emojis);
+    Napi::Array out = Napi::Array::New(env, in.Length());
+    for (uint32_t i=0;i<in.Length();++i){
+      Napi::Value v = in.Get(i);
+      if (!v.IsBuffer()){
+        Napi::TypeError::New(env, "addExifBatch: element " + std::to_string(i) + " is not a Buffer").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      auto webp = v.As<Napi::Buffer<uint8_t>>();
+      out.Set(i, AttachExifToWebP(webp.Data(), webp.Length(), ex).ToBuffer(env));
+    }
+    return out;
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Null();
+  }
 }
 
 Napi::Value MakeSticker(const Napi::CallbackInfo& info){
@@ -355,54 +1353,133 @@ Napi::Value MakeSticker(const Napi::CallbackInfo& info){
   auto input = info[0].As<Napi::Buffer<uint8_t>>();
   Napi::Object opt = (info.Length()>=2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
 
-  bool crop = opt.Has("crop") ? (bool)opt.Get("crop").ToBoolean() : false;
-  int quality = opt.Has("quality") ? (int)opt.Get("quality").ToNumber().Int32Value() : 80;
-  int fps = opt.Has("fps") ? (int)opt.Get("fps").ToNumber().Int32Value() : 15;
-  int maxDur = opt.Has("maxDuration") ? (int)opt.Get("maxDuration").ToNumber().Int32Value() : 15;
-  std::string pack = opt.Has("packName") ? opt.Get("packName").ToString().Utf8Value() : "";
-  std::string author = opt.Has("authorName") ? opt.Get("authorName").ToString().Utf8Value() : "";
-  std::vector<std::string> emojis;
-  if (opt.Has("emojis") && opt.Get("emojis").IsArray()){
-    Napi::Array arr = opt.Get("emojis").As<Napi::Array>();
-    for (uint32_t i=0;i<arr.Length();++i)
-      if (arr.Get(i).IsString()) emojis.emplace_back(arr.Get(i).ToString().Utf8Value());
+  StageClock clock(StickerMetrics());
+  try {
+    StickerOptions o = ParseStickerOptions(opt);
+    clock.Count(kBytesIn, input.Length());
+    OwnedBuffer out = MakeStickerCore(input.Data(), input.Length(), o, nullptr, clock);
+    clock.Count(kBytesOut, out.size());
+    clock.Commit();
+    Napi::Buffer<uint8_t> buf = out.ToBuffer(env);
+    if (o.trace) buf.Set("trace", clock.ToJs(env));
+    return buf;
+  } catch (const std::exception& e) {
+    clock.Count(kFailedJobs, 1);
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Null();
   }
+}
 
-  const uint8_t* data = input.Data();
-  size_t len = input.Length();
+Napi::Value StartSticker(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  ByteStream* stream = info.Length()>=1 ? UnwrapByteStream(info[0]) : nullptr;
+  if (info.Length()<1 || (!info[0].IsBuffer() && !stream)){
+    Napi::TypeError::New(env, "startSticker(inputBuffer | source, options?)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object opt = (info.Length()>=2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
 
-  if (IsWebP(data, len)){
-    std::vector<uint8_t> in(data, data+len);
-    auto ex = BuildWhatsAppExif(pack, author, emojis);
-    auto out = AttachExifToWebP(in, ex);
-    return Napi::Buffer<uint8_t>::Copy(env, out.data(), out.size());
+  auto* worker = stream
+    ? new StickerWorker(env, stream, ParseStickerOptions(opt))
+    : new StickerWorker(env, info[0].As<Napi::Buffer<uint8_t>>(), ParseStickerOptions(opt));
+  Napi::Object ret = Napi::Object::New(env);
+  ret.Set("promise", worker->Promise());
+  ret.Set("abort", worker->MakeAbort(env));
+  if (!StickerPool().Submit(worker)) {
+    worker->SetError("sticker queue is full");
+    worker->Complete();
   }
+  return ret;
+}
 
-  OpenResult R = OpenFromBuffer(data, len);
-  
-  auto DC = OpenDecoder(R.st);
-  auto frames = DecodeAll(R.fmt.p, R.stream_index, DC.p, maxDur, fps);
-  FreeBufferCtx(R);
-  ensure(!frames.empty(), "No frame decoded (unsupported codec / corrupt input)");
+Napi::Value Probe(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length()<1 || !info[0].IsBuffer()){
+    Napi::TypeError::New(env, "probe(inputBuffer, {fast?})").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  auto input = info[0].As<Napi::Buffer<uint8_t>>();
+  Napi::Object opt = (info.Length()>=2 && info[1].IsObject()) ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+  bool fast = opt.Has("fast") ? opt.Get("fast").ToBoolean().Value() : true;
 
-  std::vector<uint8_t> webp;
-  if (frames.size()==1){
-    auto rgba512 = RGBAResize512(frames[0].data.data(), frames[0].w, frames[0].h, crop);
-    webp = EncodeWebPStaticRGBA512(rgba512.data(), quality);
-  } else {
-    webp = EncodeWebPAnimRGBA512(frames, quality, fps, crop);
+  try {
+    ProbeInfo P = ProbeCore(input.Data(), input.Length(), fast);
+    Napi::Object r = Napi::Object::New(env);
+    r.Set("format",   Napi::String::New(env, P.format));
+    r.Set("duration", Napi::Number::New(env, (double)P.durationMs));
+    r.Set("bitrate",  Napi::Number::New(env, (double)P.bitrate));
+    r.Set("animated", Napi::Boolean::New(env, P.animated));
+    if (P.hasVideo) {
+      Napi::Object v = Napi::Object::New(env);
+      v.Set("codec",  Napi::String::New(env, P.videoCodec));
+      v.Set("width",  Napi::Number::New(env, P.width));
+      v.Set("height", Napi::Number::New(env, P.height));
+      v.Set("fps",    Napi::Number::New(env, P.fps));
+      v.Set("frames", Napi::Number::New(env, P.frames));
+      r.Set("video", v);
+    } else r.Set("video", env.Null());
+    if (P.hasAudio) {
+      Napi::Object a = Napi::Object::New(env);
+      a.Set("codec",      Napi::String::New(env, P.audioCodec));
+      a.Set("sampleRate", Napi::Number::New(env, P.sampleRate));
+      a.Set("channels",   Napi::Number::New(env, P.channels));
+      r.Set("audio", a);
+    } else r.Set("audio", env.Null());
+    return r;
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Null();
   }
+}
+
+Napi::Value Configure(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  if (info.Length() >= 1 && info[0].IsObject()) {
+    try {
+      Napi::Object o = info[0].As<Napi::Object>();
+      StickerPool().Configure(ParsePoolOptions(o, StickerPool().GetOptions()));
+      if (o.Has("cache") && o.Get("cache").IsObject())
+        StickerCache().Configure(ParseCacheOptions(o.Get("cache").As<Napi::Object>(), StickerCache().GetOptions()));
+    } catch (const std::exception& e) {
+      Napi::TypeError::New(env, e.what()).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+  Napi::Object r = PoolOptionsToJs(env, StickerPool().GetOptions());
+  r.Set("cache", CacheOptionsToJs(env, StickerCache().GetOptions()));
+  return r;
+}
+
+Napi::Value Stats(const Napi::CallbackInfo& info){
+  Napi::Env env = info.Env();
+  Napi::Object r = Napi::Object::New(env);
+  r.Set("pool", PoolStatsToJs(env, StickerPool().GetStats()));
+  r.Set("cache", CacheStatsToJs(env, StickerCache().GetStats()));
 
-  auto exif = BuildWhatsAppExif(pack, author, emojis);
-  auto out = AttachExifToWebP(webp, exif);
-  return Napi::Buffer<uint8_t>::Copy(env, out.data(), out.size());
+  Napi::Object mem = Napi::Object::New(env);
+  mem.Set("peakWorkingSet", Napi::Number::New(env, (double)g_peakWorkingSet.load()));
+  mem.Set("lastPeakWorkingSet", Napi::Number::New(env, (double)g_lastPeakWorkingSet.load()));
+  mem.Set("peakRss", Napi::Number::New(env, PeakRssBytes()));
+  r.Set("memory", mem);
+  Napi::Object hw = Napi::Object::New(env);
+  hw.Set("decodes",   Napi::Number::New(env, (double)g_hwDecodes.load()));
+  hw.Set("fallbacks", Napi::Number::New(env, (double)g_hwFallbacks.load()));
+  r.Set("hwaccel", hw);
+  r.Set("stages", StickerMetrics().StagesToJs(env));
+  r.Set("counters", StickerMetrics().CountersToJs(env));
+  return r;
 }
 
 Napi::Object Init(Napi::Env env, Napi::Object exports){
-  exports.Set("addExif",    Napi::Function::New(env, AddExif));
-  exports.Set("sticker",    Napi::Function::New(env, MakeSticker));
-  exports.Set("makeSticker",Napi::Function::New(env, MakeSticker));
+  exports.Set("addExif",     Napi::Function::New(env, AddExif));
+  exports.Set("addExifBatch",Napi::Function::New(env, AddExifBatch));
+  exports.Set("sticker",     Napi::Function::New(env, MakeSticker));
+  exports.Set("makeSticker", Napi::Function::New(env, MakeSticker));
+  exports.Set("startSticker",Napi::Function::New(env, StartSticker));
+  exports.Set("probe",       Napi::Function::New(env, Probe));
+  exports.Set("configure",   Napi::Function::New(env, Configure));
+  exports.Set("stats",       Napi::Function::New(env, Stats));
   return exports;
 }
 
-NODE_API_MODULE(sticker, Init)
\ No newline at end of file
+NODE_API_MODULE(sticker, Init)
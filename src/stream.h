@@ -0,0 +1,302 @@
+#pragma once
+#include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A byte stream handed from one addon to another. The addons are separate
+// shared objects, so a stream crosses over as a type-tagged External around
+// a plain struct of function pointers: the consumer only calls back into the
+// producer's code and never touches its C++ types. Bump kByteStreamAbi when
+// the layout changes.
+struct ByteStream {
+  uint32_t abi;
+  // Blocks until data is available. Bytes read, 0 at end of stream, -1 on
+  // failure (`error` says why).
+  int64_t (*read)(ByteStream* s, uint8_t* dst, size_t n);
+  // Total length when the producer knows it, -1 otherwise.
+  int64_t (*size)(ByteStream* s);
+  const char* (*error)(ByteStream* s);
+  // The consumer stopped before the end; the producer may give up.
+  void (*cancel)(ByteStream* s);
+  void (*retain)(ByteStream* s);
+  void (*release)(ByteStream* s);
+};
+
+constexpr uint32_t kByteStreamAbi = 2;
+constexpr napi_type_tag kByteStreamTag = { 0x6c696f72612d6273ULL, 0x0000000100000002ULL };
+
+// What the External wraps: the stream, and whether a consumer has taken it.
+// JS thread only.
+struct ByteStreamHandle {
+  ByteStream* stream;
+  bool claimed;
+};
+
+// Producer side: the External holds one reference until it is collected.
+// A stream collected before any consumer took it is cancelled, so the
+// producer stops instead of stalling until its own timeout.
+inline Napi::Value WrapByteStream(Napi::Env env, ByteStream* s) {
+  s->retain(s);
+  auto ext = Napi::External<ByteStreamHandle>::New(env, new ByteStreamHandle{ s, false },
+    [](Napi::Env, ByteStreamHandle* h){
+      if (!h->claimed) h->stream->cancel(h->stream);
+      h->stream->release(h->stream);
+      delete h;
+    });
+  napi_type_tag_object(env, ext, &kByteStreamTag);
+  return ext;
+}
+
+// Consumer side: the stream behind `v`, or null if `v` is not one. The
+// caller is expected to take a ByteStreamRef to it right away.
+inline ByteStream* UnwrapByteStream(Napi::Value v) {
+  if (!v.IsExternal()) return nullptr;
+  bool ok = false;
+  if (napi_check_object_type_tag(v.Env(), v, &kByteStreamTag, &ok) != napi_ok || !ok) return nullptr;
+  ByteStreamHandle* h = v.As<Napi::External<ByteStreamHandle>>().Data();
+  if (!h || !h->stream || h->stream->abi != kByteStreamAbi) return nullptr;
+  h->claimed = true;
+  return h->stream;
+}
+
+// Consumer-side handle, safe to move to a worker thread. Bytes pulled by
+// Peek() are replayed by Read(), so a consumer can sniff the format first.
+// Dropping it before the end cancels the producer.
+class ByteStreamRef {
+public:
+  ByteStreamRef() = default;
+  explicit ByteStreamRef(ByteStream* s) : s_(s) { if (s_) s_->retain(s_); }
+  ByteStreamRef(ByteStreamRef&& o) noexcept : s_(o.s_), head_(std::move(o.head_)), headPos_(o.headPos_), eof_(o.eof_), failed_(o.failed_) { o.s_ = nullptr; }
+  ByteStreamRef& operator=(ByteStreamRef&& o) noexcept {
+    if (this != &o) {
+      reset();
+      s_ = o.s_; head_ = std::move(o.head_); headPos_ = o.headPos_; eof_ = o.eof_; failed_ = o.failed_;
+      o.s_ = nullptr;
+    }
+    return *this;
+  }
+  ByteStreamRef(const ByteStreamRef&) = delete;
+  ByteStreamRef& operator=(const ByteStreamRef&) = delete;
+  ~ByteStreamRef() { reset(); }
+
+  explicit operator bool() const { return s_ != nullptr; }
+  int64_t Size() const { return s_->size(s_); }
+  std::string Error() const { const char* e = s_->error(s_); return e ? e : "input stream failed"; }
+
+  // Same contract as ByteStream::read.
+  int64_t Read(uint8_t* dst, size_t n) {
+    if (headPos_ < head_.size()) {
+      size_t k = std::min(n, head_.size() - headPos_);
+      std::memcpy(dst, head_.data() + headPos_, k);
+      headPos_ += k;
+      return (int64_t)k;
+    }
+    int64_t r = s_->read(s_, dst, n);
+    if (r == 0) eof_ = true;
+    if (r < 0) failed_ = true;
+    return r;
+  }
+
+  // A read failed; what was read so far is not the whole input.
+  bool Failed() const { return failed_; }
+
+  // Up to `n` leading bytes, without consuming them; call before Read().
+  // -1 on failure.
+  int64_t Peek(size_t n, const uint8_t** out) {
+    while (head_.size() < n && !eof_) {
+      size_t have = head_.size();
+      head_.resize(n);
+      int64_t r = s_->read(s_, head_.data() + have, n - have);
+      head_.resize(have + (size_t)std::max<int64_t>(0, r));
+      if (r < 0) { failed_ = true; return -1; }
+      if (r == 0) eof_ = true;
+    }
+    *out = head_.data();
+    return (int64_t)std::min(n, head_.size());
+  }
+
+  // Everything that is left, for consumers that need the whole input.
+  std::vector<uint8_t> ReadAll() {
+    std::vector<uint8_t> out(head_.begin() + headPos_, head_.end());
+    headPos_ = head_.size();
+    int64_t total = Size();
+    if (total > 0 && (size_t)total > out.size()) out.reserve((size_t)total);
+    while (true) {
+      size_t have = out.size();
+      out.resize(have + 64 * 1024);
+      int64_t r = Read(out.data() + have, 64 * 1024);
+      out.resize(have + (size_t)std::max<int64_t>(0, r));
+      if (r < 0) throw std::runtime_error(Error());
+      if (r == 0) return out;
+    }
+  }
+
+private:
+  void reset() {
+    if (!s_) return;
+    if (!eof_) s_->cancel(s_);
+    s_->release(s_);
+    s_ = nullptr;
+  }
+
+  ByteStream* s_ = nullptr;
+  std::vector<uint8_t> head_;
+  size_t headPos_ = 0;
+  bool eof_ = false;
+  bool failed_ = false;
+};
+
+// True for ISO-BMFF input (MP4/MOV/M4A) whose `mdat` comes before its
+// `moov`: the demuxer would have to seek to the index, so such input can
+// only be opened once it has been read in full. Walks the top-level boxes
+// through Peek(), so nothing is consumed; gives up (false) on anything else
+// or when the boxes in front of `mdat` run past the first 1 MiB.
+inline bool IsoIndexAfterMedia(ByteStreamRef& in) {
+  constexpr uint64_t kLimit = 1 << 20;
+  auto be = [](const uint8_t* p, int n){ uint64_t v = 0; for (int i = 0; i < n; ++i) v = (v << 8) | p[i]; return v; };
+  const uint8_t* head = nullptr;
+  uint64_t off = 0;
+  for (bool first = true; off + 16 <= kLimit; first = false) {
+    int64_t n = in.Peek((size_t)off + 16, &head);
+    if (n < 0 || (uint64_t)n < off + 8) return false;
+    const uint8_t* box = head + off;
+    uint64_t size = be(box, 4);
+    if (first && std::memcmp(box + 4, "ftyp", 4) != 0) return false;
+    if (std::memcmp(box + 4, "moov", 4) == 0) return false;
+    if (std::memcmp(box + 4, "mdat", 4) == 0) return true;
+    if (size == 1) {
+      if ((uint64_t)n < off + 16) return false;
+      size = be(box + 8, 8);
+    }
+    if (size < 8) return false;  // 0 = "to the end": nothing follows
+    off += size;
+  }
+  return false;
+}
+
+// The producer half of a ByteStream: a bounded queue of copied chunks. One
+// thread writes, another reads; once `capacity` bytes are waiting the
+// writer is told to hold off (Write refuses the chunk, Offer takes it but
+// says so), and onDrain fires when the reader has drained half of them.
+// Starts with one reference, owned by whoever created it.
+class PipeStream : public ByteStream {
+public:
+  enum class Push { Ok, Full, Cancelled };
+
+  explicit PipeStream(size_t capacity) : capacity_(capacity) {
+    abi = kByteStreamAbi;
+    read    = [](ByteStream* s, uint8_t* d, size_t n){ return static_cast<PipeStream*>(s)->doRead(d, n); };
+    size    = [](ByteStream* s){ return static_cast<PipeStream*>(s)->size_.load(); };
+    error   = [](ByteStream* s){ return static_cast<PipeStream*>(s)->errorText(); };
+    cancel  = [](ByteStream* s){ static_cast<PipeStream*>(s)->doCancel(); };
+    retain  = [](ByteStream* s){ static_cast<PipeStream*>(s)->refs_.fetch_add(1); };
+    release = [](ByteStream* s){
+      auto* p = static_cast<PipeStream*>(s);
+      if (p->refs_.fetch_sub(1) == 1) delete p;
+    };
+  }
+
+  struct Unref { void operator()(PipeStream* p) const { p->release(p); } };
+
+  // Set before reading starts; both run on the reader's thread.
+  std::function<void()> onDrain, onCancel;
+
+  // Full means "not taken; offer it again after onDrain".
+  Push Write(const unsigned char* p, size_t n) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (cancelled_) return Push::Cancelled;
+    if (queued_ >= capacity_) { paused_ = true; return Push::Full; }
+    chunks_.emplace_back(p, p + n);
+    queued_ += n;
+    cv_.notify_one();
+    return Push::Ok;
+  }
+
+  // Always takes the chunk; false when the writer should now wait for
+  // onDrain (or the reader is gone).
+  bool Offer(const unsigned char* p, size_t n) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (cancelled_) return false;
+    chunks_.emplace_back(p, p + n);
+    queued_ += n;
+    cv_.notify_one();
+    if (queued_ >= capacity_) { paused_ = true; return false; }
+    return true;
+  }
+
+  void SetSize(int64_t n) { size_.store(n); }
+
+  // Writer side, once: end of stream, or why there is no more.
+  void Close(std::string err) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (closed_) return;
+    closed_ = true;
+    err_ = std::move(err);
+    cv_.notify_all();
+  }
+
+private:
+  ~PipeStream() = default;
+
+  int64_t doRead(uint8_t* dst, size_t n) {
+    bool resume = false;
+    size_t k = 0;
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      cv_.wait(lk, [&]{ return queued_ > 0 || closed_ || cancelled_; });
+      if (cancelled_) return -1;
+      if (queued_ == 0) return err_.empty() ? 0 : -1;
+      while (k < n && !chunks_.empty()) {
+        auto& c = chunks_.front();
+        size_t m = std::min(n - k, c.size() - headOff_);
+        std::memcpy(dst + k, c.data() + headOff_, m);
+        k += m; headOff_ += m;
+        if (headOff_ == c.size()) { chunks_.pop_front(); headOff_ = 0; }
+      }
+      queued_ -= k;
+      if (paused_ && queued_ <= capacity_ / 2) { paused_ = false; resume = true; }
+    }
+    if (resume && onDrain) onDrain();
+    return (int64_t)k;
+  }
+
+  void doCancel() {
+    bool stop;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop = !closed_ && !cancelled_;
+      cancelled_ = true;
+      chunks_.clear();
+      queued_ = 0;
+      cv_.notify_all();
+    }
+    if (stop && onCancel) onCancel();
+  }
+
+  const char* errorText() {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (cancelled_) return "input stream was cancelled";
+    return err_.c_str();   // only written once, before closed_ is set
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::vector<uint8_t>> chunks_;
+  size_t headOff_ = 0;
+  size_t queued_ = 0;
+  const size_t capacity_;
+  bool paused_ = false, closed_ = false, cancelled_ = false;
+  std::string err_;
+  std::atomic<int64_t> size_{-1};
+  std::atomic<int> refs_{1};
+};
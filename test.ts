@@ -1,6 +1,11 @@
-import { addExif, sticker, convert, fetch } from "./export.js";
+import { addExif, sticker, probe, convert, fetch, fetchStream, fetchMany, configureFetch } from "./export.js";
 import { Buffer } from "buffer";
 import { strict as assert } from "assert";
+import http from "http";
+import fs from "fs";
+import os from "os";
+import path from "path";
+import type { AddressInfo } from "net";
 
 const MP4_URL = "https://qu.ax/OeZRN.mp4";
 const JPG_URL = "https://qu.ax/ETDnF.jpg";
@@ -33,6 +38,89 @@ async function downloadBuffer(url: string, description: string): Promise<Buffer>
     return buffer;
 }
 
+interface LocalServer {
+    url: string;
+    maxInFlight: number;
+    notModified: number;
+    ranges: number[];
+    aborted: number;
+    close(): Promise<void>;
+}
+
+// Body of /file: a little over 4 MiB, so segmented downloads get several parts.
+const FILE_BODY = Buffer.from(Array.from({ length: 4 * 1024 * 1024 + 123 }, (_, i) => (i * 31) & 0xff));
+
+// Loopback origin for tests that need to control the server side.
+// /slow?ms=N answers after N ms; maxInFlight is the most requests it held
+// at once since the last reset. /fresh is cacheable for a minute, /etag
+// must be revalidated every time (notModified counts its 304s). /file
+// serves FILE_BODY with byte ranges (ranges records each range start);
+// with ?fail the range at 0 answers 500 and the others hold for 3 s,
+// counting in aborted when the client closes them first.
+async function startLocalServer(): Promise<LocalServer> {
+    let inFlight = 0;
+    const srv: LocalServer = { url: "", maxInFlight: 0, notModified: 0, ranges: [], aborted: 0, close: async () => {} };
+    const server = http.createServer((req, res) => {
+        const u = new URL(req.url || "/", "http://x");
+        inFlight++;
+        srv.maxInFlight = Math.max(srv.maxInFlight, inFlight);
+        const done = () => { inFlight--; };
+        if (u.pathname === "/slow") {
+            const timer = setTimeout(() => { done(); res.end("ok"); }, Number(u.searchParams.get("ms") || 0));
+            res.on("close", () => { if (!res.writableEnded) { clearTimeout(timer); done(); } });
+            return;
+        }
+        done();
+        if (u.pathname === "/fresh") {
+            res.writeHead(200, { "cache-control": "max-age=60" }).end("fresh-body");
+        } else if (u.pathname === "/etag") {
+            if (req.headers["if-none-match"] === '"v1"') {
+                srv.notModified++;
+                res.writeHead(304, { etag: '"v1"' }).end();
+            } else {
+                res.writeHead(200, { "cache-control": "no-cache", etag: '"v1"' }).end("etag-body");
+            }
+        } else if (u.pathname === "/file") {
+            const len = FILE_BODY.length;
+            const headers = { "accept-ranges": "bytes", etag: '"f1"' };
+            const m = /^bytes=(\d+)-(\d*)$/.exec(req.headers.range || "");
+            if (req.method === "HEAD" || !m) {
+                res.writeHead(200, { ...headers, "content-length": len });
+                res.end(req.method === "HEAD" ? undefined : FILE_BODY);
+                return;
+            }
+            const start = Number(m[1]);
+            const end = m[2] ? Math.min(Number(m[2]), len - 1) : len - 1;
+            if (start >= len) {
+                res.writeHead(416, { "content-range": `bytes */${len}` }).end();
+                return;
+            }
+            srv.ranges.push(start);
+            const send = () => {
+                res.writeHead(206, { ...headers, "content-range": `bytes ${start}-${end}/${len}`, "content-length": end - start + 1 });
+                res.end(FILE_BODY.subarray(start, end + 1));
+            };
+            if (!u.searchParams.has("fail")) {
+                send();
+            } else if (start === 0) {
+                res.writeHead(500).end();
+            } else {
+                const timer = setTimeout(send, 3000);
+                res.on("close", () => { if (!res.writableEnded) { clearTimeout(timer); srv.aborted++; } });
+            }
+        } else {
+            res.writeHead(404).end();
+        }
+    });
+    await new Promise<void>((resolve) => server.listen(0, "127.0.0.1", () => resolve()));
+    srv.url = `http://127.0.0.1:${(server.address() as AddressInfo).port}`;
+    srv.close = () => new Promise<void>((resolve) => {
+        server.closeAllConnections();
+        server.close(() => resolve());
+    });
+    return srv;
+}
+
 async function runTests() {
     console.log("--- Starting liora-lib Native Addon Tests ---");
 
@@ -74,6 +162,14 @@ async function runTests() {
         assert(result2.length > webpSticker.length, "Buffer size must increase after EXIF addition.");
         assert(isWebP(result2), "addExif must remain in WebP format.");
         console.log("   [PASS] addExif executed successfully.");
+
+        console.log("   > Test 1.3: probe (WebP and MP4)");
+        const webpInfo = probe(result2);
+        assert(webpInfo.video && webpInfo.video.width === 512 && webpInfo.video.height === 512, "probe must read the WebP canvas size.");
+        assert(webpInfo.video.frames === 1 && !webpInfo.animated, "A JPG sticker must probe as a single still frame.");
+        const mp4Info = probe(mp4Buffer);
+        assert(mp4Info.video && mp4Info.duration > 0, "probe must find the MP4 video stream and duration.");
+        console.log(`   [PASS] probe completed successfully. MP4: ${mp4Info.video.width}x${mp4Info.video.height}, ${mp4Info.duration} ms.`);
         
     } catch (e) {
         console.error("   [FAIL] FAILED testing sticker/addExif:", e);
@@ -106,6 +202,7 @@ async function runTests() {
         
         assert.equal(res.status, 200, "Fetch failed: Status must be 200.");
         assert.equal(res.ok, true, "Fetch failed: res.ok must be true.");
+        assert.equal(typeof res.headers.get("Content-Type"), "string", "Fetch failed: headers.get() must find Content-Type.");
         
         const textBody = await res.text();
         assert(textBody.length > 1000, "Fetch failed: Body is too short (HTML expected).");
@@ -116,7 +213,189 @@ async function runTests() {
     } catch (e) {
         console.error("   [FAIL] FAILED testing native fetch (Ensure internet connection is working):", e);
     }
+
+    console.log("\n[4] Testing streamed fetch (fetchStream)...");
+
+    try {
+        const stream = fetchStream(FETCH_BENCHMARK_URL, { highWaterMark: 16 * 1024 });
+        let streamed = 0;
+        for await (const chunk of stream) {
+            assert(Buffer.isBuffer(chunk), "fetchStream failed: chunks must be Buffers.");
+            streamed += chunk.length;
+        }
+        const res = await stream.response;
+        assert.equal(res.status, 200, "fetchStream failed: Status must be 200.");
+        assert(streamed > 1000, "fetchStream failed: streamed body is too short.");
+
+        console.log(`   [PASS] fetchStream delivered ${streamed} bytes.`);
+    } catch (e) {
+        console.error("   [FAIL] FAILED testing fetchStream:", e);
+    }
     
+    console.log("\n[5] Testing fetchMany (local server)...");
+
+    const hostA = await startLocalServer();
+    const hostB = await startLocalServer();
+    try {
+        console.log("   > Test 5.1: concurrency");
+        const urls = Array.from({ length: 12 }, (_, i) => `${hostA.url}/slow?ms=40&i=${i}`);
+        const results = await fetchMany(urls, { concurrency: 3 });
+        assert.equal(results.length, urls.length, "fetchMany must return one result per request.");
+        results.forEach((r, i) => {
+            assert(!(r instanceof Error), `fetchMany request ${i} failed: ${r}`);
+            assert.equal(r.status, 200, "fetchMany responses must be 200.");
+            assert(r.url.endsWith(`i=${i}`), "fetchMany results must be in request order.");
+        });
+        assert(hostA.maxInFlight <= 3, `concurrency 3 exceeded: ${hostA.maxInFlight} in flight.`);
+        console.log(`   [PASS] 12 requests, at most ${hostA.maxInFlight} in flight.`);
+
+        console.log("   > Test 5.2: perHostLimit");
+        hostA.maxInFlight = 0;
+        const mixed = Array.from({ length: 16 }, (_, i) => `${i % 2 ? hostB.url : hostA.url}/slow?ms=40`);
+        const mixedResults = await fetchMany(mixed, { concurrency: 8, perHostLimit: 2 });
+        assert(mixedResults.every((r) => !(r instanceof Error) && r.ok), "perHostLimit requests must succeed.");
+        assert(hostA.maxInFlight <= 2 && hostB.maxInFlight <= 2,
+            `perHostLimit 2 exceeded: ${hostA.maxInFlight} / ${hostB.maxInFlight} in flight.`);
+        console.log("   [PASS] at most 2 requests per host.");
+
+        console.log("   > Test 5.3: onResult");
+        const seen: number[] = [];
+        const batched = await fetchMany(urls, {
+            concurrency: 4,
+            onResult: (index, r) => {
+                assert(!(r instanceof Error) && r.ok, `onResult got a failure for ${index}.`);
+                seen.push(index);
+            }
+        });
+        assert.equal(batched.length, 0, "with onResult the promise must not collect results.");
+        assert.deepEqual([...seen].sort((a, b) => a - b), urls.map((_, i) => i), "onResult must see every index once.");
+        console.log(`   [PASS] onResult delivered ${seen.length} results.`);
+
+        console.log("   > Test 5.4: abort");
+        const slow = Array.from({ length: 6 }, () => `${hostA.url}/slow?ms=5000`);
+        const started = Date.now();
+        const job = fetchMany(slow, { concurrency: 2 });
+        setTimeout(() => job.abort(), 50);
+        const aborted = await job;
+        assert(aborted.every((r) => r instanceof Error), "aborted fetchMany must fail every request.");
+        assert(Date.now() - started < 2000, "abort must not wait for the server.");
+        console.log("   [PASS] abort settled every request.");
+    } catch (e) {
+        console.error("   [FAIL] FAILED testing fetchMany:", e);
+    } finally {
+        await hostA.close();
+        await hostB.close();
+    }
+
+    console.log("\n[6] Testing the HTTP cache (local server)...");
+
+    const origin = await startLocalServer();
+    try {
+        configureFetch({ cache: { maxBytes: 1024 * 1024 } });
+
+        console.log("   > Test 6.1: miss, then hit");
+        const first = await fetch(`${origin.url}/fresh`);
+        assert.equal(first.cache, "miss", "first request must be a cache miss.");
+        const hit = await fetch(`${origin.url}/fresh`);
+        assert.equal(hit.cache, "hit", "fresh response must be served from the cache.");
+        assert.equal(hit.body.toString(), "fresh-body", "cache hit must return the stored body.");
+        console.log("   [PASS] miss then hit.");
+
+        console.log("   > Test 6.2: writing to a hit does not change the cache");
+        hit.body.fill(0);
+        first.body.fill(0);
+        const again = await fetch(`${origin.url}/fresh`);
+        assert.equal(again.body.toString(), "fresh-body", "a changed response body must not alias the cache entry.");
+        console.log("   [PASS] cached body unchanged.");
+
+        console.log("   > Test 6.3: 304 revalidation");
+        const v1 = await fetch(`${origin.url}/etag`);
+        assert.equal(v1.cache, "miss", "first /etag request must be a miss.");
+        const v2 = await fetch(`${origin.url}/etag`);
+        assert.equal(v2.cache, "revalidated", "no-cache response must be revalidated.");
+        assert.equal(v2.status, 200, "revalidated response must report the cached 200.");
+        assert.equal(v2.body.toString(), "etag-body", "revalidated response must return the cached body.");
+        assert.equal(origin.notModified, 1, "the server must have answered one 304.");
+        console.log("   [PASS] 304 served from the cache.");
+    } catch (e) {
+        console.error("   [FAIL] FAILED testing the HTTP cache:", e);
+    } finally {
+        configureFetch({ cache: { maxBytes: 0 } });
+        await origin.close();
+    }
+
+    console.log("\n[7] Testing range requests and saveTo (local server)...");
+
+    const files = await startLocalServer();
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), "liora-test-"));
+    try {
+        console.log("   > Test 7.1: range");
+        const part = await fetch(`${files.url}/file`, { range: [10, 19] });
+        assert.equal(part.status, 206, "a range request must get 206.");
+        assert(part.body.equals(FILE_BODY.subarray(10, 20)), "range body must match the requested bytes.");
+        console.log("   [PASS] 10 bytes from offset 10.");
+
+        console.log("   > Test 7.2: saveTo with resume");
+        const single = path.join(dir, "single.bin");
+        fs.writeFileSync(single, FILE_BODY.subarray(0, 1000));
+        files.ranges = [];
+        const resumed = await fetch(`${files.url}/file`, { saveTo: single, resume: true });
+        assert.equal(resumed.status, 206, "resume must ask for the rest of the file.");
+        assert.deepEqual(files.ranges, [1000], "resume must start at the current file size.");
+        assert(fs.readFileSync(single).equals(FILE_BODY), "resumed file must match the body.");
+        console.log("   [PASS] resumed from byte 1000.");
+
+        console.log("   > Test 7.3: segmented download");
+        const segmented = path.join(dir, "segmented.bin");
+        files.ranges = [];
+        const seg = await fetch(`${files.url}/file`, { saveTo: segmented, segments: 4 });
+        assert.equal(seg.saved?.bytes, FILE_BODY.length, "segmented download must report the full size.");
+        assert(files.ranges.length > 1, "segmented download must use several ranges.");
+        assert(fs.readFileSync(segmented).equals(FILE_BODY), "segmented file must match the body.");
+        assert(!fs.existsSync(`${segmented}.segments.json`), "state file must be removed once complete.");
+        console.log(`   [PASS] ${files.ranges.length} ranges, file complete.`);
+
+        console.log("   > Test 7.4: segmented resume re-fetches only unfinished parts");
+        const partial = Buffer.from(FILE_BODY);
+        partial.fill(0, 0, 1024 * 1024);
+        fs.writeFileSync(segmented, partial);
+        fs.writeFileSync(`${segmented}.segments.json`, JSON.stringify({
+            url: `${files.url}/file`,
+            size: FILE_BODY.length,
+            validator: '"f1"',
+            parts: [
+                { start: 0, end: 1024 * 1024 - 1, done: false },
+                { start: 1024 * 1024, end: FILE_BODY.length - 1, done: true }
+            ]
+        }));
+        files.ranges = [];
+        await fetch(`${files.url}/file`, { saveTo: segmented, segments: 4, resume: true });
+        assert.deepEqual(files.ranges, [0], "only the unfinished segment must be fetched again.");
+        assert(fs.readFileSync(segmented).equals(FILE_BODY), "resumed segmented file must match the body.");
+        console.log("   [PASS] one segment re-fetched.");
+
+        console.log("   > Test 7.5: onData with segments");
+        await assert.rejects(
+            fetch(`${files.url}/file`, { saveTo: path.join(dir, "x.bin"), segments: 4, onData: () => {} }),
+            TypeError, "onData with segments > 1 must be rejected.");
+        console.log("   [PASS] TypeError.");
+
+        console.log("   > Test 7.6: a failed segment aborts the others");
+        files.ranges = [];
+        await assert.rejects(
+            fetch(`${files.url}/file?fail`, { saveTo: path.join(dir, "failed.bin"), segments: 4 }),
+            /segment 0 failed/, "a failed segment must fail the download.");
+        const siblings = () => files.ranges.filter((start) => start !== 0).length;
+        for (let i = 0; i < 40 && files.aborted < siblings(); i++) await new Promise((r) => setTimeout(r, 50));
+        assert.equal(files.aborted, siblings(), "the other segments must be aborted, not left running.");
+        console.log(`   [PASS] ${files.aborted} running segment(s) aborted.`);
+    } catch (e) {
+        console.error("   [FAIL] FAILED testing range requests and saveTo:", e);
+    } finally {
+        fs.rmSync(dir, { recursive: true, force: true });
+        await files.close();
+    }
+
     console.log("\n--- Tests Complete ---");
 }
 